@@ -116,6 +116,7 @@ int main() {
 
 		world->UpdateWorld(dt);
 		physics->Update(dt);
+		world->FlushTransforms();
 		renderer->Update(dt);	
 		renderer->Render();
 		
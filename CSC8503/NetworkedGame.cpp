@@ -38,8 +38,7 @@ NetworkedGame::~NetworkedGame()	{
 
 void NetworkedGame::StartAsServer() {
 	thisServer = new GameServer(NetworkBase::GetDefaultPort(), 4);
-
-	thisServer->RegisterPacketHandler(Received_State, this);
+	thisServer->SetGameWorld(world);
 
 	StartLevel();
 }
@@ -56,6 +55,7 @@ void NetworkedGame::StartAsClient(char a, char b, char c, char d) {
 
 	thisClient->RegisterPacketHandler(Delta_State, this);
 	thisClient->RegisterPacketHandler(Full_State, this);
+	thisClient->RegisterPacketHandler(Snapshot_State, this);
 	thisClient->RegisterPacketHandler(Player_Connected, this);
 	thisClient->RegisterPacketHandler(Player_Disconnected, this);
 
@@ -98,38 +98,18 @@ void NetworkedGame::UpdateAsServer(float dt) {
 
 void NetworkedGame::UpdateAsClient(float dt) {
 	ClientPacket newPacket;
+	newPacket.lastID = lastReceivedState; //lets the server send deltas from it
 
 	if (Window::GetKeyboard()->KeyPressed(KeyCodes::SPACE)) {
 		//fire button pressed!
 		newPacket.buttonstates[0] = 1;
-		newPacket.lastID = 0; //You'll need to work this out somehow...
 	}
 	thisClient->SendPacket(newPacket);
 }
 
+//Which objects each client is sent, and how often, is up to the server
 void NetworkedGame::BroadcastSnapshot(bool deltaFrame) {
-	std::vector<GameObject*>::const_iterator first;
-	std::vector<GameObject*>::const_iterator last;
-
-	world.GetObjectIterators(first, last);
-
-	for (auto i = first; i != last; ++i) {
-		NetworkObject* o = (*i)->GetNetworkObject();
-		if (!o) {
-			continue;
-		}
-		//TODO - you'll need some way of determining
-		//when a player has sent the server an acknowledgement
-		//and store the lastID somewhere. A map between player
-		//and an int could work, or it could be part of a 
-		//NetworkPlayer struct. 
-		int playerState = 0;
-		GamePacket* newPacket = nullptr;
-		if (o->WritePacket(&newPacket, deltaFrame, playerState)) {
-			thisServer->SendGlobalPacket(*newPacket);
-			delete newPacket;
-		}
-	}
+	thisServer->BroadcastSnapshot(deltaFrame);
 }
 
 void NetworkedGame::UpdateMinimumState() {
@@ -137,9 +117,9 @@ void NetworkedGame::UpdateMinimumState() {
 	int minID = INT_MAX;
 	int maxID = 0; //we could use this to see if a player is lagging behind?
 
-	for (auto i : stateIDs) {
-		minID = std::min(minID, i.second);
-		maxID = std::max(maxID, i.second);
+	for (int peer : thisServer->GetConnectedPeers()) {
+		minID = std::min(minID, thisServer->GetAckedState(peer));
+		maxID = std::max(maxID, thisServer->GetAckedState(peer));
 	}
 	//every client has acknowledged reaching at least state minID
 	//so we can get rid of any old states!
@@ -164,10 +144,6 @@ void NetworkedGame::StartLevel() {
 
 }
 
-void NetworkedGame::ReceivePacket(int type, GamePacket* payload, int source) {
-	
-}
-
 void NetworkedGame::OnPlayerCollision(NetworkPlayer* a, NetworkPlayer* b) {
 	if (thisServer) { //detected a collision between players!
 		MessagePacket newPacket;
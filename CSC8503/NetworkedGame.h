@@ -8,7 +8,7 @@ namespace NCL::CSC8503 {
 	class NetworkPlayer;
 	class NetworkObject;
 
-	class NetworkedGame : public TutorialGame, public PacketReceiver 
+	class NetworkedGame : public TutorialGame 
 	{
 	public:
 		NetworkedGame(GameWorld& gameWorld, GameTechRendererInterface& renderer, PhysicsSystem& physics);
@@ -23,8 +23,6 @@ namespace NCL::CSC8503 {
 
 		void StartLevel();
 
-		void ReceivePacket(int type, GamePacket* payload, int source) override;
-
 		void OnPlayerCollision(NetworkPlayer* a, NetworkPlayer* b);
 
 	protected:
@@ -33,15 +31,12 @@ namespace NCL::CSC8503 {
 
 		void BroadcastSnapshot(bool deltaFrame);
 		void UpdateMinimumState();
-		std::map<int, int> stateIDs;
 
 		GameServer* thisServer;
 		GameClient* thisClient;
 		float timeToNextPacket;
 		int packetsToSnapshot;
 
-		std::vector<NetworkObject*> networkObjects;
-
 		std::map<int, GameObject*> serverPlayers;
 		GameObject* localPlayer;
 	};
@@ -41,7 +41,8 @@ using namespace CSC8503;
 TutorialGame::TutorialGame(GameWorld& inWorld, GameTechRendererInterface& inRenderer, PhysicsSystem& inPhysics)
 	:	world(inWorld),
 		renderer(inRenderer),
-		physics(inPhysics)
+		physics(inPhysics),
+		level(inWorld)
 {
 
 	forceMagnitude	= 10.0f;
@@ -73,6 +74,7 @@ TutorialGame::TutorialGame(GameWorld& inWorld, GameTechRendererInterface& inRend
 	enemyMesh	= renderer.LoadMesh("Keeper.msh");
 
 	bonusMesh	= renderer.LoadMesh("19463_Kitten_Head_v1.msh");
+	bonusHull	= new ConvexHull(*bonusMesh);
 	capsuleMesh = renderer.LoadMesh("capsule.msh");
 
 	defaultTex	= renderer.LoadTexture("Default.png");
@@ -90,6 +92,8 @@ TutorialGame::TutorialGame(GameWorld& inWorld, GameTechRendererInterface& inRend
 }
 
 TutorialGame::~TutorialGame()	{
+	sightQueries.Clear(); //queries still being cast can point at the bonus hull
+	delete bonusHull;
 }
 
 void TutorialGame::UpdateGame(float dt) {
@@ -122,14 +126,12 @@ void TutorialGame::InitCamera() {
 	lockedObject = nullptr;
 }
 
-static float RandRange(float min, float max) {
-	return min + (float(rand()) / float(RAND_MAX)) * (max - min);
-}
 
 
 void TutorialGame::InitWorld() {
 	world.ClearAndErase();
 	physics.Clear();
+	sightQueries.Clear();
 	physics.UseGravity(useGravity);
 	for (auto* e : enemies) {
 		if (e) {
@@ -139,10 +141,19 @@ void TutorialGame::InitWorld() {
 	}
 	enemies.clear();
 
+	level.Build();
+
+	for (const LevelBuilder::Block& block : level.GetBlocks()) {
+		AddLevelBlockToWorld(block.position, block.halfSize);
+	}
 
-	localPlayer = AddPlayerToWorld(Vector3(0, 5, 0));
+	for (GameObject* p : level.GetPlayers()) {
+		p->SetRenderObject(new RenderObject(p->GetTransform(), catMesh, checkerMaterial));
+	}
+
+	localPlayer = level.GetPlayers()[0];
 	player = localPlayer;
-	remotePlayer = AddPlayerToWorld(Vector3(-160, 5, -160));
+	remotePlayer = level.GetPlayers()[1];
 	if (auto* p = remotePlayer->GetPhysicsObject()) {
 		p->SetInverseMass(0.0f);
 		p->SetLinearVelocity(Vector3());
@@ -152,6 +163,10 @@ void TutorialGame::InitWorld() {
 	remoteTargetYaw = 0.0f;
 	hasRemoteTarget = false; 
 	netSendAccum = 0.0f;
+	snapshotAccum = 0.0f;
+	snapshotCount = 0;
+	lastReceivedState = -1;
+	RegisterNetworkObjects();
 
 	if (localPlayer && localPlayer->GetRenderObject()) {
 		localPlayer->GetRenderObject()->SetColour(Vector4(0.9f, 0.2f, 0.2f, 1.0f)); // red
@@ -169,49 +184,11 @@ void TutorialGame::InitWorld() {
 	score = 0;
 	timeRemaining = timeLimit;
 	itemsRemaining = 0;
-
-	const float floorY = -2.0f;
-	AddFloorToWorld(Vector3(0, floorY, 0));
-
-	const float floorHalf = 200.0f;
-	const float wallHalfT = 2.0f;
-	const float wallHalfH = 10.0f;
-	const float wallY = floorY + wallHalfH;
-	const float outer = floorHalf - wallHalfT;
-
-	auto WallX = [&](float x, float z, float halfLen) {
-		AddCubeToWorld(Vector3(x, wallY, z), Vector3(wallHalfT, wallHalfH, halfLen), 0.0f);
-		};
-	auto WallZ = [&](float x, float z, float halfLen) {
-		AddCubeToWorld(Vector3(x, wallY, z), Vector3(halfLen, wallHalfH, wallHalfT), 0.0f);
-		};
-
-	WallZ(0.0f, outer, floorHalf);
-	WallZ(0.0f, -outer, floorHalf);
-	WallX(outer, 0.0f, floorHalf);
-	WallX(-outer, 0.0f, floorHalf);
-
-	WallZ(-155, -120, 40);
-	WallX(-115, -140, 20);
-
-	WallZ(40, -140, 100);
-
-	WallZ(-23, -60, 40);
-	WallX(15, -20, 40);
-	WallZ(76, 20, 63);
-	WallX(140, -20, 40);
-
-	WallZ(0, 120, 140);
-	WallZ(-100, 50, 40);
-	WallX(-60, 85, 35);
-	WallX(-140, 0, 50);
 	
 	pickupItems.clear();
 	carriedItems.clear();
 
-	endZoneVisual = AddEndZoneVisual(endZonePos, endZoneHalf);
-
-	pickupItems.clear();
+	endZoneVisual = AddEndZoneVisual(level.GetEndZone());
 
 	if (navMesh) {
 		delete navMesh;
@@ -220,18 +197,8 @@ void TutorialGame::InitWorld() {
 	navMesh = new NavigationMesh("generated.navmesh");
 	std::cout << "[NAV] loaded navmesh\n";
 
-
-
-	const int numPickups = 15;
-	const float spawnY = 5.0f;
-	const float radius = 1.0f;
-
-	const float minX = -180.0f, maxX = 180.0f;
-	const float minZ = -180.0f, maxZ = 180.0f;
-
-	for (int i = 0; i < numPickups; ++i) {
-		Vector3 pos(RandRange(minX, maxX), spawnY, RandRange(minZ, maxZ));
-		pickupItems.push_back(AddPickupItemVisual(pos, radius));
+	for (GameObject* item : level.GetPickups()) {
+		pickupItems.push_back(AddPickupItemVisual(item));
 	}
 
 	itemsRemaining = (int)pickupItems.size();
@@ -324,6 +291,27 @@ GameObject* TutorialGame::AddCubeToWorld(const Vector3& position, Vector3 dimens
 	return cube;
 }
 
+/*
+
+A piece of the level's floor or walls, drawn as a cube. It doesn't collide
+itself - the level builder has already added its triangles to the level's
+single collision mesh.
+
+*/
+GameObject* TutorialGame::AddLevelBlockToWorld(const Vector3& position, const Vector3& halfSize) {
+	GameObject* block = new GameObject();
+
+	block->GetTransform()
+		.SetPosition(position)
+		.SetScale(halfSize * 2.0f);
+
+	block->SetRenderObject(new RenderObject(block->GetTransform(), cubeMesh, checkerMaterial));
+
+	world.AddGameObject(block);
+
+	return block;
+}
+
 GameObject* TutorialGame::AddPlayerToWorld(const Vector3& position) {
 	float meshSize		= 4.0f;
 	float inverseMass	= 0.5f;
@@ -342,6 +330,7 @@ GameObject* TutorialGame::AddPlayerToWorld(const Vector3& position) {
 
 	character->GetPhysicsObject()->SetInverseMass(inverseMass);
 	character->GetPhysicsObject()->InitSphereInertia();
+	character->GetPhysicsObject()->SetContinuousCollision(true); //the player can get going fast enough to skip through walls
 
 	world.AddGameObject(character);
 
@@ -400,7 +389,7 @@ StateGameObject* TutorialGame::AddStateObjectToWorld(const Vector3& position) {
 GameObject* TutorialGame::AddBonusToWorld(const Vector3& position) {
 	GameObject* apple = new GameObject();
 
-	SphereVolume* volume = new SphereVolume(0.5f);
+	ConvexHullVolume* volume = new ConvexHullVolume(bonusHull, Vector3(2, 2, 2));
 	apple->SetBoundingVolume(volume);
 	apple->GetTransform()
 		.SetScale(Vector3(2, 2, 2))
@@ -499,7 +488,8 @@ bool TutorialGame::SelectObject() {
 		Ray ray = CollisionDetection::BuildRayFromMouse(world.GetMainCamera());
 		RayCollision closestCollision;
 
-		if (world.Raycast(ray, closestCollision, true)) {
+		//The level is drawn block by block, but collides as one mesh object with nothing to draw - it can't be selected
+		if (world.Raycast(ray, closestCollision, true) && ((GameObject*)closestCollision.node)->GetRenderObject()) {
 			selectionObject = (GameObject*)closestCollision.node;
 			selectionObject->GetRenderObject()->SetColour(Vector4(0, 1, 0, 1));
 			return true;
@@ -617,6 +607,7 @@ void TutorialGame::PlayerMovement(float dt) {
 void TutorialGame::ResetGame() {
 	world.ClearAndErase();
 	physics.Clear();
+	sightQueries.Clear();
 
 	score = 0;
 	timeRemaining = timeLimit;
@@ -656,6 +647,7 @@ void TutorialGame::UpdateMenu(float dt) {
 
 		unsigned int seed = 12345;
 		server->SetLevelSeed(seed);
+		server->SetGameWorld(world);
 
 		client = new GameClient();
 		client->localID = 0;
@@ -673,6 +665,7 @@ void TutorialGame::UpdateMenu(float dt) {
 
 		client = new GameClient();
 		client->localID = 1;
+		client->RegisterPacketHandler(BasicNetworkMessages::Snapshot_State, this); //the host's world is the server's, so only joining clients need these
 
 		gameState = GameState::Playing;
 		worldBuilt = false;
@@ -724,47 +717,19 @@ void TutorialGame::UpdateEndScreen(float dt) {
 	}
 }
 
-GameObject* TutorialGame::AddEndZoneVisual(const Vector3& pos, const Vector3& halfSize) {
-	GameObject* zone = new GameObject();
-
-	AABBVolume* volume = new AABBVolume(halfSize);
-	zone->SetBoundingVolume(volume);
-
-	zone->GetTransform()
-		.SetPosition(pos)
-		.SetScale(halfSize * 2.0f);
-
+GameObject* TutorialGame::AddEndZoneVisual(GameObject* zone) {
 	RenderObject* r = new RenderObject(zone->GetTransform(), cubeMesh, checkerMaterial);
 	r->SetColour(Vector4(0.1f, 0.9f, 0.1f, 1.0f)); // green
 	zone->SetRenderObject(r);
 
-	zone->SetPhysicsObject(new PhysicsObject(zone->GetTransform(), zone->GetBoundingVolume()));
-	zone->GetPhysicsObject()->SetInverseMass(0.0f); // static
-	zone->GetPhysicsObject()->InitCubeInertia();
-
-	world.AddGameObject(zone);
 	return zone;
 }
 
-GameObject* TutorialGame::AddPickupItemVisual(const Vector3& pos, float radius) {
-	GameObject* item = new GameObject();
-
-	SphereVolume* volume = new SphereVolume(radius);
-	item->SetBoundingVolume(volume);
-
-	item->GetTransform()
-		.SetPosition(pos)
-		.SetScale(Vector3(radius, radius, radius)); 
-
+GameObject* TutorialGame::AddPickupItemVisual(GameObject* item) {
 	RenderObject* r = new RenderObject(item->GetTransform(), sphereMesh, checkerMaterial);
 	r->SetColour(Vector4(0.1f, 0.9f, 0.1f, 1.0f)); 
 	item->SetRenderObject(r);
 
-	item->SetPhysicsObject(new PhysicsObject(item->GetTransform(), item->GetBoundingVolume()));
-	item->GetPhysicsObject()->SetInverseMass(1.0f);
-	item->GetPhysicsObject()->InitSphereInertia();
-
-	world.AddGameObject(item);
 	return item;
 }
 
@@ -788,6 +753,13 @@ void TutorialGame::TryAutoPickup() {
 		if (Vector::Dot(d, d) <= pickupR2) {
 			carriedItems.push_back(it);
 
+			//It's this window's item now, so snapshots mustn't put it back where the server last saw it
+			if (NetworkObject* n = it->GetNetworkObject()) {
+				if (n->GetNetworkID() < (int)networkObjects.size()) {
+					networkObjects[n->GetNetworkID()] = nullptr;
+				}
+			}
+
 			if (PhysicsObject* phys = it->GetPhysicsObject()) {
 				phys->SetInverseMass(0.0f);     
 				phys->SetLinearVelocity(Vector3());
@@ -817,6 +789,7 @@ bool TutorialGame::IsPlayerInEndZone() const {
 
 	Vector3 p = player->GetTransform().GetPosition();
 	Vector3 z = endZoneVisual->GetTransform().GetPosition();
+	const Vector3& endZoneHalf = level.GetEndZoneHalfSize();
 
 	if (std::abs(p.x - z.x) > endZoneHalf.x) return false;
 	if (std::abs(p.z - z.z) > endZoneHalf.z) return false;
@@ -859,7 +832,8 @@ void TutorialGame::InitEnemies() {
 
 	auto* e = new EnemyController();
 	e->netID = 0;
-	e->enemy = AddEnemyToWorld(Vector3(10, 5, 10));
+	e->enemy = level.GetEnemies()[0];
+	e->enemy->SetRenderObject(new RenderObject(e->enemy->GetTransform(), enemyMesh, notexMaterial));
 	e->patrolPoints = {
 		Vector3(-60, 5, -60),
 		Vector3(20, 5, -60),
@@ -893,9 +867,14 @@ void TutorialGame::UpdateEnemies(float dt) {
 
 	int debugLine = 0;
 
+	// Pick up the answers to the sight and feeler queries sent off last frame
+	sightQueries.Collect();
+
 	for (auto* e : enemies) {
 		if (!e || !e->enemy || !e->sm) continue;
 
+		QueueEnemySight(*e);
+
 		e->sm->Update(dt);
 
 		// kill check
@@ -918,6 +897,9 @@ void TutorialGame::UpdateEnemies(float dt) {
 			if (timeRemaining < 0.0f) timeRemaining = 0.0f;
 		}
 	}
+
+	// This frame's queries get worked on while physics and rendering carry on
+	sightQueries.Dispatch(world);
 }
 
 
@@ -940,7 +922,7 @@ void TutorialGame::EnemyPatrol(EnemyController& e, float dt) {
 	}
 
 	d = Vector::Normalise(d);
-	d = AvoidWalls(*e.enemy, d);
+	d = AvoidWalls(e, d);
 
 	if (auto* phys = e.enemy->GetPhysicsObject()) {
 		phys->AddForce(d * e.patrolForce);
@@ -1009,9 +991,14 @@ bool TutorialGame::EnemyShouldPatrol(const EnemyController& e) const {
 	return !EnemyCanSeePlayer(e);
 }
 
-Vector3 TutorialGame::AvoidWalls(GameObject& enemy, const Vector3& desiredDir) const {
+/*
+The feelers are cast by the sight query service, so the results read here
+are from the feelers sent out last frame - the enemy won't have moved far
+since then. This frame's feelers are sent out at the end.
+*/
+Vector3 TutorialGame::AvoidWalls(EnemyController& e, const Vector3& desiredDir) {
 
-	Vector3 pos = enemy.GetTransform().GetPosition();
+	Vector3 pos = e.enemy->GetTransform().GetPosition();
 	pos.y += 3.0f; 
 
 	Vector3 fwd = desiredDir;
@@ -1024,39 +1011,40 @@ Vector3 TutorialGame::AvoidWalls(GameObject& enemy, const Vector3& desiredDir) c
 	const float feelerLen = 10.0f;   
 	const float originPush = 6.0f;     
 
-	auto Cast = [&](const Vector3& dir, RayCollision& outHit)->bool {
-		Ray ray(pos + fwd * originPush, dir);
-		return world.Raycast(ray, outHit, true);
-		};
+	const SightResult* hitF = sightQueries.GetResult(e.feelerQuery);
+	const SightResult* hitL = sightQueries.GetResult(e.feelerQuery + 1);
+	const SightResult* hitR = sightQueries.GetResult(e.feelerQuery + 2);
 
-	RayCollision hitF, hitL, hitR;
-	bool hf = Cast(fwd, hitF);
-	bool hl = Cast(Vector::Normalise(fwd - right * 0.6f), hitL);
-	bool hr = Cast(Vector::Normalise(fwd + right * 0.6f), hitR);
+	e.feelerQuery = sightQueries.SubmitRay(pos + fwd * originPush, fwd, feelerLen, e.enemy);
+	sightQueries.SubmitRay(pos + fwd * originPush, Vector::Normalise(fwd - right * 0.6f), feelerLen, e.enemy);
+	sightQueries.SubmitRay(pos + fwd * originPush, Vector::Normalise(fwd + right * 0.6f), feelerLen, e.enemy);
 
 
 	Debug::DrawLine(pos + fwd * originPush, pos + fwd * (originPush + feelerLen), Vector4(0, 0, 1, 1), 0.0f);
 	Debug::DrawLine(pos + fwd * originPush, pos + Vector::Normalise(fwd - right * 0.6f) * (originPush + feelerLen), Vector4(0, 0, 1, 1), 0.0f);
 	Debug::DrawLine(pos + fwd * originPush, pos + Vector::Normalise(fwd + right * 0.6f) * (originPush + feelerLen), Vector4(0, 0, 1, 1), 0.0f);
 
-	auto IsCloseHit = [&](bool hit, const RayCollision& h)->bool {
-		if (!hit) return false;
+	auto IsCloseHit = [&](const SightResult* h)->bool {
+		if (!h || !h->hit) return false;
+
+		if (h->object == player) return false;
+		return h->distance > 0.0f && h->distance < feelerLen;
+		};
 
-		GameObject* obj = (GameObject*)h.node;
-		if (obj == player) return false;
-		return h.rayDistance > 0.0f && h.rayDistance < feelerLen;
+	auto HitDistance = [&](const SightResult* h)->float {
+		return (h && h->hit) ? h->distance : FLT_MAX;
 		};
 
-	bool closeF = IsCloseHit(hf, hitF);
-	bool closeL = IsCloseHit(hl, hitL);
-	bool closeR = IsCloseHit(hr, hitR);
+	bool closeF = IsCloseHit(hitF);
+	bool closeL = IsCloseHit(hitL);
+	bool closeR = IsCloseHit(hitR);
 
 
 	if (closeF) {
 		if (!closeL && closeR) return Vector::Normalise(fwd - right);  
 		if (!closeR && closeL) return Vector::Normalise(fwd + right);  
 
-		if (hitL.rayDistance < hitR.rayDistance) return Vector::Normalise(fwd + right);
+		if (HitDistance(hitL) < HitDistance(hitR)) return Vector::Normalise(fwd + right);
 		return Vector::Normalise(fwd - right);
 	}
 
@@ -1216,6 +1204,21 @@ void TutorialGame::UpdatePlaying(float dt) {
 			float yaw = 0.0f;
 			PlayerTransformPacket pkt(client->localID, pos, yaw);
 			client->SendPacket(pkt);
+
+			if (!server) {
+				ClientPacket ack;
+				ack.lastID = lastReceivedState; //lets the server send deltas from it
+				client->SendPacket(ack);
+			}
+		}
+	}
+
+	if (server) {
+		snapshotAccum += dt;
+		if (snapshotAccum >= 0.05f) {
+			snapshotAccum = 0.0f;
+			server->BroadcastSnapshot(snapshotCount % 6 != 0); //a full state every 6th snapshot, for deltas to be taken from
+			snapshotCount++;
 		}
 	}
 
@@ -1255,8 +1258,67 @@ void TutorialGame::UpdatePlaying(float dt) {
 
 
 
-bool TutorialGame::EnemyCanSeePlayer(const EnemyController& e) const {
-	if (!player || !e.enemy) return false;
+/*
+Snapshots find their objects by network ID. The players are left out:
+each window drives its own player from the first player slot, and moves
+the other from Player_Transform packets, so the players' network IDs
+don't line up between the host and a joining client.
+*/
+void TutorialGame::RegisterNetworkObjects() {
+	networkObjects.clear();
+	world.OperateOnContents([&](GameObject* o) {
+		if (o->GetNetworkObject() && o != localPlayer && o != remotePlayer) {
+			AddNetworkObject(o->GetNetworkObject());
+		}
+	});
+}
+
+void TutorialGame::AddNetworkObject(NetworkObject* o) {
+	int id = o->GetNetworkID();
+	if (id >= (int)networkObjects.size()) {
+		networkObjects.resize(id + 1, nullptr);
+	}
+	networkObjects[id] = o;
+}
+
+void TutorialGame::ReceivePacket(int type, GamePacket* payload, int source) {
+	if (type == BasicNetworkMessages::Snapshot_State) {
+		SnapshotPacket* p = (SnapshotPacket*)payload;
+		if (!SnapshotReader::Read(*p,
+			[&](int networkID) -> NetworkObject* {
+				return networkID < (int)networkObjects.size() ? networkObjects[networkID] : nullptr;
+			}
+		)) {
+			return;
+		}
+		if (p->fullStateID >= 0) {
+			lastReceivedState = std::max(lastReceivedState, p->fullStateID);
+		}
+	}
+}
+
+/*
+Line of sight checks go through the sight query service too. Each frame
+an enemy picks up the answer to last frame's check, and sends off a new
+one, so EnemyCanSeePlayer just reports the latest answer.
+*/
+void TutorialGame::QueueEnemySight(EnemyController& e) {
+	if (!player || !e.enemy) return;
+
+	if (const SightResult* hit = sightQueries.GetResult(e.sightQuery)) {
+		e.canSeePlayer = hit->visible;
+
+		Debug::Print(
+			!hit->hit ? "HIT: NOTHING" :
+			hit->object == player ? "HIT: PLAYER" : "HIT: WALL/FLOOR",
+			Vector2(5, 35)
+		);
+		if (hit->hit) {
+			Debug::DrawLine(e.sightStart, hit->point,
+				hit->visible ? Vector4(0, 1, 0, 1) : Vector4(1, 0, 0, 1),
+				0.0f);
+		}
+	}
 
 	Vector3 enemyPos = e.enemy->GetTransform().GetPosition();
 	Vector3 playerPos = player->GetTransform().GetPosition();
@@ -1269,7 +1331,11 @@ bool TutorialGame::EnemyCanSeePlayer(const EnemyController& e) const {
 	//delta.y = 0.0f;
 
 	float dist = Vector::Length(delta);
-	if (dist < 0.01f) return true;
+	if (dist < 0.01f) {
+		e.canSeePlayer = true;
+		e.sightQuery = -1;
+		return;
+	}
 
 	Vector3 dir = delta / dist;
 
@@ -1280,39 +1346,16 @@ bool TutorialGame::EnemyCanSeePlayer(const EnemyController& e) const {
 	Vector3 d2 = playerPos - start;
 	float distFromStart = Vector::Length(d2);
 
-	Ray ray(start, dir);
-	RayCollision hit;
-
-	bool hitSomething = world.Raycast(ray, hit, true);
-
-
 	Debug::DrawLine(start, start + dir * distFromStart, Vector4(0, 0, 1, 1), 0.0f);
 
-	if (!hitSomething) {
-		return false;
-	}
-
-	GameObject* hitObj = (GameObject*)hit.node;
-
-	Debug::Print(
-		hitObj == player ? "HIT: PLAYER" :
-		hitObj == e.enemy ? "HIT: ENEMY" : "HIT: WALL/FLOOR",
-		Vector2(5, 35)
-	);
-
-	Debug::DrawLine(start, hit.collidedAt,
-		(hitObj == player) ? Vector4(0, 1, 0, 1) : Vector4(1, 0, 0, 1),
-		0.0f);
-
-	if (hitObj == e.enemy) {
-		return false;
-	}
+	e.sightStart = start;
+	e.sightQuery = sightQueries.SubmitLineOfSight(start, start + dir * (distFromStart + 1.0f), player, e.enemy);
+}
 
-	if (hitObj == player && hit.rayDistance <= distFromStart + 1.0f) {
-		return true;
-	}
+bool TutorialGame::EnemyCanSeePlayer(const EnemyController& e) const {
+	if (!player || !e.enemy) return false;
 
-	return false;
+	return e.canSeePlayer;
 }
 
 
@@ -8,6 +8,10 @@
 #include "GameClient.h"
 #include "NavigationPath.h"
 #include "NavigationMesh.h"
+#include "LineOfSightService.h"
+#include "ConvexHull.h"
+#include "TriangleMesh.h"
+#include "LevelBuilder.h"
 
 namespace NCL {
 	class Controller;
@@ -27,16 +31,19 @@ namespace NCL {
 		class StateTransition;
 		class Gameserver;
 		class GameClient;
+		class NetworkObject;
 		class localPlayer;
 		class remotePlayer;
 
-		class TutorialGame {
+		class TutorialGame : public PacketReceiver {
 		public:
 			TutorialGame(GameWorld& gameWorld, GameTechRendererInterface& renderer, PhysicsSystem& physics);
 			~TutorialGame();
 
 			virtual void UpdateGame(float dt);
 
+			void ReceivePacket(int type, GamePacket* payload, int source = -1) override;
+
 		protected:
 			void InitCamera();
 
@@ -61,6 +68,7 @@ namespace NCL {
 			GameObject* AddFloorToWorld(const NCL::Maths::Vector3& position);
 			GameObject* AddSphereToWorld(const NCL::Maths::Vector3& position, float radius, float inverseMass = 10.0f);
 			GameObject* AddCubeToWorld(const NCL::Maths::Vector3& position, NCL::Maths::Vector3 dimensions, float inverseMass = 10.0f);
+			GameObject* AddLevelBlockToWorld(const NCL::Maths::Vector3& position, const NCL::Maths::Vector3& halfSize);
 
 			GameObject* AddPlayerToWorld(const NCL::Maths::Vector3& position);
 			GameObject* AddEnemyToWorld(const NCL::Maths::Vector3& position);
@@ -96,6 +104,12 @@ namespace NCL {
 			Rendering::Mesh* enemyMesh	= nullptr;
 			Rendering::Mesh* bonusMesh	= nullptr;
 
+			//Built once from bonusMesh, and shared by every bonus in the world
+			ConvexHull* bonusHull		= nullptr;
+
+			//Builds everything that collides, for InitWorld to then add render objects to
+			LevelBuilder level;
+
 
 
 			GameTechMaterial checkerMaterial;
@@ -111,6 +125,12 @@ namespace NCL {
 
 			GameObject* objClosest = nullptr;
 
+			//Indexed by network ID, so each snapshot entry finds its object straight away - unused IDs are nullptr
+			void RegisterNetworkObjects();
+			void AddNetworkObject(NetworkObject* o);
+			std::vector<NetworkObject*> networkObjects;
+			int lastReceivedState = -1;	//newest full state, to acknowledge
+
 		private:
 
 			GameObject* player = nullptr;
@@ -156,13 +176,11 @@ namespace NCL {
 			std::vector<GameObject*> carriedItems;
 
 			GameObject* endZoneVisual = nullptr;
-			Vector3 endZonePos = Vector3(-165.0f, 2.0f, -165.0f);
-			Vector3 endZoneHalf = Vector3(10.0f, 2.0f, 10.0f);
 
 			int deliveryScore = 100;
 
-			GameObject* AddEndZoneVisual(const Vector3& pos, const Vector3& halfSize);
-			GameObject* AddPickupItemVisual(const Vector3& pos, float radius);
+			GameObject* AddEndZoneVisual(GameObject* zone);
+			GameObject* AddPickupItemVisual(GameObject* item);
 
 			void TryAutoPickup();
 			void UpdateCarriedItem();
@@ -198,6 +216,12 @@ namespace NCL {
 
 				float repathTimer = 0.0f;     // countdown
 				Vector3 lastGoal;             // last requested goal
+
+				// --- sight query tickets, answered a frame later ---
+				int sightQuery = -1;
+				int feelerQuery = -1;         // first of three
+				bool canSeePlayer = false;
+				Vector3 sightStart;
 			};
 
 
@@ -217,8 +241,11 @@ namespace NCL {
 			bool EnemyShouldChase(const EnemyController& e) const;
 			bool EnemyShouldPatrol(const EnemyController& e) const;
 
+			void QueueEnemySight(EnemyController& e);
 			bool EnemyCanSeePlayer(const EnemyController& e) const;
-			Vector3 AvoidWalls(GameObject& enemy, const Vector3& desiredDir) const;
+			Vector3 AvoidWalls(EnemyController& e, const Vector3& desiredDir);
+
+			LineOfSightService sightQueries;
 
 
 			//networking
@@ -229,6 +256,8 @@ namespace NCL {
 			NCL::CSC8503::GameObject* remotePlayer = nullptr;
 
 			float netSendAccum = 0.0f;
+			float snapshotAccum = 0.0f;
+			int snapshotCount = 0;
 			Vector3 remoteTargetPos;
 			Quaternion remoteTargetOri;
 			float   remoteTargetYaw = 0.0f;
@@ -0,0 +1,339 @@
+#include "AABBTree.h"
+#include "Debug.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+AABBTree::AABBTree(float fatMargin)
+{
+	margin = fatMargin;
+	Clear();
+}
+
+void AABBTree::Clear()
+{
+	nodes.clear();
+	root		= NullNode;
+	freeList	= NullNode;
+	leafCount	= 0;
+}
+
+int AABBTree::AllocateNode()
+{
+	if (freeList == NullNode) {
+		nodes.emplace_back();
+		Node& n		= nodes.back();
+		n.parent	= NullNode;
+		n.height	= -1;
+		freeList	= (int)nodes.size() - 1;
+	}
+	int index	= freeList;
+	Node& n		= nodes[index];
+	freeList	= n.parent;
+
+	n.parent	= NullNode;
+	n.left		= NullNode;
+	n.right		= NullNode;
+	n.height	= 0;
+	n.object	= nullptr;
+	n.stamp		= 0;
+	return index;
+}
+
+void AABBTree::FreeNode(int node)
+{
+	nodes[node].parent	= freeList;
+	nodes[node].height	= -1;
+	nodes[node].object	= nullptr;
+	freeList			= node;
+}
+
+/*
+The fat box is grown by a fixed margin on every side, and then stretched
+out along the direction the object is predicted to travel, so that fast
+moving objects don't need to be reinserted every single substep.
+*/
+void AABBTree::SetFatBox(Node& n, const Vector3& position, const Vector3& halfSize, const Vector3& displacement) const
+{
+	Vector3 fatSize = halfSize + Vector3(margin, margin, margin);
+
+	n.boxMin = position - fatSize;
+	n.boxMax = position + fatSize;
+
+	for (int i = 0; i < 3; ++i) {
+		if (displacement[i] < 0.0f) {
+			n.boxMin[i] += displacement[i];
+		}
+		else {
+			n.boxMax[i] += displacement[i];
+		}
+	}
+}
+
+int AABBTree::Insert(GameObject* object, const Vector3& position, const Vector3& halfSize)
+{
+	int proxy = AllocateNode();
+	Node& n	  = nodes[proxy];
+	n.object  = object;
+	SetFatBox(n, position, halfSize, Vector3());
+
+	InsertLeaf(proxy);
+	leafCount++;
+	return proxy;
+}
+
+void AABBTree::Remove(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	leafCount--;
+}
+
+bool AABBTree::Update(int proxy, const Vector3& position, const Vector3& halfSize, const Vector3& displacement)
+{
+	const Node& n = nodes[proxy];
+
+	if (Contains(n.boxMin, n.boxMax, position - halfSize, position + halfSize)) {
+		//Still inside the fat box, but if the box has become far too big for
+		//the object (it stopped moving, or shrunk), it's worth rebuilding it
+		float looseMargin	= margin * 4.0f + Vector::GetAbsMaxElement(displacement);
+		Vector3 looseSize	= halfSize + Vector3(looseMargin, looseMargin, looseMargin);
+
+		if (Contains(position - looseSize, position + looseSize, n.boxMin, n.boxMax)) {
+			return false;
+		}
+	}
+
+	RemoveLeaf(proxy);
+	SetFatBox(nodes[proxy], position, halfSize, displacement);
+	InsertLeaf(proxy);
+	return true;
+}
+
+void AABBTree::RemoveUntouched(int stamp)
+{
+	for (int i = 0; i < (int)nodes.size(); ++i) {
+		if (nodes[i].IsLeaf() && nodes[i].stamp != stamp) {
+			Remove(i);
+		}
+	}
+}
+
+/*
+Leaves are inserted by walking down from the root, at each level picking
+whichever child would grow the least (by surface area) to contain the new
+box. This keeps sibling boxes tight, which is what makes queries cheap.
+*/
+void AABBTree::InsertLeaf(int leaf)
+{
+	if (root == NullNode) {
+		root = leaf;
+		nodes[root].parent = NullNode;
+		return;
+	}
+
+	Vector3 leafMin = nodes[leaf].boxMin;
+	Vector3 leafMax = nodes[leaf].boxMax;
+
+	int index = root;
+	while (!nodes[index].IsLeaf()) {
+		const Node& n = nodes[index];
+
+		float area			= SurfaceArea(n.boxMin, n.boxMax);
+		float combinedArea	= SurfaceArea(Vector::Min(n.boxMin, leafMin), Vector::Max(n.boxMax, leafMax));
+
+		//Cost of making a new parent for this node and the leaf
+		float cost = 2.0f * combinedArea;
+		//Minimum cost of pushing the leaf further down the tree
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		int children[2] = { n.left, n.right };
+		for (int i = 0; i < 2; ++i) {
+			const Node& c	= nodes[children[i]];
+			float newArea	= SurfaceArea(Vector::Min(c.boxMin, leafMin), Vector::Max(c.boxMax, leafMax));
+			if (c.IsLeaf()) {
+				childCost[i] = newArea + inheritanceCost;
+			}
+			else {
+				childCost[i] = (newArea - SurfaceArea(c.boxMin, c.boxMax)) + inheritanceCost;
+			}
+		}
+
+		if (cost < childCost[0] && cost < childCost[1]) {
+			break;
+		}
+		index = (childCost[0] < childCost[1]) ? children[0] : children[1];
+	}
+
+	int sibling		= index;
+	int oldParent	= nodes[sibling].parent;
+	int newParent	= AllocateNode();
+
+	Node& p		= nodes[newParent];
+	p.parent	= oldParent;
+	p.boxMin	= Vector::Min(leafMin, nodes[sibling].boxMin);
+	p.boxMax	= Vector::Max(leafMax, nodes[sibling].boxMax);
+	p.height	= nodes[sibling].height + 1;
+	p.left		= sibling;
+	p.right		= leaf;
+
+	if (oldParent != NullNode) {
+		if (nodes[oldParent].left == sibling) {
+			nodes[oldParent].left = newParent;
+		}
+		else {
+			nodes[oldParent].right = newParent;
+		}
+	}
+	else {
+		root = newParent;
+	}
+	nodes[sibling].parent	= newParent;
+	nodes[leaf].parent		= newParent;
+
+	Refit(newParent);
+}
+
+void AABBTree::RemoveLeaf(int leaf)
+{
+	if (leaf == root) {
+		root = NullNode;
+		return;
+	}
+
+	int parent		= nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling		= (nodes[parent].left == leaf) ? nodes[parent].right : nodes[parent].left;
+
+	if (grandParent != NullNode) {
+		if (nodes[grandParent].left == parent) {
+			nodes[grandParent].left = sibling;
+		}
+		else {
+			nodes[grandParent].right = sibling;
+		}
+		nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+		Refit(grandParent);
+	}
+	else {
+		root = sibling;
+		nodes[sibling].parent = NullNode;
+		FreeNode(parent);
+	}
+	nodes[leaf].parent = NullNode;
+}
+
+//Walks back up to the root, rebalancing and refitting boxes as it goes
+void AABBTree::Refit(int node)
+{
+	int index = node;
+	while (index != NullNode) {
+		index = Balance(index);
+
+		Node& n			= nodes[index];
+		const Node& l	= nodes[n.left];
+		const Node& r	= nodes[n.right];
+
+		n.height = 1 + std::max(l.height, r.height);
+		n.boxMin = Vector::Min(l.boxMin, r.boxMin);
+		n.boxMax = Vector::Max(l.boxMax, r.boxMax);
+
+		index = n.parent;
+	}
+}
+
+/*
+If one side of node A is more than one level taller than the other, the
+taller child is rotated up to take A's place, and A takes the taller
+child's shorter grandchild. Returns the index of whichever node is now
+at A's position in the tree.
+*/
+int AABBTree::Balance(int iA)
+{
+	Node& A = nodes[iA];
+	if (A.IsLeaf() || A.height < 2) {
+		return iA;
+	}
+
+	int iB = A.left;
+	int iC = A.right;
+	int balance = nodes[iC].height - nodes[iB].height;
+
+	if (balance > 1 || balance < -1) {
+		//Rotate the taller child up into A's place
+		int iUp = balance > 1 ? iC : iB;
+
+		Node& up = nodes[iUp];
+		int iF = up.left;
+		int iG = up.right;
+
+		up.left		= iA;
+		up.parent	= A.parent;
+		A.parent	= iUp;
+
+		if (up.parent != NullNode) {
+			if (nodes[up.parent].left == iA) {
+				nodes[up.parent].left = iUp;
+			}
+			else {
+				nodes[up.parent].right = iUp;
+			}
+		}
+		else {
+			root = iUp;
+		}
+
+		//The taller grandchild stays under 'up', the shorter moves to A
+		int iKeep = nodes[iF].height > nodes[iG].height ? iF : iG;
+		int iMove = nodes[iF].height > nodes[iG].height ? iG : iF;
+
+		up.right	= iKeep;
+		if (balance > 1) {
+			A.right = iMove;
+		}
+		else {
+			A.left	= iMove;
+		}
+		nodes[iMove].parent = iA;
+
+		A.boxMin	= Vector::Min(nodes[A.left].boxMin, nodes[A.right].boxMin);
+		A.boxMax	= Vector::Max(nodes[A.left].boxMax, nodes[A.right].boxMax);
+		A.height	= 1 + std::max(nodes[A.left].height, nodes[A.right].height);
+
+		up.boxMin	= Vector::Min(A.boxMin, nodes[iKeep].boxMin);
+		up.boxMax	= Vector::Max(A.boxMax, nodes[iKeep].boxMax);
+		up.height	= 1 + std::max(A.height, nodes[iKeep].height);
+
+		return iUp;
+	}
+	return iA;
+}
+
+void AABBTree::DebugDraw() const
+{
+	for (const Node& n : nodes) {
+		if (n.height < 0) {
+			continue;
+		}
+		Vector4 colour = n.IsLeaf() ? Debug::GREEN : Debug::YELLOW;
+
+		Vector3 corners[8];
+		for (int i = 0; i < 8; ++i) {
+			corners[i] = Vector3(
+				(i & 1) ? n.boxMax.x : n.boxMin.x,
+				(i & 2) ? n.boxMax.y : n.boxMin.y,
+				(i & 4) ? n.boxMax.z : n.boxMin.z
+			);
+		}
+		//Each edge joins two corners that differ in exactly one axis bit
+		for (int i = 0; i < 8; ++i) {
+			for (int axis = 1; axis < 8; axis <<= 1) {
+				if (!(i & axis)) {
+					Debug::DrawLine(corners[i], corners[i | axis], colour);
+				}
+			}
+		}
+	}
+}
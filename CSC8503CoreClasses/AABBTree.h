@@ -0,0 +1,336 @@
+#pragma once
+#include "Vector.h"
+#include "RayPacket.h"
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		class GameObject;
+
+		/*
+		A dynamic bounding volume hierarchy of axis aligned boxes, used by the
+		PhysicsSystem broadphase. Every leaf stores a 'fat' box, grown by a small
+		margin around the object's real bounds, so an object that only moves a
+		little each frame stays inside its leaf and doesn't need reinserting.
+
+		Nodes live in a single pooled array and refer to each other by index, so
+		the tree can grow without invalidating the proxy IDs handed out by Insert.
+		*/
+		class AABBTree {
+		public:
+			AABBTree(float fatMargin = 0.5f);
+			~AABBTree() = default;
+
+			void Clear();
+
+			int  Insert(GameObject* object, const Vector3& position, const Vector3& halfSize);
+			void Remove(int proxy);
+
+			//Returns true if the object had left its fat box and was reinserted
+			bool Update(int proxy, const Vector3& position, const Vector3& halfSize, const Vector3& displacement = Vector3());
+
+			GameObject* GetObject(int proxy) const
+			{
+				if (proxy < 0 || proxy >= (int)nodes.size() || !nodes[proxy].IsLeaf()) {
+					return nullptr;
+				}
+				return nodes[proxy].object;
+			}
+
+			int GetLeafCount() const
+			{
+				return leafCount;
+			}
+
+			int GetHeight() const
+			{
+				return root == NullNode ? 0 : nodes[root].height;
+			}
+
+			//Marks a leaf as still being present in the world this pass
+			void Touch(int proxy, int stamp)
+			{
+				nodes[proxy].stamp = stamp;
+			}
+
+			//Removes every leaf that wasn't touched with the given stamp
+			void RemoveUntouched(int stamp);
+
+			void DebugDraw() const;
+
+			template<class F>
+			void Query(const Vector3& boxMin, const Vector3& boxMax, F&& func) const;
+
+			template<class F>
+			void QueryOverlappingPairs(F&& func) const;
+
+			template<class F>
+			void Raycast(const Vector3& origin, const Vector3& direction, float maxDistance, F&& func) const;
+
+			template<class F>
+			void RaycastPacket(RayPacket& packet, F&& func) const;
+
+			static constexpr int NullNode = -1;
+
+		protected:
+			struct Node {
+				Vector3		boxMin;
+				Vector3		boxMax;
+				GameObject* object;
+				int			parent;	//or the next free node, when on the free list
+				int			left;
+				int			right;
+				int			height;	//-1 when the node is free
+				int			stamp;
+
+				bool IsLeaf() const
+				{
+					return left == NullNode && height == 0;
+				}
+			};
+
+			static bool Overlaps(const Vector3& aMin, const Vector3& aMax, const Vector3& bMin, const Vector3& bMax)
+			{
+				return	aMin.x <= bMax.x && aMax.x >= bMin.x &&
+						aMin.y <= bMax.y && aMax.y >= bMin.y &&
+						aMin.z <= bMax.z && aMax.z >= bMin.z;
+			}
+
+			static bool Contains(const Vector3& outerMin, const Vector3& outerMax, const Vector3& innerMin, const Vector3& innerMax)
+			{
+				return	outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+						outerMax.x >= innerMax.x && outerMax.y >= innerMax.y && outerMax.z >= innerMax.z;
+			}
+
+			//How far along the ray it enters the box, if it does so before maxDistance
+			static bool RayEntry(const Vector3& origin, const Vector3& direction, const Vector3& boxMin, const Vector3& boxMax, float maxDistance, float& entry)
+			{
+				float tMin = 0.0f;
+				float tMax = maxDistance;
+				for (int i = 0; i < 3; ++i) {
+					if (direction[i] == 0.0f) {
+						if (origin[i] < boxMin[i] || origin[i] > boxMax[i]) {
+							return false;
+						}
+						continue;
+					}
+					float inv	= 1.0f / direction[i];
+					float t0	= (boxMin[i] - origin[i]) * inv;
+					float t1	= (boxMax[i] - origin[i]) * inv;
+					tMin = std::max(tMin, std::min(t0, t1));
+					tMax = std::min(tMax, std::max(t0, t1));
+					if (tMin > tMax) {
+						return false;
+					}
+				}
+				entry = tMin;
+				return true;
+			}
+
+			static float SurfaceArea(const Vector3& boxMin, const Vector3& boxMax)
+			{
+				Vector3 d = boxMax - boxMin;
+				return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+			}
+
+			int  AllocateNode();
+			void FreeNode(int node);
+
+			void InsertLeaf(int leaf);
+			void RemoveLeaf(int leaf);
+			int  Balance(int node);
+			void Refit(int node);
+
+			void SetFatBox(Node& n, const Vector3& position, const Vector3& halfSize, const Vector3& displacement) const;
+
+			std::vector<Node>	nodes;
+			int					root;
+			int					freeList;
+			int					leafCount;
+			float				margin;
+		};
+
+		template<class F>
+		void AABBTree::Query(const Vector3& boxMin, const Vector3& boxMax, F&& func) const
+		{
+			if (root == NullNode) {
+				return;
+			}
+			int stack[64];
+			int stackSize = 0;
+			stack[stackSize++] = root;
+
+			while (stackSize > 0) {
+				const Node& n = nodes[stack[--stackSize]];
+				if (!Overlaps(n.boxMin, n.boxMax, boxMin, boxMax)) {
+					continue;
+				}
+				if (n.IsLeaf()) {
+					func((int)(&n - nodes.data()), n.object);
+				}
+				else {
+					stack[stackSize++] = n.left;
+					stack[stackSize++] = n.right;
+				}
+			}
+		}
+
+		/*
+		Calls func(int proxy, GameObject* object) for each leaf whose box the
+		ray passes through, within maxDistance. At each node, the child the ray
+		reaches first is visited first, so leaves come roughly nearest first.
+		func returns how far along the ray is still worth searching - returning
+		the distance to something it hit means nothing further away than that
+		is visited, and returning a negative number stops the search.
+		*/
+		template<class F>
+		void AABBTree::Raycast(const Vector3& origin, const Vector3& direction, float maxDistance, F&& func) const
+		{
+			float entry;
+			if (root == NullNode || !RayEntry(origin, direction, nodes[root].boxMin, nodes[root].boxMax, maxDistance, entry)) {
+				return;
+			}
+			struct StackEntry {
+				int		node;
+				float	entry;
+			};
+			StackEntry stack[64];
+			int stackSize = 0;
+			stack[stackSize++] = { root, entry };
+
+			while (stackSize > 0) {
+				StackEntry top = stack[--stackSize];
+				if (top.entry > maxDistance) {
+					continue; //something closer was hit after this was pushed
+				}
+				const Node& n = nodes[top.node];
+				if (n.IsLeaf()) {
+					maxDistance = func(top.node, n.object);
+					if (maxDistance < 0.0f) {
+						return;
+					}
+					continue;
+				}
+				float leftEntry;
+				float rightEntry;
+				bool hitLeft	= RayEntry(origin, direction, nodes[n.left].boxMin,  nodes[n.left].boxMax,  maxDistance, leftEntry);
+				bool hitRight	= RayEntry(origin, direction, nodes[n.right].boxMin, nodes[n.right].boxMax, maxDistance, rightEntry);
+
+				//Push the further child first, so the nearer one is popped next
+				if (hitLeft && hitRight) {
+					if (leftEntry < rightEntry) {
+						stack[stackSize++] = { n.right, rightEntry };
+						stack[stackSize++] = { n.left,	leftEntry };
+					}
+					else {
+						stack[stackSize++] = { n.left,	leftEntry };
+						stack[stackSize++] = { n.right, rightEntry };
+					}
+				}
+				else if (hitLeft) {
+					stack[stackSize++] = { n.left, leftEntry };
+				}
+				else if (hitRight) {
+					stack[stackSize++] = { n.right, rightEntry };
+				}
+			}
+		}
+
+		/*
+		The same walk as Raycast, but for a whole packet of rays at once. Each
+		node on the stack remembers which lanes reached it, and func(int proxy,
+		GameObject* object, int mask) is called for each leaf with the lanes
+		that reached its box. func should test those lanes against the object, and shorten
+		(or end) any lane that hits, through the packet's max distances - lanes
+		that have since been shortened past a node, or ended, are dropped from
+		it when it's popped. Children are visited in the order the nearest of
+		the lanes reaching them enters them.
+		*/
+		template<class F>
+		void AABBTree::RaycastPacket(RayPacket& packet, F&& func) const
+		{
+			float entry[RayPacket::Size];
+			if (root == NullNode) {
+				return;
+			}
+			int rootMask = packet.OverlapBox(nodes[root].boxMin, nodes[root].boxMax, entry);
+			if (!rootMask) {
+				return;
+			}
+			struct StackEntry {
+				int node;
+				int mask;
+			};
+			StackEntry stack[64];
+			int stackSize = 0;
+			stack[stackSize++] = { root, rootMask };
+
+			auto NearestEntry = [](int mask, const float* entries) {
+				float nearest = FLT_MAX;
+				for (int i = 0; i < RayPacket::Size; ++i) {
+					if (mask & (1 << i)) {
+						nearest = std::min(nearest, entries[i]);
+					}
+				}
+				return nearest;
+			};
+
+			while (stackSize > 0) {
+				StackEntry top = stack[--stackSize];
+				const Node& n = nodes[top.node];
+				if (n.IsLeaf()) {
+					int mask = top.mask & packet.GetActiveMask();
+					if (mask) {
+						func(top.node, n.object, mask);
+					}
+					continue;
+				}
+				float leftEntry[RayPacket::Size];
+				float rightEntry[RayPacket::Size];
+				int leftMask	= top.mask & packet.OverlapBox(nodes[n.left].boxMin,  nodes[n.left].boxMax,  leftEntry);
+				int rightMask	= top.mask & packet.OverlapBox(nodes[n.right].boxMin, nodes[n.right].boxMax, rightEntry);
+
+				//Push the further child first, so the nearer one is popped next
+				if (leftMask && rightMask) {
+					if (NearestEntry(leftMask, leftEntry) < NearestEntry(rightMask, rightEntry)) {
+						stack[stackSize++] = { n.right, rightMask };
+						stack[stackSize++] = { n.left,	leftMask };
+					}
+					else {
+						stack[stackSize++] = { n.left,	leftMask };
+						stack[stackSize++] = { n.right, rightMask };
+					}
+				}
+				else if (leftMask) {
+					stack[stackSize++] = { n.left, leftMask };
+				}
+				else if (rightMask) {
+					stack[stackSize++] = { n.right, rightMask };
+				}
+			}
+		}
+
+		/*
+		Calls func(GameObject* a, GameObject* b) once for every pair of leaves
+		whose fat boxes overlap. Each leaf queries the tree with its own box, and
+		only reports partners with a higher proxy ID, so no pair is seen twice.
+		*/
+		template<class F>
+		void AABBTree::QueryOverlappingPairs(F&& func) const
+		{
+			for (int i = 0; i < (int)nodes.size(); ++i) {
+				const Node& leaf = nodes[i];
+				if (!leaf.IsLeaf()) {
+					continue;
+				}
+				Query(leaf.boxMin, leaf.boxMax,
+					[&](int other, GameObject* otherObject) {
+						if (other > i) {
+							func(leaf.object, otherObject);
+						}
+					}
+				);
+			}
+		}
+	}
+}
@@ -0,0 +1,76 @@
+#include "BitStream.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+void BitWriter::Reset(int headerBytes) {
+	bytes.assign(headerBytes, 0);
+	bitCount = headerBytes * 8;
+}
+
+void BitWriter::WriteBits(uint32_t value, int count) {
+	while (count > 0) {
+		int bitOffset = bitCount & 7;
+		if (bitOffset == 0) {
+			bytes.emplace_back(0);
+		}
+		int take = std::min(8 - bitOffset, count);
+		bytes.back() |= (char)((value & ((1u << take) - 1)) << bitOffset);
+
+		value		>>= take;
+		count		-= take;
+		bitCount	+= take;
+	}
+}
+
+void BitWriter::Rewind(int newBitCount) {
+	if (newBitCount >= bitCount) {
+		return;
+	}
+	bytes.resize((newBitCount + 7) / 8);
+	if (newBitCount & 7) {
+		bytes.back() &= (char)((1u << (newBitCount & 7)) - 1);
+	}
+	bitCount = newBitCount;
+}
+
+void BitWriter::WriteFloat(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	WriteBits(bits, 32);
+}
+
+BitReader::BitReader(const char* data, int byteCount) {
+	this->data	= (const unsigned char*)data;
+	totalBits	= byteCount * 8;
+	bitCount	= 0;
+	overflowed	= false;
+}
+
+uint32_t BitReader::ReadBits(int count) {
+	if (bitCount + count > totalBits) {
+		overflowed	= true;
+		bitCount	= totalBits;
+		return 0;
+	}
+	uint32_t value	= 0;
+	int shift		= 0;
+	while (count > 0) {
+		int bitOffset	= bitCount & 7;
+		int take		= std::min(8 - bitOffset, count);
+		uint32_t bits	= (data[bitCount >> 3] >> bitOffset) & ((1u << take) - 1);
+		value |= bits << shift;
+
+		shift		+= take;
+		count		-= take;
+		bitCount	+= take;
+	}
+	return value;
+}
+
+float BitReader::ReadFloat() {
+	uint32_t bits = ReadBits(32);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
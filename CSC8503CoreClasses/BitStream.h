@@ -0,0 +1,82 @@
+#pragma once
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Writes values into a byte buffer using only as many bits as each one
+		needs, rather than rounding every field up to a whole number of bytes.
+		Bits are packed lowest first.
+
+		The buffer is kept between uses - Reset only empties it, so once it has
+		grown to fit a full snapshot, writing more snapshots into it never
+		needs to allocate again. Space can be left at the front for a packet
+		header, to be filled in once the size of everything after it is known.
+		*/
+		class BitWriter {
+		public:
+			BitWriter()		= default;
+			~BitWriter()	= default;
+
+			void Reset(int headerBytes = 0);
+
+			void WriteBits(uint32_t value, int bitCount);
+			void WriteBool(bool value)
+			{
+				WriteBits(value ? 1 : 0, 1);
+			}
+			void WriteFloat(float value);
+
+			int GetBitCount() const
+			{
+				return bitCount;
+			}
+
+			//Throws away everything written since GetBitCount returned bitCount
+			void Rewind(int bitCount);
+
+			int GetByteCount() const
+			{
+				return (int)bytes.size();
+			}
+
+			char* GetData()
+			{
+				return bytes.data();
+			}
+
+		protected:
+			std::vector<char>	bytes;
+			int					bitCount = 0;
+		};
+
+		/*
+		Reads back what a BitWriter wrote, in the same order. Reading past the
+		end of the data gives zeroes and marks the reader as overflowed, so a
+		bad packet can be thrown away after it's been read, rather than
+		checking every single field.
+		*/
+		class BitReader {
+		public:
+			BitReader(const char* data, int byteCount);
+			~BitReader() = default;
+
+			uint32_t ReadBits(int bitCount);
+			bool ReadBool()
+			{
+				return ReadBits(1) != 0;
+			}
+			float ReadFloat();
+
+			bool IsOverflowed() const
+			{
+				return overflowed;
+			}
+
+		protected:
+			const unsigned char*	data;
+			int						totalBits;
+			int						bitCount;
+			bool					overflowed;
+		};
+	}
+}
@@ -6,6 +6,9 @@
 #include "Window.h"
 #include "Maths.h"
 #include "Debug.h"
+#include "Simd.h"
+
+#include <bit>
 
 using namespace NCL;
 
@@ -43,6 +46,8 @@ bool CollisionDetection::RayIntersection(const Ray& r,GameObject& object, RayCol
 		case VolumeType::Sphere:	hasCollided = RaySphereIntersection(r, worldTransform, (const SphereVolume&)*volume	, collision); break;
 
 		case VolumeType::Capsule:	hasCollided = RayCapsuleIntersection(r, worldTransform, (const CapsuleVolume&)*volume, collision); break;
+		case VolumeType::ConvexHull:	hasCollided = RayConvexHullIntersection(r, worldTransform, (const ConvexHullVolume&)*volume, collision); break;
+		case VolumeType::Mesh:		hasCollided = RayTriangleMeshIntersection(r, worldTransform, (const TriangleMeshVolume&)*volume, collision); break;
 	}
 
 	return hasCollided;
@@ -157,11 +162,404 @@ bool CollisionDetection::RaySphereIntersection(const Ray&r, const Transform& wor
 	return true;
 }
 
+/*
+Capsules are stored as a line segment running along their local y axis,
+with every point within radius of it being inside the capsule. The
+volume's half height includes the rounded ends, so the segment itself is
+a radius shorter at each end.
+*/
+static void GetCapsuleSegment(const CapsuleVolume& volume, const Transform& worldTransform, Vector3& start, Vector3& end) {
+	Vector3 axis = worldTransform.GetOrientation() * Vector3(0, std::max(volume.GetHalfHeight() - volume.GetRadius(), 0.0f), 0);
+	start	= worldTransform.GetPosition() - axis;
+	end		= worldTransform.GetPosition() + axis;
+}
+
+static Vector3 ClosestPointOnSegment(const Vector3& point, const Vector3& start, const Vector3& end) {
+	Vector3 dir		= end - start;
+	float lengthSq	= Vector::Dot(dir, dir);
+	if (lengthSq <= 0.0f) {
+		return start;
+	}
+	float t = std::clamp(Vector::Dot(point - start, dir) / lengthSq, 0.0f, 1.0f);
+	return start + dir * t;
+}
+
+/*
+The closest pair of points between two line segments, from Real-Time
+Collision Detection (Ericson, 5.1.9). Parallel segments have lots of
+equally close pairs, in which case one of them is picked.
+*/
+static void ClosestSegmentPoints(const Vector3& startA, const Vector3& endA, const Vector3& startB, const Vector3& endB,
+	Vector3& closestA, Vector3& closestB) {
+	const float epsilon = 1e-6f;
+
+	Vector3 dirA	= endA - startA;
+	Vector3 dirB	= endB - startB;
+	Vector3 offset	= startA - startB;
+
+	float lengthSqA = Vector::Dot(dirA, dirA);
+	float lengthSqB = Vector::Dot(dirB, dirB);
+	float f			= Vector::Dot(dirB, offset);
+
+	float s = 0.0f;
+	float t = 0.0f;
+
+	if (lengthSqA <= epsilon && lengthSqB <= epsilon) {
+		//both are points
+	}
+	else if (lengthSqA <= epsilon) {
+		t = std::clamp(f / lengthSqB, 0.0f, 1.0f);
+	}
+	else {
+		float c = Vector::Dot(dirA, offset);
+		if (lengthSqB <= epsilon) {
+			s = std::clamp(-c / lengthSqA, 0.0f, 1.0f);
+		}
+		else {
+			float b		= Vector::Dot(dirA, dirB);
+			float denom = lengthSqA * lengthSqB - b * b;
+
+			s = denom > 0.0f ? std::clamp((b * f - c * lengthSqB) / denom, 0.0f, 1.0f) : 0.0f;
+			t = (b * s + f) / lengthSqB;
+
+			if (t < 0.0f) {
+				t = 0.0f;
+				s = std::clamp(-c / lengthSqA, 0.0f, 1.0f);
+			}
+			else if (t > 1.0f) {
+				t = 1.0f;
+				s = std::clamp((b - c) / lengthSqA, 0.0f, 1.0f);
+			}
+		}
+	}
+	closestA = startA + dirA * s;
+	closestB = startB + dirB * t;
+}
+
+/*
+The closest point on a triangle to a given point, from Real-Time Collision
+Detection (Ericson, 5.1.5) - the point is checked against each of the
+triangle's corner and edge regions in turn, and if it's in none of them,
+it must be over the face itself.
+*/
+static Vector3 ClosestPointOnTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c) {
+	Vector3 ab = b - a;
+	Vector3 ac = c - a;
+	Vector3 ap = p - a;
+	float d1 = Vector::Dot(ab, ap);
+	float d2 = Vector::Dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		return a;
+	}
+	Vector3 bp = p - b;
+	float d3 = Vector::Dot(ab, bp);
+	float d4 = Vector::Dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) {
+		return b;
+	}
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		return a + ab * (d1 / (d1 - d3));
+	}
+	Vector3 cp = p - c;
+	float d5 = Vector::Dot(ab, cp);
+	float d6 = Vector::Dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) {
+		return c;
+	}
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		return a + ac * (d2 / (d2 - d6));
+	}
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+//Whether a point on a triangle's plane is inside its edges, using the triangle's normal to tell which side is in
+static bool PointInTriangle(const Vector3& p, const TriangleMesh::Triangle& t) {
+	return	Vector::Dot(Vector::Cross(t.b - t.a, p - t.a), t.normal) >= 0.0f &&
+			Vector::Dot(Vector::Cross(t.c - t.b, p - t.b), t.normal) >= 0.0f &&
+			Vector::Dot(Vector::Cross(t.a - t.c, p - t.c), t.normal) >= 0.0f;
+}
+
+/*
+The closest pair of points between a line segment and a triangle. If the
+segment passes through the triangle, they're touching, and the distance
+is 0. Otherwise, the closest points are either one end of the segment
+against the triangle, or the segment against one of the triangle's edges.
+*/
+static float ClosestSegmentTrianglePoints(const Vector3& start, const Vector3& end, const TriangleMesh::Triangle& t,
+	Vector3& onSegment, Vector3& onTriangle) {
+	float startSide = Vector::Dot(t.normal, start - t.a);
+	float endSide	= Vector::Dot(t.normal, end - t.a);
+	if ((startSide <= 0.0f) != (endSide <= 0.0f)) {
+		Vector3 crossing = start + (end - start) * (startSide / (startSide - endSide));
+		if (PointInTriangle(crossing, t)) {
+			onSegment	= crossing;
+			onTriangle	= crossing;
+			return 0.0f;
+		}
+	}
+	float bestDistSq = FLT_MAX;
+	auto Consider = [&](const Vector3& segmentPoint, const Vector3& trianglePoint) {
+		Vector3 delta	= segmentPoint - trianglePoint;
+		float distSq	= Vector::Dot(delta, delta);
+		if (distSq < bestDistSq) {
+			bestDistSq	= distSq;
+			onSegment	= segmentPoint;
+			onTriangle	= trianglePoint;
+		}
+	};
+	Consider(start, ClosestPointOnTriangle(start, t.a, t.b, t.c));
+	Consider(end,	ClosestPointOnTriangle(end, t.a, t.b, t.c));
+
+	const Vector3* edges[3][2] = { {&t.a, &t.b}, {&t.b, &t.c}, {&t.c, &t.a} };
+	for (auto& edge : edges) {
+		Vector3 segmentPoint;
+		Vector3 edgePoint;
+		ClosestSegmentPoints(start, end, *edge[0], *edge[1], segmentPoint, edgePoint);
+		Consider(segmentPoint, edgePoint);
+	}
+	return std::sqrt(bestDistSq);
+}
+
+/*
+A capsule is the joining together of a cylinder and two spheres, so the
+ray enters it wherever it first enters any of those three. The cylinder
+is only counted between the two spheres' centres - anywhere past them,
+the spheres stick out further anyway.
+Just like the box tests, a ray starting inside the capsule doesn't hit it.
+*/
 bool CollisionDetection::RayCapsuleIntersection(const Ray& r, const Transform& worldTransform, const CapsuleVolume& volume, RayCollision& collision)
 {
+	Vector3 rayPos = r.GetPosition();
+	Vector3 rayDir = r.GetDirection();
+
+	Vector3 start;
+	Vector3 end;
+	GetCapsuleSegment(volume, worldTransform, start, end);
+
+	float radius = volume.GetRadius();
+	if (Vector::LengthSquared(ClosestPointOnSegment(rayPos, start, end) - rayPos) <= radius * radius) {
+		return false;
+	}
+	float bestT = FLT_MAX;
+
+	Vector3 centre		= worldTransform.GetPosition();
+	Vector3 axis		= worldTransform.GetOrientation() * Vector3(0, 1, 0);
+	float halfLength	= Vector::Length(end - centre);
+
+	//The cylinder, worked out with everything flattened onto the plane the axis points out of
+	Vector3 flatDir		= rayDir - axis * Vector::Dot(rayDir, axis);
+	Vector3 flatOffset	= (rayPos - centre) - axis * Vector::Dot(rayPos - centre, axis);
+
+	float a = Vector::Dot(flatDir, flatDir);
+	float b = Vector::Dot(flatOffset, flatDir);
+	float c = Vector::Dot(flatOffset, flatOffset) - radius * radius;
+	if (a > 0.0f && b * b - a * c >= 0.0f) {
+		float t = (-b - std::sqrt(b * b - a * c)) / a;
+		if (t >= 0.0f && std::abs(Vector::Dot(rayPos + rayDir * t - centre, axis)) <= halfLength) {
+			bestT = t;
+		}
+	}
+
+	//And the two rounded ends
+	for (const Vector3& sphereCentre : { start, end }) {
+		Vector3 offset	= rayPos - sphereCentre;
+		float proj		= Vector::Dot(offset, rayDir);
+		float disc		= proj * proj - (Vector::Dot(offset, offset) - radius * radius);
+		if (disc < 0.0f) {
+			continue;
+		}
+		float t = -proj - std::sqrt(disc);
+		if (t >= 0.0f && t < bestT) {
+			bestT = t;
+		}
+	}
+
+	if (bestT == FLT_MAX) {
+		return false;
+	}
+	collision.rayDistance	= bestT;
+	collision.collidedAt	= rayPos + rayDir * bestT;
+	return true;
+}
+
+/*
+The ray is moved into the hull's own space, where it's clipped against
+the plane of every face - it's inside the hull only between the last
+plane it goes in through, and the first plane it comes out of. Scaling
+the ray along with the hull doesn't change how far along it each plane
+is, so the distances still hold in world space.
+*/
+bool CollisionDetection::RayConvexHullIntersection(const Ray& r, const Transform& worldTransform, const ConvexHullVolume& volume, RayCollision& collision) {
+	Quaternion invOrientation	= worldTransform.GetOrientation().Conjugate();
+	Vector3 scale				= volume.GetScale();
+	Vector3 start				= (invOrientation * (r.GetPosition() - worldTransform.GetPosition())) / scale;
+	Vector3 dir					= (invOrientation * r.GetDirection()) / scale;
+
+	float entry = -FLT_MAX;
+	float exit	= FLT_MAX;
+	for (const Plane& p : volume.GetHull()->GetFaces()) {
+		float facing	= Vector::Dot(p.GetNormal(), dir);
+		float distance	= p.DistanceFromPlane(start);
+		if (facing == 0.0f) {
+			if (distance > 0.0f) {
+				return false;
+			}
+			continue;
+		}
+		float t = -distance / facing;
+		if (facing < 0.0f) {
+			entry = std::max(entry, t);
+		}
+		else {
+			exit = std::min(exit, t);
+		}
+		if (entry > exit) {
+			return false;
+		}
+	}
+	if (entry < 0.0f) {
+		return false; //started inside the hull, or it's behind the ray
+	}
+	collision.rayDistance	= entry;
+	collision.collidedAt	= r.GetPosition() + r.GetDirection() * entry;
+	return true;
+}
+
+/*
+The ray is moved into the mesh's local space, and walked through its
+hierarchy, nearest boxes first. Each triangle the ray might reach is tested
+with the Moller-Trumbore method, which solves for how far along the ray it
+meets the triangle's plane, and where on the triangle that is, all at once.
+Rays can hit triangles from either side.
+*/
+bool CollisionDetection::RayTriangleMeshIntersection(const Ray& r, const Transform& worldTransform, const TriangleMeshVolume& volume, RayCollision& collision) {
+	const TriangleMesh* mesh	= volume.GetMesh();
+	Quaternion invOrientation	= worldTransform.GetOrientation().Conjugate();
+	Vector3 start				= invOrientation * (r.GetPosition() - worldTransform.GetPosition());
+	Vector3 dir					= invOrientation * r.GetDirection();
+
+	float closest = FLT_MAX;
+	mesh->Raycast(start, dir, closest,
+		[&](int triangle) {
+			const TriangleMesh::Triangle& t = mesh->GetTriangle(triangle);
+			Vector3 ab		= t.b - t.a;
+			Vector3 ac		= t.c - t.a;
+			Vector3 p		= Vector::Cross(dir, ac);
+			float det		= Vector::Dot(ab, p);
+			if (std::abs(det) < 1e-8f) {
+				return closest; //parallel to the triangle
+			}
+			float invDet	= 1.0f / det;
+			Vector3 offset	= start - t.a;
+			float u			= Vector::Dot(offset, p) * invDet;
+			if (u < 0.0f || u > 1.0f) {
+				return closest;
+			}
+			Vector3 q		= Vector::Cross(offset, ab);
+			float v			= Vector::Dot(dir, q) * invDet;
+			if (v < 0.0f || u + v > 1.0f) {
+				return closest;
+			}
+			float distance	= Vector::Dot(ac, q) * invDet;
+			if (distance >= 0.0f && distance < closest) {
+				closest = distance;
+			}
+			return closest;
+		}
+	);
+	if (closest == FLT_MAX) {
+		return false;
+	}
+	collision.rayDistance	= closest;
+	collision.collidedAt	= r.GetPosition() + r.GetDirection() * closest;
+	return true;
+}
+
+/*
+Each narrowphase test takes its own volume types, so the table holds small
+wrappers that cast the volumes back again. If the pair is the other way
+round to how the test wants it, the swapped wrapper also flips the objects
+in the collisionInfo, so that the contact normal still points from its a
+to its b.
+*/
+template <typename VolumeA, typename VolumeB, bool (*Test)(const VolumeA&, const Transform&, const VolumeB&, const Transform&, CollisionDetection::CollisionInfo&)>
+static bool PairIntersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionDetection::CollisionInfo& collisionInfo) {
+	return Test((const VolumeA&)volumeA, worldTransformA, (const VolumeB&)volumeB, worldTransformB, collisionInfo);
+}
+
+template <typename VolumeA, typename VolumeB, bool (*Test)(const VolumeA&, const Transform&, const VolumeB&, const Transform&, CollisionDetection::CollisionInfo&)>
+static bool SwappedPairIntersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionDetection::CollisionInfo& collisionInfo) {
+	std::swap(collisionInfo.a, collisionInfo.b);
+	return Test((const VolumeA&)volumeB, worldTransformB, (const VolumeB&)volumeA, worldTransformA, collisionInfo);
+}
+
+static bool NoIntersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionDetection::CollisionInfo& collisionInfo) {
 	return false;
 }
 
+static int VolumeTypeIndex(VolumeType type) {
+	return std::countr_zero((unsigned int)type);
+}
+
+struct IntersectionTable {
+	CollisionDetection::IntersectionFunction functions[CollisionDetection::PairTypeCount];
+
+	IntersectionTable() {
+		for (auto& f : functions) {
+			f = NoIntersection;
+		}
+		Add<AABBVolume,		AABBVolume,		CollisionDetection::AABBIntersection>(VolumeType::AABB, VolumeType::AABB);
+		Add<SphereVolume,	SphereVolume,	CollisionDetection::SphereIntersection>(VolumeType::Sphere, VolumeType::Sphere);
+		Add<OBBVolume,		OBBVolume,		CollisionDetection::OBBIntersection>(VolumeType::OBB, VolumeType::OBB);
+		Add<CapsuleVolume,	CapsuleVolume,	CollisionDetection::CapsuleIntersection>(VolumeType::Capsule, VolumeType::Capsule);
+
+		Add<OBBVolume,		AABBVolume,		CollisionDetection::OBBAABBIntersection>(VolumeType::OBB, VolumeType::AABB);
+		Add<AABBVolume,		SphereVolume,	CollisionDetection::AABBSphereIntersection>(VolumeType::AABB, VolumeType::Sphere);
+		Add<OBBVolume,		SphereVolume,	CollisionDetection::OBBSphereIntersection>(VolumeType::OBB, VolumeType::Sphere);
+
+		Add<CapsuleVolume,	SphereVolume,	CollisionDetection::SphereCapsuleIntersection>(VolumeType::Capsule, VolumeType::Sphere);
+		Add<CapsuleVolume,	AABBVolume,		CollisionDetection::AABBCapsuleIntersection>(VolumeType::Capsule, VolumeType::AABB);
+		Add<CapsuleVolume,	OBBVolume,		CollisionDetection::OBBCapsuleIntersection>(VolumeType::Capsule, VolumeType::OBB);
+
+		VolumeType convexTypes[] = { VolumeType::AABB, VolumeType::OBB, VolumeType::Sphere, VolumeType::Capsule, VolumeType::ConvexHull };
+		for (VolumeType type : convexTypes) {
+			//GJK doesn't mind which way round the volumes are, so hulls don't need swapping
+			functions[CollisionDetection::PairTypeIndex(VolumeType::ConvexHull, type)] = CollisionDetection::ConvexIntersection;
+			functions[CollisionDetection::PairTypeIndex(type, VolumeType::ConvexHull)] = CollisionDetection::ConvexIntersection;
+
+			Add<TriangleMeshVolume, CollisionVolume, CollisionDetection::TriangleMeshIntersection>(VolumeType::Mesh, type);
+		}
+	}
+
+	template <typename VolumeA, typename VolumeB, bool (*Test)(const VolumeA&, const Transform&, const VolumeB&, const Transform&, CollisionDetection::CollisionInfo&)>
+	void Add(VolumeType typeA, VolumeType typeB) {
+		functions[CollisionDetection::PairTypeIndex(typeA, typeB)] = PairIntersection<VolumeA, VolumeB, Test>;
+		if (typeA != typeB) {
+			functions[CollisionDetection::PairTypeIndex(typeB, typeA)] = SwappedPairIntersection<VolumeA, VolumeB, Test>;
+		}
+	}
+};
+
+static const IntersectionTable intersectionTable;
+
+int CollisionDetection::PairTypeIndex(VolumeType typeA, VolumeType typeB) {
+	return VolumeTypeIndex(typeA) * VolumeTypeCount + VolumeTypeIndex(typeB);
+}
+
+CollisionDetection::IntersectionFunction CollisionDetection::GetIntersectionFunction(int pairType) {
+	return intersectionTable.functions[pairType];
+}
+
 bool CollisionDetection::ObjectIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
 	const CollisionVolume* volA = a->GetBoundingVolume();
 	const CollisionVolume* volB = b->GetBoundingVolume();
@@ -173,65 +571,126 @@ bool CollisionDetection::ObjectIntersection(GameObject* a, GameObject* b, Collis
 	collisionInfo.a = a;
 	collisionInfo.b = b;
 
-	Transform& transformA = a->GetTransform();
-	Transform& transformB = b->GetTransform();
-
-	VolumeType pairType = (VolumeType)((int)volA->type | (int)volB->type);
+	IntersectionFunction test = GetIntersectionFunction(PairTypeIndex(volA->type, volB->type));
+	return test(*volA, a->GetTransform(), *volB, b->GetTransform(), collisionInfo);
+}
 
-	//Two AABBs
-	if (pairType == VolumeType::AABB) {
-		return AABBIntersection((AABBVolume&)*volA, transformA, (AABBVolume&)*volB, transformB, collisionInfo);
-	}
-	//Two Spheres
-	if (pairType == VolumeType::Sphere) {
-		return SphereIntersection((SphereVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
-	}
-	//Two OBBs
-	if (pairType == VolumeType::OBB) {
-		return OBBIntersection((OBBVolume&)*volA, transformA, (OBBVolume&)*volB, transformB, collisionInfo);
+/*
+Against a mesh, the moving volume is treated as a sphere big enough to hold
+it, and each triangle it could reach is pushed out along its normal by that
+radius, so the sphere's centre can be swept as a ray. That finds it hitting
+the face of a triangle exactly, but not clipping the edge of one (where the
+rounded shape the sphere really sweeps out is) - those glancing hits are
+left to the narrowphase. As with the narrowphase, triangles are one sided,
+and any the sphere has already reached don't count.
+*/
+static bool SweptTriangleMeshIntersection(float radius, const Transform& worldTransform, const Vector3& motion,
+	const TriangleMeshVolume& meshVolume, const Transform& meshTransform, float& hitFraction) {
+	const TriangleMesh* mesh	= meshVolume.GetMesh();
+	Quaternion invOrientation	= meshTransform.GetOrientation().Conjugate();
+	Vector3 start				= invOrientation * (worldTransform.GetPosition() - meshTransform.GetPosition());
+	Vector3 dir					= invOrientation * motion;
+
+	float firstHit = 1.0f;
+	bool hit		= false;
+	mesh->Raycast(start, dir, firstHit,
+		[&](int triangle) {
+			const TriangleMesh::Triangle& t = mesh->GetTriangle(triangle);
+			float startSide = Vector::Dot(t.normal, start - t.a) - radius;
+			float endSide	= Vector::Dot(t.normal, start + dir - t.a) - radius;
+			if (startSide < 0.0f || endSide >= 0.0f) {
+				return firstHit; //already touching it, or never reaches it
+			}
+			float fraction	= startSide / (startSide - endSide);
+			Vector3 contact = start + dir * fraction - t.normal * radius;
+			if (fraction < firstHit && PointInTriangle(contact, t)) {
+				firstHit	= fraction;
+				hit			= true;
+			}
+			return firstHit;
+		},
+		radius
+	);
+	if (hit) {
+		hitFraction = firstHit;
 	}
-	//Two Capsules
+	return hit;
+}
 
-	//AABB vs Sphere pairs
-	if (volA->type == VolumeType::AABB && volB->type == VolumeType::Sphere) {
-		return AABBSphereIntersection((AABBVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
+/*
+The moving volume is treated as a point, and the box grown by however far
+the volume reaches out along each of the box's axes. That grown box is a
+little bigger than the real shape the volume sweeps out (around the edges
+and corners), so the hit may be found slightly early - but never late,
+which is what matters for stopping objects passing through walls.
+*/
+bool CollisionDetection::SweptIntersection(const CollisionVolume& volume, const Transform& worldTransform, const Vector3& motion,
+	const CollisionVolume& boxVolume, const Transform& boxTransform, float& hitFraction) {
+	Vector3 halfSize;
+	Quaternion boxOrientation;
+
+	if (boxVolume.type == VolumeType::Mesh) {
+		float radius;
+		if (volume.type == VolumeType::Sphere) {
+			radius = ((const SphereVolume&)volume).GetRadius();
+		}
+		else if (volume.type == VolumeType::Capsule) {
+			radius = ((const CapsuleVolume&)volume).GetHalfHeight();
+		}
+		else {
+			return false;
+		}
+		return SweptTriangleMeshIntersection(radius, worldTransform, motion, (const TriangleMeshVolume&)boxVolume, boxTransform, hitFraction);
 	}
-	if (volA->type == VolumeType::Sphere && volB->type == VolumeType::AABB) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return AABBSphereIntersection((AABBVolume&)*volB, transformB, (SphereVolume&)*volA, transformA, collisionInfo);
+	if (boxVolume.type == VolumeType::AABB) {
+		halfSize = ((const AABBVolume&)boxVolume).GetHalfDimensions();
 	}
-
-	//OBB vs sphere pairs
-	if (volA->type == VolumeType::OBB && volB->type == VolumeType::Sphere) {
-		return OBBSphereIntersection((OBBVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
+	else if (boxVolume.type == VolumeType::OBB) {
+		halfSize		= ((const OBBVolume&)boxVolume).GetHalfDimensions();
+		boxOrientation	= boxTransform.GetOrientation();
 	}
-	if (volA->type == VolumeType::Sphere && volB->type == VolumeType::OBB) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return OBBSphereIntersection((OBBVolume&)*volB, transformB, (SphereVolume&)*volA, transformA, collisionInfo);
+	else {
+		return false;
 	}
+	Quaternion invBoxOrientation = boxOrientation.Conjugate();
 
-	//Capsule vs other interactions
-	if (volA->type == VolumeType::Capsule && volB->type == VolumeType::Sphere) {
-		return SphereCapsuleIntersection((CapsuleVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
+	Vector3 reach;
+	if (volume.type == VolumeType::Sphere) {
+		float r = ((const SphereVolume&)volume).GetRadius();
+		reach = Vector3(r, r, r);
 	}
-	if (volA->type == VolumeType::Sphere && volB->type == VolumeType::Capsule) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return SphereCapsuleIntersection((CapsuleVolume&)*volB, transformB, (SphereVolume&)*volA, transformA, collisionInfo);
+	else if (volume.type == VolumeType::Capsule) {
+		const CapsuleVolume& capsule = (const CapsuleVolume&)volume;
+		float r = capsule.GetRadius();
+		Vector3 axis = invBoxOrientation * (worldTransform.GetOrientation() * Vector3(0, capsule.GetHalfHeight() - r, 0));
+		reach = Vector3(std::abs(axis.x) + r, std::abs(axis.y) + r, std::abs(axis.z) + r);
 	}
-
-	if (volA->type == VolumeType::Capsule && volB->type == VolumeType::AABB) {
-		return AABBCapsuleIntersection((CapsuleVolume&)*volA, transformA, (AABBVolume&)*volB, transformB, collisionInfo);
+	else {
+		return false;
 	}
-	if (volB->type == VolumeType::Capsule && volA->type == VolumeType::AABB) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return AABBCapsuleIntersection((CapsuleVolume&)*volB, transformB, (AABBVolume&)*volA, transformA, collisionInfo);
+	Vector3 boxSize = halfSize + reach;
+	Vector3 start	= invBoxOrientation * (worldTransform.GetPosition() - boxTransform.GetPosition());
+	Vector3 dir		= invBoxOrientation * motion;
+
+	float entry = -FLT_MAX;
+	float exit	= FLT_MAX;
+	for (int i = 0; i < 3; ++i) {
+		if (dir[i] == 0.0f) {
+			if (std::abs(start[i]) >= boxSize[i]) {
+				return false; //moving parallel to this pair of faces, and outside of them
+			}
+			continue;
+		}
+		float t0 = (-boxSize[i] - start[i]) / dir[i];
+		float t1 = ( boxSize[i] - start[i]) / dir[i];
+		entry	= std::max(entry, std::min(t0, t1));
+		exit	= std::min(exit, std::max(t0, t1));
 	}
-
-	return false;
+	if (entry > exit || entry < 0.0f || entry > 1.0f) {
+		return false;
+	}
+	hitFraction = entry;
+	return true;
 }
 
 bool CollisionDetection::AABBTest(const Vector3& posA, const Vector3& posB, const Vector3& halfSizeA, const Vector3& halfSizeB) {
@@ -357,28 +816,1147 @@ bool CollisionDetection::AABBSphereIntersection(
 }
 
 
-bool  CollisionDetection::OBBSphereIntersection(const OBBVolume& volumeA, const Transform& worldTransformA,
+/*
+Tests a sphere against a box that might be rotated. The sphere's centre is
+moved into the box's local space, where the closest point on the box is
+just the centre clamped to the box's size. If the centre has ended up
+inside the box, the sphere is instead pushed out of whichever face is
+closest to it.
+The normal points from the box towards the sphere, and boxPoint is the
+deepest point on the box's surface, both in world space.
+*/
+static bool BoxSphereContact(const Vector3& boxPosition, const Quaternion& boxOrientation, const Vector3& halfSize,
+	const Vector3& centre, float radius, Vector3& normal, Vector3& boxPoint, float& penetration) {
+	Vector3 local	= boxOrientation.Conjugate() * (centre - boxPosition);
+	Vector3 closest = Vector::Clamp(local, -halfSize, halfSize);
+	Vector3 delta	= local - closest;
+	float distSq	= Vector::Dot(delta, delta);
+
+	Vector3 localNormal;
+	if (distSq > 0.0f) {
+		if (distSq >= radius * radius) {
+			return false;
+		}
+		float dist	= std::sqrt(distSq);
+		localNormal = delta / dist;
+		penetration = radius - dist;
+	}
+	else {
+		int		bestAxis	= 0;
+		float	bestDepth	= FLT_MAX;
+		for (int i = 0; i < 3; ++i) {
+			float depth = halfSize[i] - std::abs(local[i]);
+			if (depth < bestDepth) {
+				bestDepth	= depth;
+				bestAxis	= i;
+			}
+		}
+		float side = local[bestAxis] < 0.0f ? -1.0f : 1.0f;
+		localNormal[bestAxis]	= side;
+		closest[bestAxis]		= side * halfSize[bestAxis];
+		penetration				= radius + bestDepth;
+	}
+	normal		= boxOrientation * localNormal;
+	boxPoint	= boxPosition + boxOrientation * closest;
+	return true;
+}
+
+/*
+How far a point is from the surface of a box, in the box's local space -
+negative when it's inside. This is a convex function, so the deepest
+point of a line segment can be found by a simple ternary search along it.
+*/
+static float BoxSignedDistance(const Vector3& halfSize, const Vector3& point) {
+	Vector3 q = Vector3(std::abs(point.x), std::abs(point.y), std::abs(point.z)) - halfSize;
+	Vector3 outside(std::max(q.x, 0.0f), std::max(q.y, 0.0f), std::max(q.z, 0.0f));
+	return Vector::Length(outside) + std::min(Vector::GetMaxElement(q), 0.0f);
+}
+
+/*
+If the line through the middle of the capsule misses the box, the capsule
+touches it like a sphere would, centred on the closest point of the line.
+If it goes through the box, there's no closest point to go on, so it's
+treated like a very thin box instead, with a separating axis test against
+the box's 3 face normals, and the 3 directions perpendicular to both the
+line and one of the box's edges.
+*/
+static bool BoxCapsuleContact(const Vector3& boxPosition, const Quaternion& boxOrientation, const Vector3& halfSize,
+	const CapsuleVolume& capsule, const Transform& capsuleTransform, CollisionDetection::CollisionInfo& collisionInfo) {
+	Vector3 start;
+	Vector3 end;
+	GetCapsuleSegment(capsule, capsuleTransform, start, end);
+
+	float radius				= capsule.GetRadius();
+	Quaternion invOrientation	= boxOrientation.Conjugate();
+	Vector3 localStart			= invOrientation * (start - boxPosition);
+	Vector3 localDir			= invOrientation * (end - start);
+
+	float lo = 0.0f;
+	float hi = 1.0f;
+	for (int i = 0; i < 24; ++i) {
+		float t0 = lo + (hi - lo) / 3.0f;
+		float t1 = hi - (hi - lo) / 3.0f;
+		if (BoxSignedDistance(halfSize, localStart + localDir * t0) < BoxSignedDistance(halfSize, localStart + localDir * t1)) {
+			hi = t1;
+		}
+		else {
+			lo = t0;
+		}
+	}
+	float deepestT = (lo + hi) * 0.5f;
+
+	Vector3 boxNormal;
+	Vector3 capsulePoint;
+	float	penetration;
+
+	if (BoxSignedDistance(halfSize, localStart + localDir * deepestT) > 0.0f) {
+		Vector3 boxPoint;
+		if (!BoxSphereContact(boxPosition, boxOrientation, halfSize, start + (end - start) * deepestT, radius, boxNormal, boxPoint, penetration)) {
+			return false;
+		}
+		capsulePoint = start + (end - start) * deepestT - boxNormal * radius;
+	}
+	else {
+		Vector3 localCentre = localStart + localDir * 0.5f;
+		Vector3 halfDir		= localDir * 0.5f;
+
+		penetration = FLT_MAX;
+		Vector3 localNormal;
+		for (int i = 0; i < 6; ++i) {
+			Vector3 axis;
+			if (i < 3) {
+				axis[i] = 1.0f;
+			}
+			else {
+				Vector3 edge;
+				edge[i - 3] = 1.0f;
+				axis = Vector::Cross(edge, halfDir);
+				float length = Vector::Length(axis);
+				if (length < 1e-4f) {
+					continue;
+				}
+				axis = axis / length;
+			}
+			float boxReach		= halfSize.x * std::abs(axis.x) + halfSize.y * std::abs(axis.y) + halfSize.z * std::abs(axis.z);
+			float capsuleReach	= std::abs(Vector::Dot(halfDir, axis)) + radius;
+			float distance		= Vector::Dot(localCentre, axis);
+			float overlap		= boxReach + capsuleReach - std::abs(distance);
+			if (overlap < penetration) {
+				penetration = overlap;
+				localNormal = distance < 0.0f ? -axis : axis;
+			}
+		}
+		boxNormal = boxOrientation * localNormal;
+
+		//Whichever end of the line is pushed furthest into the box
+		Vector3 deepestEnd = Vector::Dot(end - start, boxNormal) > 0.0f ? start : end;
+		capsulePoint = deepestEnd - boxNormal * radius;
+	}
+	//The capsule is object A, so the normal has to point from it towards the box
+	Vector3 boxPoint = capsulePoint + boxNormal * penetration;
+	collisionInfo.AddContactPoint(capsulePoint - capsuleTransform.GetPosition(), boxPoint - boxPosition, -boxNormal, penetration);
+	return true;
+}
+
+static bool SphereSphereContact(const Vector3& centreA, float radiusA, const Vector3& centreB, float radiusB,
+	const Vector3& fallbackNormal, Vector3& normal, float& penetration) {
+	Vector3 delta	= centreB - centreA;
+	float radii		= radiusA + radiusB;
+	float distSq	= Vector::Dot(delta, delta);
+	if (distSq >= radii * radii) {
+		return false;
+	}
+	float dist	= std::sqrt(distSq);
+	normal		= dist > 0.0f ? delta / dist : fallbackNormal;
+	penetration = radii - dist;
+	return true;
+}
+
+/*
+The separating axis test between two boxes. If there's any direction the
+boxes can be projected onto without their shadows overlapping, they can't
+be touching - and for boxes, there are only 15 directions worth trying:
+the 3 face normals of each box, and the 9 directions perpendicular to an
+edge of each box. If none of them separate the boxes, the one with the
+least overlap is the best way to push them apart.
+
+All 15 axes go through the same few sums, so they're laid out side by side
+and worked on 4 (or with AVX, 8) at a time using SIMD instructions. The
+edge axes come from cross products, which can be very short (or zero) if
+the edges are nearly parallel - those are skipped, as their direction
+can't be trusted.
+*/
+static bool BoxBoxContact(const Vector3& positionA, const Quaternion& orientationA, const Vector3& halfSizeA,
+	const Vector3& positionB, const Quaternion& orientationB, const Vector3& halfSizeB, CollisionDetection::CollisionInfo& collisionInfo) {
+	static constexpr int AxisCount	= 15;
+	static constexpr int LaneCount	= ((AxisCount + SimdWidth - 1) / SimdWidth) * SimdWidth;
+
+	Vector3 axesA[3];
+	Vector3 axesB[3];
+	for (int i = 0; i < 3; ++i) {
+		Vector3 unit;
+		unit[i]		= 1.0f;
+		axesA[i]	= orientationA * unit;
+		axesB[i]	= orientationB * unit;
+	}
+	Vector3 offset = positionB - positionA;
+
+	float axisX[LaneCount];
+	float axisY[LaneCount];
+	float axisZ[LaneCount];
+	for (int i = 0; i < LaneCount; ++i) {
+		Vector3 axis;
+		if (i < 3) {
+			axis = axesA[i];
+		}
+		else if (i < 6) {
+			axis = axesB[i - 3];
+		}
+		else if (i < AxisCount) {
+			axis = Vector::Cross(axesA[(i - 6) / 3], axesB[(i - 6) % 3]);
+		}
+		axisX[i] = axis.x;
+		axisY[i] = axis.y;
+		axisZ[i] = axis.z;
+	}
+
+	float overlap[LaneCount];
+	int separated = 0;
+	for (int i = 0; i < LaneCount; i += SimdWidth) {
+		SimdFloat x = SimdLoad(&axisX[i]);
+		SimdFloat y = SimdLoad(&axisY[i]);
+		SimdFloat z = SimdLoad(&axisZ[i]);
+
+		auto Project = [&](const Vector3& v) {
+			return SimdAbs(SimdAdd(SimdAdd(SimdMul(x, SimdSet(v.x)), SimdMul(y, SimdSet(v.y))), SimdMul(z, SimdSet(v.z))));
+		};
+		SimdFloat reach = SimdSet(0.0f);
+		for (int j = 0; j < 3; ++j) {
+			reach = SimdAdd(reach, SimdMul(Project(axesA[j]), SimdSet(halfSizeA[j])));
+			reach = SimdAdd(reach, SimdMul(Project(axesB[j]), SimdSet(halfSizeB[j])));
+		}
+		SimdFloat lengthSq	= SimdAdd(SimdAdd(SimdMul(x, x), SimdMul(y, y)), SimdMul(z, z));
+		SimdFloat valid		= SimdGreater(lengthSq, SimdSet(1e-6f));
+		SimdFloat length	= SimdSqrt(SimdMax(lengthSq, SimdSet(1e-6f)));
+		SimdFloat depth		= SimdDiv(SimdSub(reach, Project(offset)), length);
+
+		separated |= SimdMask(SimdAnd(valid, SimdLess(depth, SimdSet(0.0f))));
+		SimdStore(&overlap[i], SimdSelect(valid, depth, SimdSet(FLT_MAX)));
+	}
+	if (separated) {
+		return false;
+	}
+
+	int bestFace = 0;
+	for (int i = 1; i < 6; ++i) {
+		if (overlap[i] < overlap[bestFace]) {
+			bestFace = i;
+		}
+	}
+	int bestEdge = 6;
+	for (int i = 7; i < AxisCount; ++i) {
+		if (overlap[i] < overlap[bestEdge]) {
+			bestEdge = i;
+		}
+	}
+	//Face contacts are much more stable, so an edge has to be clearly better to be used
+	int best = overlap[bestEdge] < overlap[bestFace] * 0.95f - 0.01f ? bestEdge : bestFace;
+
+	float penetration	= overlap[best];
+	Vector3 normal		= Vector::Normalise(Vector3(axisX[best], axisY[best], axisZ[best]));
+	if (Vector::Dot(normal, offset) < 0.0f) {
+		normal = -normal;
+	}
+
+	/*
+	The corner of a box that reaches furthest in a direction. Axes that run
+	almost flat against that direction pick the middle of the face or edge
+	instead, so a box resting flat on another gets its contact in the middle
+	of the two, rather than jumping between corners.
+	*/
+	auto SupportPoint = [](const Vector3& position, const Vector3* axes, const Vector3& halfSize, const Vector3& dir) {
+		Vector3 point = position;
+		for (int i = 0; i < 3; ++i) {
+			float d = Vector::Dot(axes[i], dir);
+			if (std::abs(d) > 0.001f) {
+				point += axes[i] * (d > 0.0f ? halfSize[i] : -halfSize[i]);
+			}
+		}
+		return point;
+	};
+	//Keeps a point within the sides of a box's face, so it stays where the boxes really overlap
+	auto ClampToFace = [](const Vector3& point, const Vector3& position, const Vector3* axes, const Vector3& halfSize, int faceAxis) {
+		Vector3 result = point;
+		for (int i = 0; i < 3; ++i) {
+			if (i == faceAxis) {
+				continue;
+			}
+			float d = Vector::Dot(point - position, axes[i]);
+			result += axes[i] * (std::clamp(d, -halfSize[i], halfSize[i]) - d);
+		}
+		return result;
+	};
+
+	Vector3 pointA;
+	Vector3 pointB;
+	if (best < 3) {			//a face of A, hit by the deepest part of B
+		pointB = ClampToFace(SupportPoint(positionB, axesB, halfSizeB, -normal), positionA, axesA, halfSizeA, best);
+		pointA = pointB + normal * penetration;
+	}
+	else if (best < 6) {	//a face of B, hit by the deepest part of A
+		pointA = ClampToFace(SupportPoint(positionA, axesA, halfSizeA, normal), positionB, axesB, halfSizeB, best - 3);
+		pointB = pointA - normal * penetration;
+	}
+	else {					//an edge of each, crossing over
+		int edgeA = (best - 6) / 3;
+		int edgeB = (best - 6) % 3;
+		Vector3 centreA = SupportPoint(positionA, axesA, halfSizeA, normal - axesA[edgeA] * Vector::Dot(normal, axesA[edgeA]));
+		Vector3 centreB = SupportPoint(positionB, axesB, halfSizeB, -normal + axesB[edgeB] * Vector::Dot(normal, axesB[edgeB]));
+		Vector3 alongA	= axesA[edgeA] * halfSizeA[edgeA];
+		Vector3 alongB	= axesB[edgeB] * halfSizeB[edgeB];
+		Vector3 closestA;
+		Vector3 closestB;
+		ClosestSegmentPoints(centreA - alongA, centreA + alongA, centreB - alongB, centreB + alongB, closestA, closestB);
+		Vector3 middle = (closestA + closestB) * 0.5f;
+		pointA = middle + normal * (penetration * 0.5f);
+		pointB = middle - normal * (penetration * 0.5f);
+	}
+	collisionInfo.AddContactPoint(pointA - positionA, pointB - positionB, normal, penetration);
+	return true;
+}
+
+bool CollisionDetection::OBBSphereIntersection(const OBBVolume& volumeA, const Transform& worldTransformA,
 	const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
-	return false;
+	Vector3 normal;
+	Vector3 boxPoint;
+	float	penetration;
+	if (!BoxSphereContact(worldTransformA.GetPosition(), worldTransformA.GetOrientation(), volumeA.GetHalfDimensions(),
+		worldTransformB.GetPosition(), volumeB.GetRadius(), normal, boxPoint, penetration)) {
+		return false;
+	}
+	collisionInfo.AddContactPoint(boxPoint - worldTransformA.GetPosition(), -normal * volumeB.GetRadius(), normal, penetration);
+	return true;
 }
 
 bool CollisionDetection::AABBCapsuleIntersection(
 	const CapsuleVolume& volumeA, const Transform& worldTransformA,
 	const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
-	return false;
+	return BoxCapsuleContact(worldTransformB.GetPosition(), Quaternion(), volumeB.GetHalfDimensions(), volumeA, worldTransformA, collisionInfo);
+}
+
+bool CollisionDetection::OBBCapsuleIntersection(
+	const CapsuleVolume& volumeA, const Transform& worldTransformA,
+	const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	return BoxCapsuleContact(worldTransformB.GetPosition(), worldTransformB.GetOrientation(), volumeB.GetHalfDimensions(), volumeA, worldTransformA, collisionInfo);
 }
 
 bool CollisionDetection::SphereCapsuleIntersection(
 	const CapsuleVolume& volumeA, const Transform& worldTransformA,
 	const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
-	return false;
+	Vector3 start;
+	Vector3 end;
+	GetCapsuleSegment(volumeA, worldTransformA, start, end);
+
+	Vector3 closest = ClosestPointOnSegment(worldTransformB.GetPosition(), start, end);
+
+	Vector3 normal;
+	float	penetration;
+	if (!SphereSphereContact(closest, volumeA.GetRadius(), worldTransformB.GetPosition(), volumeB.GetRadius(),
+		worldTransformA.GetOrientation() * Vector3(1, 0, 0), normal, penetration)) {
+		return false;
+	}
+	Vector3 localA = closest + normal * volumeA.GetRadius() - worldTransformA.GetPosition();
+	Vector3 localB = -normal * volumeB.GetRadius();
+	collisionInfo.AddContactPoint(localA, localB, normal, penetration);
+	return true;
+}
+
+bool CollisionDetection::CapsuleIntersection(
+	const CapsuleVolume& volumeA, const Transform& worldTransformA,
+	const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	Vector3 startA;
+	Vector3 endA;
+	Vector3 startB;
+	Vector3 endB;
+	GetCapsuleSegment(volumeA, worldTransformA, startA, endA);
+	GetCapsuleSegment(volumeB, worldTransformB, startB, endB);
+
+	Vector3 closestA;
+	Vector3 closestB;
+	ClosestSegmentPoints(startA, endA, startB, endB, closestA, closestB);
+
+	Vector3 normal;
+	float	penetration;
+	if (!SphereSphereContact(closestA, volumeA.GetRadius(), closestB, volumeB.GetRadius(),
+		worldTransformA.GetOrientation() * Vector3(1, 0, 0), normal, penetration)) {
+		return false;
+	}
+	Vector3 localA = closestA + normal * volumeA.GetRadius() - worldTransformA.GetPosition();
+	Vector3 localB = closestB - normal * volumeB.GetRadius() - worldTransformB.GetPosition();
+	collisionInfo.AddContactPoint(localA, localB, normal, penetration);
+	return true;
 }
 
 bool CollisionDetection::OBBIntersection(const OBBVolume& volumeA, const Transform& worldTransformA,
 	const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	return BoxBoxContact(worldTransformA.GetPosition(), worldTransformA.GetOrientation(), volumeA.GetHalfDimensions(),
+		worldTransformB.GetPosition(), worldTransformB.GetOrientation(), volumeB.GetHalfDimensions(), collisionInfo);
+}
+
+//An AABB is just an OBB that never rotates, whatever its transform says
+bool CollisionDetection::OBBAABBIntersection(const OBBVolume& volumeA, const Transform& worldTransformA,
+	const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	return BoxBoxContact(worldTransformA.GetPosition(), worldTransformA.GetOrientation(), volumeA.GetHalfDimensions(),
+		worldTransformB.GetPosition(), Quaternion(), volumeB.GetHalfDimensions(), collisionInfo);
+}
+
+/*
+GJK and EPA work on any convex shape, so long as it can say which of its
+points is furthest along a given direction. Each of our volumes can be
+described as a handful of 'core' vertices with a radius wrapped around
+them - a sphere is a single point, a capsule is a line, and boxes and
+hulls are just their corners, with no radius. The vertices are numbered,
+so that the simplex GJK finishes with can be remembered between frames.
+
+GJK only ever looks at the cores, which keeps it away from the rounded
+surfaces it finds hardest to converge on. The radii are added back on at
+the end, by moving each closest point out along the contact normal.
+*/
+struct SupportShape {
+	Vector3				position;
+	Quaternion			orientation;
+	Quaternion			invOrientation;
+	VolumeType			type;
+	Vector3				size;		//box half size, hull scale, or the top of a capsule's line
+	const ConvexHull*	hull		= nullptr;
+	Vector3				corners[3];	//a triangle's corners, around its centre
+	float				radius		= 0.0f;
+	int					vertexCount = 0;
+
+	SupportShape(const CollisionVolume& volume, const Transform& transform)
+	{
+		position	= transform.GetPosition();
+		orientation = transform.GetOrientation();
+		type		= volume.type;
+
+		switch (volume.type) {
+			case VolumeType::AABB:
+				orientation = Quaternion();
+				size		= ((const AABBVolume&)volume).GetHalfDimensions();
+				vertexCount = 8;
+				break;
+			case VolumeType::OBB:
+				size		= ((const OBBVolume&)volume).GetHalfDimensions();
+				vertexCount = 8;
+				break;
+			case VolumeType::Sphere:
+				radius		= ((const SphereVolume&)volume).GetRadius();
+				vertexCount = 1;
+				break;
+			case VolumeType::Capsule:
+				radius		= ((const CapsuleVolume&)volume).GetRadius();
+				size		= Vector3(0, ((const CapsuleVolume&)volume).GetHalfHeight() - radius, 0);
+				vertexCount = 2;
+				break;
+			case VolumeType::ConvexHull:
+				hull		= ((const ConvexHullVolume&)volume).GetHull();
+				size		= ((const ConvexHullVolume&)volume).GetScale();
+				vertexCount = hull->GetVertexCount();
+				break;
+			default: break; //meshes are tested a triangle at a time, through the other constructor
+		}
+		invOrientation = orientation.Conjugate();
+	}
+
+	//A single triangle from a mesh, already in world space
+	SupportShape(const TriangleMesh::Triangle& t)
+	{
+		position	= (t.a + t.b + t.c) / 3.0f;
+		type		= VolumeType::Mesh;
+		corners[0]	= t.a - position;
+		corners[1]	= t.b - position;
+		corners[2]	= t.c - position;
+		vertexCount = 3;
+	}
+
+	Vector3 GetVertex(int i) const
+	{
+		Vector3 local;
+		switch (type) {
+			case VolumeType::AABB:
+			case VolumeType::OBB:
+				local = Vector3((i & 1) ? size.x : -size.x, (i & 2) ? size.y : -size.y, (i & 4) ? size.z : -size.z);
+				break;
+			case VolumeType::Capsule:		local = i ? size : -size; break;
+			case VolumeType::ConvexHull:	local = hull->GetVertex(i) * size; break;
+			case VolumeType::Mesh:			return position + corners[i];
+			default: break; //a sphere's only vertex is its centre
+		}
+		return position + orientation * local;
+	}
+
+	int GetSupportVertex(const Vector3& direction, int hint) const
+	{
+		Vector3 local = invOrientation * direction;
+		switch (type) {
+			case VolumeType::AABB:
+			case VolumeType::OBB:
+				return (local.x >= 0.0f ? 1 : 0) | (local.y >= 0.0f ? 2 : 0) | (local.z >= 0.0f ? 4 : 0);
+			case VolumeType::Capsule:
+				return local.y >= 0.0f ? 1 : 0;
+			case VolumeType::ConvexHull:
+				//Scaling the hull and then searching is the same as searching along a scaled direction
+				return hull->GetSupportVertex(local * size, hint);
+			case VolumeType::Mesh: {
+				float dots[3] = { Vector::Dot(corners[0], local), Vector::Dot(corners[1], local), Vector::Dot(corners[2], local) };
+				return dots[0] >= dots[1] ? (dots[0] >= dots[2] ? 0 : 2) : (dots[1] >= dots[2] ? 1 : 2);
+			}
+			default: return 0;
+		}
+	}
+};
+
+//A point on the Minkowski difference B - A, and the two points it came from
+struct SimplexVertex {
+	Vector3 pointA;
+	Vector3 pointB;
+	Vector3 w;
+	int		indexA;
+	int		indexB;
+	float	weight;		//how much of this vertex makes up the closest point
+};
+
+struct Simplex {
+	SimplexVertex	v[4];
+	int				count = 0;
+
+	void Add(const SupportShape& shapeA, const SupportShape& shapeB, int indexA, int indexB)
+	{
+		SimplexVertex& s = v[count++];
+		s.indexA	= indexA;
+		s.indexB	= indexB;
+		s.pointA	= shapeA.GetVertex(indexA);
+		s.pointB	= shapeB.GetVertex(indexB);
+		s.w			= s.pointB - s.pointA;
+		s.weight	= 1.0f;
+	}
+
+	bool Contains(int indexA, int indexB) const
+	{
+		for (int i = 0; i < count; ++i) {
+			if (v[i].indexA == indexA && v[i].indexB == indexB) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Vector3 GetClosestPoint() const
+	{
+		Vector3 p;
+		for (int i = 0; i < count; ++i) {
+			p += v[i].w * v[i].weight;
+		}
+		return p;
+	}
+
+	void GetClosestPoints(Vector3& pointA, Vector3& pointB) const
+	{
+		pointA = Vector3();
+		pointB = Vector3();
+		for (int i = 0; i < count; ++i) {
+			pointA += v[i].pointA * v[i].weight;
+			pointB += v[i].pointB * v[i].weight;
+		}
+	}
+};
+
+static void SetSimplex(Simplex& s, const SimplexVertex& a, float weight) {
+	s.v[0]			= a;
+	s.v[0].weight	= weight;
+	s.count			= 1;
+}
+
+static void SetSimplex(Simplex& s, const SimplexVertex& a, float weightA, const SimplexVertex& b, float weightB) {
+	s.v[0]			= a;
+	s.v[1]			= b;
+	s.v[0].weight	= weightA;
+	s.v[1].weight	= weightB;
+	s.count			= 2;
+}
+
+/*
+Each of these finds the closest point of the simplex to the origin, and
+throws away any vertices that aren't needed to make it. This is the same
+as the closest point on a line or triangle tests in Ericson's Real-Time
+Collision Detection, just with the origin as the point.
+*/
+static void SolveSegment(Simplex& s) {
+	SimplexVertex a = s.v[0];
+	SimplexVertex b = s.v[1];
+	Vector3 ab		= b.w - a.w;
+	float t			= Vector::Dot(-a.w, ab);
+	float lengthSq	= Vector::Dot(ab, ab);
+	if (t <= 0.0f || lengthSq <= 0.0f) {
+		SetSimplex(s, a, 1.0f);
+	}
+	else if (t >= lengthSq) {
+		SetSimplex(s, b, 1.0f);
+	}
+	else {
+		t /= lengthSq;
+		SetSimplex(s, a, 1.0f - t, b, t);
+	}
+}
+
+static void SolveTriangle(Simplex& s) {
+	SimplexVertex a = s.v[0];
+	SimplexVertex b = s.v[1];
+	SimplexVertex c = s.v[2];
+	Vector3 ab = b.w - a.w;
+	Vector3 ac = c.w - a.w;
+
+	float d1 = Vector::Dot(ab, -a.w);
+	float d2 = Vector::Dot(ac, -a.w);
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		SetSimplex(s, a, 1.0f);
+		return;
+	}
+	float d3 = Vector::Dot(ab, -b.w);
+	float d4 = Vector::Dot(ac, -b.w);
+	if (d3 >= 0.0f && d4 <= d3) {
+		SetSimplex(s, b, 1.0f);
+		return;
+	}
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		float t = d1 / (d1 - d3);
+		SetSimplex(s, a, 1.0f - t, b, t);
+		return;
+	}
+	float d5 = Vector::Dot(ab, -c.w);
+	float d6 = Vector::Dot(ac, -c.w);
+	if (d6 >= 0.0f && d5 <= d6) {
+		SetSimplex(s, c, 1.0f);
+		return;
+	}
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		float t = d2 / (d2 - d6);
+		SetSimplex(s, a, 1.0f - t, c, t);
+		return;
+	}
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		SetSimplex(s, b, 1.0f - t, c, t);
+		return;
+	}
+	float total = va + vb + vc;
+	if (total <= 0.0f) {
+		//The triangle has no area, so the answer must be on one of its edges
+		Simplex best;
+		float bestDistSq = FLT_MAX;
+		const SimplexVertex* edges[3][2] = { {&a, &b}, {&a, &c}, {&b, &c} };
+		for (auto& edge : edges) {
+			Simplex e;
+			SetSimplex(e, *edge[0], 1.0f, *edge[1], 1.0f);
+			SolveSegment(e);
+			Vector3 p = e.GetClosestPoint();
+			if (Vector::Dot(p, p) < bestDistSq) {
+				bestDistSq	= Vector::Dot(p, p);
+				best		= e;
+			}
+		}
+		s = best;
+		return;
+	}
+	s.v[0].weight = va / total;
+	s.v[1].weight = vb / total;
+	s.v[2].weight = vc / total;
+}
+
+/*
+If the origin is behind all four faces of the tetrahedron, it's inside it,
+and the shapes overlap. Otherwise, the closest point is on one of the
+faces the origin is in front of. A very flat tetrahedron can't be trusted
+to say which side of its faces anything is, so all of its faces are tried.
+*/
+static bool SolveTetrahedron(Simplex& s) {
+	static const int faces[4][4] = { {0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0} };
+
+	float size = 0.0f;
+	for (int i = 1; i < 4; ++i) {
+		size = std::max(size, Vector::Length(s.v[i].w - s.v[0].w));
+	}
+	float volume	= Vector::Dot(Vector::Cross(s.v[1].w - s.v[0].w, s.v[2].w - s.v[0].w), s.v[3].w - s.v[0].w);
+	bool flat		= std::abs(volume) <= 1e-5f * size * size * size;
+
+	Simplex best;
+	float bestDistSq = FLT_MAX;
+	for (const int* face : faces) {
+		const Vector3& p	= s.v[face[0]].w;
+		Vector3 normal		= Vector::Cross(s.v[face[1]].w - p, s.v[face[2]].w - p);
+		float originSide	= Vector::Dot(-p, normal);
+		float oppositeSide	= Vector::Dot(s.v[face[3]].w - p, normal);
+		if (!flat && originSide * oppositeSide >= 0.0f) {
+			continue;
+		}
+		Simplex t;
+		t.v[0]	= s.v[face[0]];
+		t.v[1]	= s.v[face[1]];
+		t.v[2]	= s.v[face[2]];
+		t.count = 3;
+		SolveTriangle(t);
+		Vector3 closest = t.GetClosestPoint();
+		if (Vector::Dot(closest, closest) < bestDistSq) {
+			bestDistSq	= Vector::Dot(closest, closest);
+			best		= t;
+		}
+	}
+	if (bestDistSq == FLT_MAX) {
+		return true;
+	}
+	s = best;
 	return false;
 }
 
+static constexpr int	GJKMaxIterations	= 32;
+static constexpr float	GJKTolerance		= 1e-4f;
+
+/*
+GJK looks for the point of the Minkowski difference B - A (every point of
+B, minus every point of A) that's closest to the origin - if the shapes
+overlap, the difference contains the origin, and otherwise the closest
+point is the gap between them. It keeps a simplex (a point, line, triangle
+or tetrahedron) of points from the difference, and on each iteration adds
+the furthest point towards the origin, and keeps just the part of the
+simplex closest to it, until it can't get any closer.
+
+Returns the distance between the cores of the two shapes, or 0 if they
+overlap, in which case the simplex is left for EPA to start from.
+*/
+static float GJKDistance(const SupportShape& shapeA, const SupportShape& shapeB, CollisionDetection::SimplexCache& cache,
+	Simplex& simplex, Vector3& pointA, Vector3& pointB) {
+	simplex.count = 0;
+	for (int i = 0; i < cache.count; ++i) {
+		if (cache.indexA[i] < shapeA.vertexCount && cache.indexB[i] < shapeB.vertexCount &&
+			!simplex.Contains(cache.indexA[i], cache.indexB[i])) {
+			simplex.Add(shapeA, shapeB, cache.indexA[i], cache.indexB[i]);
+		}
+	}
+	if (simplex.count == 0) {
+		Vector3 dir = shapeB.position - shapeA.position;
+		if (Vector::Dot(dir, dir) == 0.0f) {
+			dir = Vector3(1, 0, 0);
+		}
+		simplex.Add(shapeA, shapeB, shapeA.GetSupportVertex(-dir, 0), shapeB.GetSupportVertex(dir, 0));
+	}
+	int hintA = simplex.v[simplex.count - 1].indexA;
+	int hintB = simplex.v[simplex.count - 1].indexB;
+
+	float distance	= 0.0f;
+	bool overlap	= false;
+	for (int iteration = 0; iteration < GJKMaxIterations; ++iteration) {
+		switch (simplex.count) {
+			case 2: SolveSegment(simplex);				break;
+			case 3: SolveTriangle(simplex);				break;
+			case 4: overlap = SolveTetrahedron(simplex);	break;
+		}
+		if (overlap) {
+			break;
+		}
+		Vector3 v		= simplex.GetClosestPoint();
+		float distSq	= Vector::Dot(v, v);
+		distance		= std::sqrt(distSq);
+		if (distance < GJKTolerance) {
+			overlap = true;
+			break;
+		}
+		if (iteration == GJKMaxIterations - 1) {
+			break;
+		}
+		//The furthest point of the difference back towards the origin
+		hintA = shapeA.GetSupportVertex(v, hintA);
+		hintB = shapeB.GetSupportVertex(-v, hintB);
+		if (simplex.Contains(hintA, hintB)) {
+			break;
+		}
+		//If it doesn't get us any closer than we already are, we're done
+		Vector3 w = shapeB.GetVertex(hintB) - shapeA.GetVertex(hintA);
+		if (distSq - Vector::Dot(v, w) <= GJKTolerance * distance) {
+			break;
+		}
+		simplex.Add(shapeA, shapeB, hintA, hintB);
+	}
+
+	cache.count = simplex.count;
+	for (int i = 0; i < simplex.count; ++i) {
+		cache.indexA[i] = simplex.v[i].indexA;
+		cache.indexB[i] = simplex.v[i].indexB;
+	}
+	if (overlap) {
+		return 0.0f;
+	}
+	simplex.GetClosestPoints(pointA, pointB);
+	return distance;
+}
+
+static constexpr int	EPAMaxIterations	= 64;
+static constexpr int	EPAMaxVertices		= EPAMaxIterations + 4;
+static constexpr int	EPAMaxFaces			= 2 * EPAMaxVertices;
+static constexpr float	EPATolerance		= 1e-4f;
+
+struct EPAFace {
+	int		v[3];
+	Vector3 normal;
+	float	distance;
+};
+
+static SimplexVertex MakeSupportVertex(const SupportShape& shapeA, const SupportShape& shapeB, const Vector3& direction) {
+	Simplex s;
+	s.Add(shapeA, shapeB, shapeA.GetSupportVertex(-direction, 0), shapeB.GetSupportVertex(direction, 0));
+	return s.v[0];
+}
+
+/*
+GJK can stop with fewer than 4 vertices if the origin is right on the
+edge of the difference. EPA needs a tetrahedron to start with, so extra
+vertices are found by looking in directions away from what's already
+there. Returns false if the difference is flat, which can only happen
+for shapes that don't have any volume.
+*/
+static bool BuildTetrahedron(const SupportShape& shapeA, const SupportShape& shapeB, SimplexVertex* vertices, int count) {
+	float tolerance = EPATolerance * (1.0f + Vector::Length(vertices[0].w));
+	while (count < 4) {
+		bool added = false;
+		if (count == 1) {
+			for (int i = 0; i < 6 && !added; ++i) {
+				Vector3 dir;
+				dir[i / 2] = (i & 1) ? -1.0f : 1.0f;
+				vertices[count] = MakeSupportVertex(shapeA, shapeB, dir);
+				added = Vector::Length(vertices[count].w - vertices[0].w) > tolerance;
+			}
+		}
+		else if (count == 2) {
+			Vector3 line = Vector::Normalise(vertices[1].w - vertices[0].w);
+			Vector3 axis = std::abs(line.x) < 0.5f ? Vector3(1, 0, 0) : Vector3(0, 1, 0);
+			Vector3 sideA = Vector::Normalise(Vector::Cross(line, axis));
+			Vector3 sideB = Vector::Cross(line, sideA);
+			Vector3 dirs[4] = { sideA, -sideA, sideB, -sideB };
+			for (int i = 0; i < 4 && !added; ++i) {
+				vertices[count] = MakeSupportVertex(shapeA, shapeB, dirs[i]);
+				added = Vector::Length(Vector::Cross(vertices[count].w - vertices[0].w, line)) > tolerance;
+			}
+		}
+		else {
+			Vector3 normal = Vector::Normalise(Vector::Cross(vertices[1].w - vertices[0].w, vertices[2].w - vertices[0].w));
+			for (int i = 0; i < 2 && !added; ++i) {
+				vertices[count] = MakeSupportVertex(shapeA, shapeB, i ? -normal : normal);
+				added = std::abs(Vector::Dot(vertices[count].w - vertices[0].w, normal)) > tolerance;
+			}
+		}
+		if (!added) {
+			return false;
+		}
+		++count;
+	}
+	//The first face needs to point away from the last vertex, so that every face points outwards
+	if (Vector::Dot(Vector::Cross(vertices[1].w - vertices[0].w, vertices[2].w - vertices[0].w), vertices[3].w - vertices[0].w) > 0.0f) {
+		std::swap(vertices[1], vertices[2]);
+	}
+	return true;
+}
+
+static bool MakeEPAFace(const SimplexVertex* vertices, int a, int b, int c, EPAFace& face) {
+	face.v[0] = a;
+	face.v[1] = b;
+	face.v[2] = c;
+	Vector3 normal	= Vector::Cross(vertices[b].w - vertices[a].w, vertices[c].w - vertices[a].w);
+	float length	= Vector::Length(normal);
+	if (length <= 0.0f) {
+		return false;
+	}
+	face.normal		= normal / length;
+	face.distance	= Vector::Dot(face.normal, vertices[a].w);
+	return true;
+}
+
+/*
+When the shapes overlap, the difference contains the origin, and the
+shortest way to push them apart is given by whichever face of the
+difference is closest to the origin. EPA (the Expanding Polytope
+Algorithm) starts with GJK's tetrahedron, and keeps expanding the closest
+face outwards, by adding the furthest point of the difference in that
+face's direction - removing all of the faces that point can see, and
+joining it up to the edges left around the hole - until the closest face
+can't be pushed out any further, as it's part of the real surface.
+*/
+static bool EPAPenetration(const SupportShape& shapeA, const SupportShape& shapeB, const Simplex& simplex,
+	Vector3& normal, float& depth, Vector3& pointA, Vector3& pointB) {
+	SimplexVertex	vertices[EPAMaxVertices];
+	EPAFace			faces[EPAMaxFaces];
+	int				edges[EPAMaxFaces * 3][2];
+
+	for (int i = 0; i < simplex.count; ++i) {
+		vertices[i] = simplex.v[i];
+	}
+	if (!BuildTetrahedron(shapeA, shapeB, vertices, simplex.count)) {
+		return false;
+	}
+	int vertexCount = 4;
+	int faceCount	= 0;
+	static const int startFaces[4][3] = { {0, 1, 2}, {0, 3, 1}, {1, 3, 2}, {2, 3, 0} };
+	for (const int* f : startFaces) {
+		if (!MakeEPAFace(vertices, f[0], f[1], f[2], faces[faceCount])) {
+			return false;
+		}
+		++faceCount;
+	}
+
+	int closest = 0;
+	for (int iteration = 0; iteration < EPAMaxIterations; ++iteration) {
+		closest = 0;
+		for (int i = 1; i < faceCount; ++i) {
+			if (faces[i].distance < faces[closest].distance) {
+				closest = i;
+			}
+		}
+		const EPAFace& face = faces[closest];
+		SimplexVertex next	= MakeSupportVertex(shapeA, shapeB, face.normal);
+		if (Vector::Dot(next.w, face.normal) - face.distance < EPATolerance) {
+			break;
+		}
+		if (vertexCount == EPAMaxVertices) {
+			break;
+		}
+		int nextIndex = vertexCount;
+		vertices[vertexCount++] = next;
+
+		//Each edge of a removed face is kept, unless the face on the other side is removed too
+		int edgeCount = 0;
+		for (int i = 0; i < faceCount; ) {
+			if (Vector::Dot(faces[i].normal, next.w - vertices[faces[i].v[0]].w) <= 0.0f) {
+				++i;
+				continue;
+			}
+			for (int e = 0; e < 3; ++e) {
+				int a = faces[i].v[e];
+				int b = faces[i].v[(e + 1) % 3];
+				bool shared = false;
+				for (int j = 0; j < edgeCount; ++j) {
+					if (edges[j][0] == b && edges[j][1] == a) {
+						edges[j][0] = edges[edgeCount - 1][0];
+						edges[j][1] = edges[edgeCount - 1][1];
+						--edgeCount;
+						shared = true;
+						break;
+					}
+				}
+				if (!shared) {
+					edges[edgeCount][0] = a;
+					edges[edgeCount][1] = b;
+					++edgeCount;
+				}
+			}
+			faces[i] = faces[--faceCount];
+		}
+		if (faceCount + edgeCount > EPAMaxFaces) {
+			return false;
+		}
+		for (int i = 0; i < edgeCount; ++i) {
+			if (MakeEPAFace(vertices, edges[i][0], edges[i][1], nextIndex, faces[faceCount])) {
+				++faceCount;
+			}
+		}
+		if (faceCount == 0) {
+			return false;
+		}
+	}
+	closest = 0;
+	for (int i = 1; i < faceCount; ++i) {
+		if (faces[i].distance < faces[closest].distance) {
+			closest = i;
+		}
+	}
+	const EPAFace& face = faces[closest];
+	depth = std::max(face.distance, 0.0f);
+
+	//Where the origin projects onto the face says how much of each vertex's shape points to use
+	const SimplexVertex& a = vertices[face.v[0]];
+	const SimplexVertex& b = vertices[face.v[1]];
+	const SimplexVertex& c = vertices[face.v[2]];
+	Vector3 p	= face.normal * face.distance;
+	Vector3 v0	= b.w - a.w;
+	Vector3 v1	= c.w - a.w;
+	Vector3 v2	= p - a.w;
+	float d00	= Vector::Dot(v0, v0);
+	float d01	= Vector::Dot(v0, v1);
+	float d11	= Vector::Dot(v1, v1);
+	float d20	= Vector::Dot(v2, v0);
+	float d21	= Vector::Dot(v2, v1);
+	float denom = d00 * d11 - d01 * d01;
+	float u		= denom != 0.0f ? (d11 * d20 - d01 * d21) / denom : 0.0f;
+	float v		= denom != 0.0f ? (d00 * d21 - d01 * d20) / denom : 0.0f;
+	float w		= 1.0f - u - v;
+
+	pointA = a.pointA * w + b.pointA * u + c.pointA * v;
+	pointB = a.pointB * w + b.pointB * u + c.pointB * v;
+	//Pushing B back along the face normal separates the shapes, so the normal from A to B points the other way
+	normal = -face.normal;
+	return true;
+}
+
+/*
+The GJK and EPA steps shared by both of the tests below. The points come
+back on the surfaces of the shapes (radii included), with the normal
+pointing from A towards B.
+*/
+static bool ShapeIntersection(const SupportShape& shapeA, const SupportShape& shapeB, CollisionDetection::SimplexCache& cache,
+	Vector3& pointA, Vector3& pointB, Vector3& normal, float& penetration) {
+	Simplex simplex;
+	float distance	= GJKDistance(shapeA, shapeB, cache, simplex, pointA, pointB);
+	float radii		= shapeA.radius + shapeB.radius;
+
+	if (distance > 0.0f) {
+		//The cores are apart, so the shapes only touch if the radii make up the gap
+		if (distance >= radii) {
+			return false;
+		}
+		normal		= (pointB - pointA) / distance;
+		penetration = radii - distance;
+	}
+	else {
+		float depth;
+		if (!EPAPenetration(shapeA, shapeB, simplex, normal, depth, pointA, pointB)) {
+			return false;
+		}
+		penetration = depth + radii;
+	}
+	pointA += normal * shapeA.radius;
+	pointB -= normal * shapeB.radius;
+	return true;
+}
+
+bool CollisionDetection::ConvexIntersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	SupportShape shapeA(volumeA, worldTransformA);
+	SupportShape shapeB(volumeB, worldTransformB);
+	if (shapeA.vertexCount == 0 || shapeB.vertexCount == 0) {
+		return false;
+	}
+	Vector3 pointA;
+	Vector3 pointB;
+	Vector3 normal;
+	float	penetration;
+	if (!ShapeIntersection(shapeA, shapeB, collisionInfo.simplex, pointA, pointB, normal, penetration)) {
+		return false;
+	}
+	collisionInfo.AddContactPoint(pointA - worldTransformA.GetPosition(), pointB - worldTransformB.GetPosition(), normal, penetration);
+	return true;
+}
+
+/*
+Only the triangles near the volume are looked at - the volume's reach
+along each of the mesh's axes gives a box in the mesh's own space, which
+the mesh's hierarchy is queried with. Spheres and capsules are just a line
+segment with a radius, so their closest points to a triangle can be found
+directly, rather than needing GJK.
+*/
+bool CollisionDetection::TriangleMeshIntersection(const TriangleMeshVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	SupportShape shape(volumeB, worldTransformB);
+	if (shape.vertexCount == 0) {
+		return false;
+	}
+	const TriangleMesh* mesh	= volumeA.GetMesh();
+	Vector3 meshPosition		= worldTransformA.GetPosition();
+	Quaternion meshOrientation	= worldTransformA.GetOrientation();
+
+	Vector3 boxMin;
+	Vector3 boxMax;
+	for (int i = 0; i < 3; ++i) {
+		Vector3 axis;
+		axis[i] = 1.0f;
+		Vector3 dir		= meshOrientation * axis;
+		float centre	= Vector::Dot(dir, meshPosition);
+		boxMax[i]		= Vector::Dot(dir, shape.GetVertex(shape.GetSupportVertex(dir, 0)))  - centre + shape.radius;
+		boxMin[i]		= Vector::Dot(dir, shape.GetVertex(shape.GetSupportVertex(-dir, 0))) - centre - shape.radius;
+	}
+
+	bool rounded = volumeB.type == VolumeType::Sphere || volumeB.type == VolumeType::Capsule;
+	Vector3 segmentStart	= shape.GetVertex(0);
+	Vector3 segmentEnd		= shape.GetVertex(shape.vertexCount - 1);
+
+	float	bestPenetration = -FLT_MAX;
+	Vector3 bestA;
+	Vector3 bestB;
+	Vector3 bestNormal;
+
+	mesh->Query(boxMin, boxMax,
+		[&](int triangle) {
+			const TriangleMesh::Triangle& local = mesh->GetTriangle(triangle);
+			TriangleMesh::Triangle t;
+			t.a			= meshPosition + meshOrientation * local.a;
+			t.b			= meshPosition + meshOrientation * local.b;
+			t.c			= meshPosition + meshOrientation * local.c;
+			t.normal	= meshOrientation * local.normal;
+
+			if (Vector::Dot(t.normal, shape.position - t.a) < 0.0f) {
+				return; //behind the triangle
+			}
+			Vector3 pointA;
+			Vector3 pointB;
+			Vector3 normal;
+			float	penetration;
+			if (rounded) {
+				Vector3 onSegment;
+				float distance = ClosestSegmentTrianglePoints(segmentStart, segmentEnd, t, onSegment, pointA);
+				if (distance >= shape.radius) {
+					return;
+				}
+				if (distance > 1e-6f) {
+					normal		= (onSegment - pointA) / distance;
+					penetration = shape.radius - distance;
+				}
+				else {
+					//The core itself is touching the face, so push out from whichever end is deepest
+					float startSide = Vector::Dot(t.normal, segmentStart - t.a);
+					float endSide	= Vector::Dot(t.normal, segmentEnd - t.a);
+					float depth		= std::max(0.0f, -std::min(startSide, endSide));
+					onSegment		= startSide < endSide ? segmentStart : segmentEnd;
+					pointA			= onSegment + t.normal * depth;
+					normal			= t.normal;
+					penetration		= shape.radius + depth;
+				}
+				pointB = onSegment - normal * shape.radius;
+			}
+			else {
+				SimplexCache cache;
+				if (!ShapeIntersection(SupportShape(t), shape, cache, pointA, pointB, normal, penetration)) {
+					return;
+				}
+			}
+			if (penetration > bestPenetration) {
+				bestPenetration = penetration;
+				bestA			= pointA;
+				bestB			= pointB;
+				bestNormal		= normal;
+			}
+		}
+	);
+	if (bestPenetration == -FLT_MAX) {
+		return false;
+	}
+	if (volumeB.type == VolumeType::AABB) {
+		//As in the other AABB tests, the contact goes through the box's centre, as an AABB can't be made to turn
+		bestB = worldTransformB.GetPosition();
+		bestA = bestB + bestNormal * bestPenetration;
+	}
+	collisionInfo.AddContactPoint(bestA - meshPosition, bestB - worldTransformB.GetPosition(), bestNormal, bestPenetration);
+	return true;
+}
+
 Matrix4 GenerateInverseView(const Camera &c) {
 	float pitch = c.GetPitch();
 	float yaw	= c.GetYaw();
@@ -9,6 +9,8 @@
 #include "OBBVolume.h"
 #include "SphereVolume.h"
 #include "CapsuleVolume.h"
+#include "ConvexHullVolume.h"
+#include "TriangleMeshVolume.h"
 #include "Ray.h"
 
 using NCL::Camera;
@@ -24,17 +26,39 @@ namespace NCL {
 			Vector3 normal;
 			float	penetration;
 		};
+		/*
+		The simplex GJK finished with for a pair, as the numbers of the
+		vertices on each shape that made it up. Objects resting on each other
+		barely move between frames, so starting from last frame's simplex
+		usually gets GJK to the answer in an iteration or two.
+		*/
+		struct SimplexCache {
+			int count = 0;
+			int indexA[4];
+			int indexB[4];
+		};
 		struct CollisionInfo {
 			GameObject* a;
 			GameObject* b;		
 			int		framesLeft;
 
 			ContactPoint point;
+			SimplexCache simplex;
 
 			CollisionInfo() {
 
 			}
 
+			//Picks up the simplex another CollisionInfo for the same pair finished with, even if its objects are the other way round
+			void WarmStartFrom(const CollisionInfo& previous) {
+				simplex = previous.simplex;
+				if (previous.a != a) {
+					for (int i = 0; i < simplex.count; ++i) {
+						std::swap(simplex.indexA[i], simplex.indexB[i]);
+					}
+				}
+			}
+
 			void AddContactPoint(const Vector3& localA, const Vector3& localB, const Vector3& normal, float p) {
 				point.localA		= localA;
 				point.localB		= localB;
@@ -69,6 +93,14 @@ namespace NCL {
 			const CapsuleVolume& volumeA, const Transform& worldTransformA,
 			const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
 
+		static bool OBBCapsuleIntersection(
+			const CapsuleVolume& volumeA, const Transform& worldTransformA,
+			const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		static bool CapsuleIntersection(
+			const CapsuleVolume& volumeA, const Transform& worldTransformA,
+			const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
 		//TODO ADD THIS PROPERLY
 		static bool RayBoxIntersection(const Ray&r, const Vector3& boxPos, const Vector3& boxSize, RayCollision& collision);
 
@@ -81,6 +113,8 @@ namespace NCL {
 		static bool RayOBBIntersection(const Ray&r, const Transform& worldTransform, const OBBVolume&	volume, RayCollision& collision);
 		static bool RaySphereIntersection(const Ray&r, const Transform& worldTransform, const SphereVolume& volume, RayCollision& collision);
 		static bool RayCapsuleIntersection(const Ray& r, const Transform& worldTransform, const CapsuleVolume& volume, RayCollision& collision);
+		static bool RayConvexHullIntersection(const Ray& r, const Transform& worldTransform, const ConvexHullVolume& volume, RayCollision& collision);
+		static bool RayTriangleMeshIntersection(const Ray& r, const Transform& worldTransform, const TriangleMeshVolume& volume, RayCollision& collision);
 
 
 		static bool RayPlaneIntersection(const Ray&r, const Plane&p, RayCollision& collisions);
@@ -90,6 +124,36 @@ namespace NCL {
 
 		static bool ObjectIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
 
+		/*
+		Every narrowphase test has this shape once its volumes are cast back
+		to the base class, so they can all be kept in one table, looked up by
+		the types of the two volumes. Pairs that come in the 'wrong' way round
+		for a test get a version that swaps them (and the objects in the
+		collisionInfo) before calling it, so the caller never has to.
+		*/
+		typedef bool (*IntersectionFunction)(const CollisionVolume& volumeA, const Transform& worldTransformA,
+			const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		static constexpr int VolumeTypeCount	= 9;	//one per bit of VolumeType, up to Invalid
+		static constexpr int PairTypeCount		= VolumeTypeCount * VolumeTypeCount;
+
+		//Which entry of the table a pair of volume types uses - pairs can be grouped by this, to run each test over a batch at once
+		static int PairTypeIndex(VolumeType typeA, VolumeType typeB);
+
+		//The test for a pair type. Pairs with no test get one that just returns false, so this is never null
+		static IntersectionFunction GetIntersectionFunction(int pairType);
+
+		/*
+		For continuous collision detection - if a sphere or capsule moves by
+		motion from where its transform currently puts it, does it hit the
+		given AABB, OBB or triangle mesh along the way? If so, hitFraction is
+		how far along the motion (from 0 to 1) it first touches. Volumes that
+		already overlap the box don't count, as the narrowphase can deal with
+		those.
+		*/
+		static bool SweptIntersection(const CollisionVolume& volume, const Transform& worldTransform, const Vector3& motion,
+			const CollisionVolume& boxVolume, const Transform& boxTransform, float& hitFraction);
+
 
 		static bool AABBIntersection(	const AABBVolume& volumeA, const Transform& worldTransformA,
 										const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
@@ -107,6 +171,28 @@ namespace NCL {
 		static bool OBBSphereIntersection(const OBBVolume& volumeA, const Transform& worldTransformA,
 			const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
 
+		static bool OBBAABBIntersection(const OBBVolume& volumeA, const Transform& worldTransformA,
+			const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		/*
+		Works for any pair of convex volumes, using GJK, and EPA if they
+		overlap. The specialised tests above are quicker, so this is only
+		used for pairs involving a convex hull. The collisionInfo's simplex
+		is used as a starting point, and updated with the one GJK ends on.
+		*/
+		static bool ConvexIntersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+			const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		/*
+		Any convex volume against the triangles of a static mesh. Spheres and
+		capsules use their own closest point tests against each triangle, and
+		everything else goes through GJK. Triangles are one sided - a volume
+		whose centre is behind a triangle is never pushed out through it - and
+		only the deepest of the touching triangles makes the contact point.
+		*/
+		static bool TriangleMeshIntersection(const TriangleMeshVolume& volumeA, const Transform& worldTransformA,
+			const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
 
 		static Vector3 Unproject(const Vector3& screenPos, const PerspectiveCamera& cam);
 
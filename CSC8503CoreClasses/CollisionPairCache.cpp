@@ -0,0 +1,106 @@
+#include "CollisionPairCache.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+CollisionPairCache::CollisionPairCache(int initialCapacity)
+{
+	size_t size = 16;
+	while (size < (size_t)initialCapacity) {
+		size <<= 1;
+	}
+	entries.resize(size);
+	pairCount = 0;
+}
+
+void CollisionPairCache::Clear()
+{
+	for (Entry& e : entries) {
+		e.key = EmptyKey;
+	}
+	pairCount = 0;
+}
+
+ContactManifold& CollisionPairCache::Insert(const CollisionDetection::CollisionInfo& info, int frame)
+{
+	//Keep the table at most half full, so probe runs stay short
+	if ((size_t)(pairCount + 1) * 2 > entries.size()) {
+		Grow();
+	}
+	uint64_t key = MakeKey(info.a, info.b);
+	size_t slot	 = HomeSlot(key);
+
+	while (entries[slot].key != EmptyKey && entries[slot].key != key) {
+		slot = (slot + 1) & (entries.size() - 1);
+	}
+	Entry& e = entries[slot];
+	if (e.key == EmptyKey) {
+		e.key	= key;
+		e.begun = false;
+		e.manifold.Reset(info.a, info.b);
+		pairCount++;
+	}
+	e.info		= info;
+	e.lastFrame = frame;
+	return e.manifold;
+}
+
+CollisionDetection::CollisionInfo* CollisionPairCache::Find(const GameObject* a, const GameObject* b)
+{
+	uint64_t key = MakeKey(a, b);
+	size_t slot	 = HomeSlot(key);
+
+	while (entries[slot].key != EmptyKey) {
+		if (entries[slot].key == key) {
+			return &entries[slot].info;
+		}
+		slot = (slot + 1) & (entries.size() - 1);
+	}
+	return nullptr;
+}
+
+/*
+With linear probing, we can't just empty the slot, as that would break
+the probe run of anything stored after it. Instead, later entries in the
+run are shifted back into the gap, if that doesn't move them before the
+slot they hashed to.
+*/
+void CollisionPairCache::RemoveAt(size_t slot)
+{
+	const size_t mask = entries.size() - 1;
+	size_t hole = slot;
+	size_t next = (slot + 1) & mask;
+
+	while (entries[next].key != EmptyKey) {
+		size_t home = HomeSlot(entries[next].key);
+		//Can the entry at 'next' be moved back to 'hole'? Only if its home
+		//slot doesn't lie in the (cyclic) range (hole, next]
+		bool homeInRange = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+		if (!homeInRange) {
+			entries[hole] = entries[next];
+			hole = next;
+		}
+		next = (next + 1) & mask;
+	}
+	entries[hole].key = EmptyKey;
+	pairCount--;
+}
+
+void CollisionPairCache::Grow()
+{
+	std::vector<Entry> oldEntries;
+	oldEntries.swap(entries);
+	entries.resize(oldEntries.size() * 2);
+
+	const size_t mask = entries.size() - 1;
+	for (const Entry& e : oldEntries) {
+		if (e.key == EmptyKey) {
+			continue;
+		}
+		size_t slot = HomeSlot(e.key);
+		while (entries[slot].key != EmptyKey) {
+			slot = (slot + 1) & mask;
+		}
+		entries[slot] = e;
+	}
+}
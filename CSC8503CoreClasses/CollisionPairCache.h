@@ -0,0 +1,128 @@
+#pragma once
+#include "ContactManifold.h"
+#include "GameObject.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Keeps track of which pairs of objects are touching across multiple
+		frames, so that objects can be told when a collision starts and ends.
+
+		Pairs are keyed on the world IDs of the two objects, and stored in a
+		flat open addressed hash table, so adding or refreshing a contact is
+		a couple of array lookups rather than a walk through a tree. Instead
+		of counting down every entry each frame, each pair just remembers the
+		last frame it was seen on, and is removed once that's too long ago.
+
+		Each pair also owns the ContactManifold the solver uses for it, so the
+		contact points and their impulses live on for as long as the pair does.
+		*/
+		class CollisionPairCache {
+		public:
+			CollisionPairCache(int initialCapacity = 256);
+			~CollisionPairCache() = default;
+
+			void Clear();
+
+			//Adds the pair if it's new, or refreshes its contact and frame stamp if not.
+			//The returned manifold is only valid until the next Insert.
+			ContactManifold& Insert(const CollisionDetection::CollisionInfo& info, int frame);
+
+			CollisionDetection::CollisionInfo* Find(const GameObject* a, const GameObject* b);
+
+			int GetPairCount() const
+			{
+				return pairCount;
+			}
+
+			/*
+			Calls onBegin(info) for any pair that has been added since the last
+			call, and onEnd(info) for any pair that has not been refreshed for
+			more than maxAge frames, removing it from the cache.
+			*/
+			template<class B, class E>
+			void UpdateEvents(int frame, int maxAge, B&& onBegin, E&& onEnd);
+
+			template<class F>
+			void OperateOnContents(F&& func)
+			{
+				for (Entry& e : entries) {
+					if (e.key != EmptyKey) {
+						func(e.info);
+					}
+				}
+			}
+
+			template<class F>
+			void OperateOnManifolds(F&& func)
+			{
+				for (Entry& e : entries) {
+					if (e.key != EmptyKey) {
+						func(e.manifold);
+					}
+				}
+			}
+
+		protected:
+			static constexpr uint64_t EmptyKey = ~0ull;
+
+			struct Entry {
+				uint64_t	key			= EmptyKey;
+				int			lastFrame	= 0;
+				bool		begun		= false;
+				CollisionDetection::CollisionInfo info;
+				ContactManifold manifold;
+			};
+
+			static uint64_t MakeKey(const GameObject* a, const GameObject* b)
+			{
+				uint32_t idA = (uint32_t)a->GetWorldID();
+				uint32_t idB = (uint32_t)b->GetWorldID();
+				return idA < idB ? ((uint64_t)idA << 32) | idB : ((uint64_t)idB << 32) | idA;
+			}
+
+			size_t HomeSlot(uint64_t key) const
+			{
+				key ^= key >> 33;
+				key *= 0xff51afd7ed558ccdull;
+				key ^= key >> 33;
+				return (size_t)key & (entries.size() - 1);
+			}
+
+			void RemoveAt(size_t slot);
+			void Grow();
+
+			std::vector<Entry>	entries;	//always a power of two in size
+			int					pairCount;
+		};
+
+		template<class B, class E>
+		void CollisionPairCache::UpdateEvents(int frame, int maxAge, B&& onBegin, E&& onEnd)
+		{
+			/*
+			Removing an entry can shift a later entry back into this slot, so
+			the slot is looked at again rather than moving on. An entry from
+			the start of the table can get shifted to the end and be seen
+			twice, but as nothing here counts down, that does no harm.
+			*/
+			size_t i = 0;
+			while (i < entries.size()) {
+				Entry& e = entries[i];
+				if (e.key == EmptyKey) {
+					++i;
+					continue;
+				}
+				if (!e.begun) {
+					e.begun = true;
+					onBegin(e.info);
+				}
+				if (frame - e.lastFrame > maxAge) {
+					onEnd(e.info);
+					RemoveAt(i);
+					continue;
+				}
+				++i;
+			}
+		}
+	}
+}
@@ -2,6 +2,8 @@
 
 namespace NCL {
 	namespace CSC8503 {
+		class GameObject;
+
 		class Constraint	
 		{
 		public:
@@ -9,6 +11,10 @@ namespace NCL {
 			virtual ~Constraint() = default;
 
 			virtual void UpdateConstraint(float dt) = 0;
+
+			//The objects this constraint ties together, so they can share an island
+			virtual GameObject* GetObjectA() const { return nullptr; }
+			virtual GameObject* GetObjectB() const { return nullptr; }
 		};
 	}
 }
\ No newline at end of file
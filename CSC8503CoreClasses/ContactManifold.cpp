@@ -0,0 +1,128 @@
+#include "ContactManifold.h"
+#include "GameObject.h"
+#include "PhysicsObject.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+//How far apart the two halves of a contact can drift before it's thrown away
+const float breakingDistance	= 0.1f;
+//How close a new contact has to be to an old one to be treated as the same point
+const float matchDistance		= 0.1f;
+
+void ContactManifold::Reset(GameObject* objectA, GameObject* objectB)
+{
+	a			= objectA;
+	b			= objectB;
+	pointCount	= 0;
+	lastStep	= -1;
+
+	const PhysicsObject* physA = a->GetPhysicsObject();
+	const PhysicsObject* physB = b->GetPhysicsObject();
+
+	friction	= std::sqrt(physA->GetFriction() * physB->GetFriction());
+	restitution = physA->GetElasticity() * physB->GetElasticity();
+}
+
+void ContactManifold::Refresh(const Transform& transformA, const Transform& transformB)
+{
+	int i = 0;
+	while (i < pointCount) {
+		ManifoldPoint& p = points[i];
+
+		Vector3 worldA = transformA.GetPosition() + transformA.GetOrientation() * p.localA;
+		Vector3 worldB = transformB.GetPosition() + transformB.GetOrientation() * p.localB;
+
+		Vector3 offset		= worldB - worldA;
+		float separation	= Vector::Dot(offset, p.normal);
+		Vector3 drift		= offset - p.normal * separation;
+
+		if (separation > breakingDistance || Vector::LengthSquared(drift) > breakingDistance * breakingDistance) {
+			points[i] = points[--pointCount];
+			continue;
+		}
+		p.penetration = -separation;
+		++i;
+	}
+}
+
+void ContactManifold::AddContact(const CollisionDetection::CollisionInfo& info, int step, const Transform& transformA, const Transform& transformB)
+{
+	Refresh(transformA, transformB);
+
+	//The narrowphase might have been given the objects the other way around
+	bool flipped = info.a != a;
+
+	Vector3 offsetA = flipped ? info.point.localB : info.point.localA;
+	Vector3 offsetB = flipped ? info.point.localA : info.point.localB;
+
+	ManifoldPoint newPoint;
+	newPoint.localA				= transformA.GetOrientation().Conjugate() * offsetA;
+	newPoint.localB				= transformB.GetOrientation().Conjugate() * offsetB;
+	newPoint.normal				= flipped ? -info.point.normal : info.point.normal;
+	newPoint.penetration		= info.point.penetration;
+	newPoint.normalImpulse		= 0.0f;
+	newPoint.tangentImpulse[0]	= 0.0f;
+	newPoint.tangentImpulse[1]	= 0.0f;
+
+	int slot = -1;
+	for (int i = 0; i < pointCount; ++i) {
+		if (Vector::LengthSquared(points[i].localA - newPoint.localA) < matchDistance * matchDistance) {
+			//Same contact as before, so it can carry on from where it left off
+			newPoint.normalImpulse		= points[i].normalImpulse;
+			newPoint.tangentImpulse[0]	= points[i].tangentImpulse[0];
+			newPoint.tangentImpulse[1]	= points[i].tangentImpulse[1];
+			slot = i;
+			break;
+		}
+	}
+	if (slot == -1) {
+		slot = (pointCount < MaxPoints) ? pointCount++ : FindReplacementPoint(newPoint);
+	}
+	points[slot]	= newPoint;
+	lastStep		= step;
+}
+
+/*
+When the manifold is full, the deepest point is always kept, and out of the
+rest we throw away whichever one leaves the remaining points covering the
+biggest area - a wide spread of contacts is what stops objects rocking.
+*/
+int ContactManifold::FindReplacementPoint(const ManifoldPoint& newPoint) const
+{
+	int deepest = -1;
+	float maxPenetration = newPoint.penetration;
+	for (int i = 0; i < MaxPoints; ++i) {
+		if (points[i].penetration > maxPenetration) {
+			maxPenetration	= points[i].penetration;
+			deepest			= i;
+		}
+	}
+
+	int		bestIndex	= 0;
+	float	bestArea	= -1.0f;
+	for (int i = 0; i < MaxPoints; ++i) {
+		if (i == deepest) {
+			continue;
+		}
+		Vector3 q[4];
+		int count = 0;
+		for (int j = 0; j < MaxPoints; ++j) {
+			if (j != i) {
+				q[count++] = points[j].localA;
+			}
+		}
+		q[count] = newPoint.localA;
+
+		float area = std::max({
+			Vector::LengthSquared(Vector::Cross(q[0] - q[1], q[2] - q[3])),
+			Vector::LengthSquared(Vector::Cross(q[0] - q[2], q[1] - q[3])),
+			Vector::LengthSquared(Vector::Cross(q[0] - q[3], q[1] - q[2]))
+		});
+		if (area > bestArea) {
+			bestArea	= area;
+			bestIndex	= i;
+		}
+	}
+	return bestIndex;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "CollisionDetection.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameObject;
+
+		struct ManifoldPoint {
+			Vector3 localA;		//contact position in A's own local space
+			Vector3 localB;		//contact position in B's own local space
+			Vector3 normal;		//from A towards B, in world space
+			float	penetration;
+
+			//Impulses summed over every solver iteration, kept for warm starting
+			float	normalImpulse;
+			float	tangentImpulse[2];
+
+			//Worked out once per substep by the ContactSolver
+			Vector3 relativeA;
+			Vector3 relativeB;
+			Vector3 tangent[2];
+			float	normalMass;
+			float	tangentMass[2];
+			float	velocityBias;
+		};
+
+		/*
+		Our narrowphase only ever finds a single contact point for a pair of
+		objects, which isn't enough to keep a box resting flat on the floor.
+		Instead, each pair keeps a manifold of up to 4 points, built up over a
+		few substeps - new points are added as the narrowphase finds them, and
+		old ones are thrown away once the objects have moved too far for them
+		to still be valid. The impulses that were needed to solve each point
+		are kept too, so the solver can start from last substep's answer.
+		*/
+		class ContactManifold {
+		public:
+			static constexpr int MaxPoints = 4;
+
+			void Reset(GameObject* a, GameObject* b);
+
+			//Re-projects every point using where the objects are now (as the
+			//physics has them, for a and b), and removes any that have drifted apart
+			void Refresh(const Transform& transformA, const Transform& transformB);
+
+			void AddContact(const CollisionDetection::CollisionInfo& info, int step, const Transform& transformA, const Transform& transformB);
+
+			GameObject*		a;
+			GameObject*		b;
+			ManifoldPoint	points[MaxPoints];
+			int				pointCount;
+			int				lastStep;	//physics substep this manifold was last found colliding on
+			float			friction;
+			float			restitution;
+
+		protected:
+			int FindReplacementPoint(const ManifoldPoint& newPoint) const;
+		};
+	}
+}
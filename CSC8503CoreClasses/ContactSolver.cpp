@@ -0,0 +1,136 @@
+#include "ContactSolver.h"
+#include "PhysicsBodyStore.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+//How much impulse it takes to change the relative velocity along dir by 1
+static float EffectiveMass(const PhysicsBodyStore& bodies, int bodyA, int bodyB,
+	const Vector3& relativeA, const Vector3& relativeB, const Vector3& dir) {
+	Vector3 inertiaA = Vector::Cross(bodies.GetInertiaTensor(bodyA) * Vector::Cross(relativeA, dir), relativeA);
+	Vector3 inertiaB = Vector::Cross(bodies.GetInertiaTensor(bodyB) * Vector::Cross(relativeB, dir), relativeB);
+
+	float k = bodies.GetInverseMass(bodyA) + bodies.GetInverseMass(bodyB) + Vector::Dot(inertiaA + inertiaB, dir);
+	return k > 0.0f ? 1.0f / k : 0.0f;
+}
+
+static Vector3 RelativeVelocity(const PhysicsBodyStore& bodies, int bodyA, int bodyB,
+	const Vector3& relativeA, const Vector3& relativeB) {
+	Vector3 fullVelocityA = bodies.GetLinearVelocity(bodyA) + Vector::Cross(bodies.GetAngularVelocity(bodyA), relativeA);
+	Vector3 fullVelocityB = bodies.GetLinearVelocity(bodyB) + Vector::Cross(bodies.GetAngularVelocity(bodyB), relativeB);
+	return fullVelocityB - fullVelocityA;
+}
+
+static void ApplyImpulse(PhysicsBodyStore& bodies, int bodyA, int bodyB,
+	const Vector3& relativeA, const Vector3& relativeB, const Vector3& impulse) {
+	bodies.ApplyLinearImpulse(bodyA, -impulse);
+	bodies.ApplyLinearImpulse(bodyB, impulse);
+
+	bodies.ApplyAngularImpulse(bodyA, Vector::Cross(relativeA, -impulse));
+	bodies.ApplyAngularImpulse(bodyB, Vector::Cross(relativeB, impulse));
+}
+
+void ContactSolver::Prepare(PhysicsBodyStore& bodies, float dt)
+{
+	for (SolverManifold& entry : manifolds) {
+		ContactManifold* m	= entry.manifold;
+		int bodyA			= entry.bodyA;
+		int bodyB			= entry.bodyB;
+
+		Quaternion orientationA = bodies.GetOrientation(bodyA);
+		Quaternion orientationB = bodies.GetOrientation(bodyB);
+
+		for (int i = 0; i < m->pointCount; ++i) {
+			ManifoldPoint& p = m->points[i];
+
+			p.relativeA = orientationA * p.localA;
+			p.relativeB = orientationB * p.localB;
+
+			//Any pair of directions at right angles to the normal will do for friction
+			const Vector3& n = p.normal;
+			if (std::abs(n.x) >= 0.57735f) {
+				p.tangent[0] = Vector::Normalise(Vector3(n.y, -n.x, 0.0f));
+			}
+			else {
+				p.tangent[0] = Vector::Normalise(Vector3(0.0f, n.z, -n.y));
+			}
+			p.tangent[1] = Vector::Cross(n, p.tangent[0]);
+
+			p.normalMass		= EffectiveMass(bodies, bodyA, bodyB, p.relativeA, p.relativeB, n);
+			p.tangentMass[0]	= EffectiveMass(bodies, bodyA, bodyB, p.relativeA, p.relativeB, p.tangent[0]);
+			p.tangentMass[1]	= EffectiveMass(bodies, bodyA, bodyB, p.relativeA, p.relativeB, p.tangent[1]);
+
+			/*
+			The contact wants the objects to be separating at some speed. If
+			they hit each other hard enough, that's a bounce based on how
+			fast they came together. Otherwise, it's just enough to push out
+			a fraction of the overlap this substep.
+			*/
+			float approachSpeed	= Vector::Dot(RelativeVelocity(bodies, bodyA, bodyB, p.relativeA, p.relativeB), n);
+			float bounceBias	= approachSpeed < -restitutionCutoff ? -m->restitution * approachSpeed : 0.0f;
+			float pushBias		= (baumgarte / dt) * std::max(0.0f, p.penetration - penetrationSlop);
+
+			p.velocityBias = std::max(bounceBias, pushBias);
+		}
+	}
+
+	/*
+	Last substep's impulses are only applied once every contact has worked
+	out how fast it's being hit. Otherwise, the push from one contact in a
+	stack would look like an impact to the next contact along, and make it
+	bounce.
+	*/
+	for (SolverManifold& entry : manifolds) {
+		ContactManifold* m	= entry.manifold;
+		int bodyA			= entry.bodyA;
+		int bodyB			= entry.bodyB;
+
+		for (int i = 0; i < m->pointCount; ++i) {
+			ManifoldPoint& p = m->points[i];
+
+			if (warmStarting) {
+				Vector3 impulse = p.normal * p.normalImpulse + p.tangent[0] * p.tangentImpulse[0] + p.tangent[1] * p.tangentImpulse[1];
+				ApplyImpulse(bodies, bodyA, bodyB, p.relativeA, p.relativeB, impulse);
+			}
+			else {
+				p.normalImpulse		= 0.0f;
+				p.tangentImpulse[0] = 0.0f;
+				p.tangentImpulse[1] = 0.0f;
+			}
+		}
+	}
+}
+
+void ContactSolver::SolveVelocities(PhysicsBodyStore& bodies)
+{
+	for (SolverManifold& entry : manifolds) {
+		ContactManifold* m	= entry.manifold;
+		int bodyA			= entry.bodyA;
+		int bodyB			= entry.bodyB;
+
+		for (int i = 0; i < m->pointCount; ++i) {
+			ManifoldPoint& p = m->points[i];
+
+			//Friction first, limited by how hard the contact pushed last time
+			float maxFriction = m->friction * p.normalImpulse;
+			for (int t = 0; t < 2; ++t) {
+				float speed = Vector::Dot(RelativeVelocity(bodies, bodyA, bodyB, p.relativeA, p.relativeB), p.tangent[t]);
+				float j		= -speed * p.tangentMass[t];
+
+				float oldImpulse	= p.tangentImpulse[t];
+				p.tangentImpulse[t] = std::clamp(oldImpulse + j, -maxFriction, maxFriction);
+
+				ApplyImpulse(bodies, bodyA, bodyB, p.relativeA, p.relativeB, p.tangent[t] * (p.tangentImpulse[t] - oldImpulse));
+			}
+
+			//Then the contact itself, which can only ever push the objects apart
+			float speed = Vector::Dot(RelativeVelocity(bodies, bodyA, bodyB, p.relativeA, p.relativeB), p.normal);
+			float j		= (p.velocityBias - speed) * p.normalMass;
+
+			float oldImpulse	= p.normalImpulse;
+			p.normalImpulse		= std::max(oldImpulse + j, 0.0f);
+
+			ApplyImpulse(bodies, bodyA, bodyB, p.relativeA, p.relativeB, p.normal * (p.normalImpulse - oldImpulse));
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "ContactManifold.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		class PhysicsBodyStore;
+
+		/*
+		A sequential impulse solver for contacts. Rather than trying to work
+		out the right impulse for every contact at once, each contact is
+		solved on its own, one after another, and the whole set is looped
+		over a few times - each pass fixes up the errors the last one caused.
+
+		Each contact keeps a running total of the impulse applied to it. The
+		total is what gets clamped (a contact can push but never pull, and
+		friction can never be stronger than the push), which lets individual
+		iterations overshoot and correct themselves. The totals are also kept
+		in the manifold between substeps, and applied up front as a first
+		guess ('warm starting'), so resting stacks start out nearly solved.
+
+		The solver works directly on the PhysicsBodyStore, so each manifold is
+		added along with where its two objects are in the store.
+		*/
+		class ContactSolver {
+		public:
+			ContactSolver() = default;
+			~ContactSolver() = default;
+
+			void Clear()
+			{
+				manifolds.clear();
+			}
+
+			void AddManifold(ContactManifold* m, int bodyA, int bodyB)
+			{
+				manifolds.push_back({ m, bodyA, bodyB });
+			}
+
+			//Works out the per-contact constants for this substep, and applies warm starting
+			void Prepare(PhysicsBodyStore& bodies, float dt);
+
+			//A single pass of impulses over every contact
+			void SolveVelocities(PhysicsBodyStore& bodies);
+
+			void UseWarmStarting(bool state)
+			{
+				warmStarting = state;
+			}
+
+		protected:
+			struct SolverManifold {
+				ContactManifold*	manifold;
+				int					bodyA;
+				int					bodyB;
+			};
+			std::vector<SolverManifold> manifolds;
+
+			bool	warmStarting		= true;
+			float	baumgarte			= 0.2f;	//fraction of the overlap to push out per substep
+			float	penetrationSlop		= 0.01f;//overlap allowed without any push out, to stop jitter
+			float	restitutionCutoff	= 1.0f;	//don't bounce on impacts slower than this
+		};
+	}
+}
@@ -0,0 +1,339 @@
+#include "ConvexHull.h"
+#include "Mesh.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+ConvexHull::ConvexHull(const std::vector<Vector3>& points) {
+	Build(points);
+}
+
+ConvexHull::ConvexHull(const Rendering::Mesh& mesh) {
+	Build(mesh.GetPositionData());
+}
+
+struct HullFace {
+	int					v[3];
+	Vector3d			normal;
+	double				distance;	//how far along the normal the face is from the origin
+	bool				alive;
+	int					visitStamp;
+	std::vector<int>	outside;	//points that are in front of this face, and not yet part of the hull
+
+	double DistanceTo(const Vector3d& p) const
+	{
+		return Vector::Dot(normal, p) - distance;
+	}
+};
+
+static constexpr double PlaneTolerance = 1e-9;
+
+static uint64_t EdgeKey(int from, int to) {
+	return ((uint64_t)(uint32_t)from << 32) | (uint32_t)to;
+}
+
+/*
+If the points are all in a line or on a plane, there's no volume to wrap,
+so instead a thin box is put around them.
+*/
+static std::vector<Vector3> BoundingBoxCorners(const std::vector<Vector3>& points) {
+	Vector3 boxMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3 boxMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const Vector3& p : points) {
+		boxMin = Vector::Min(boxMin, p);
+		boxMax = Vector::Max(boxMax, p);
+	}
+	if (points.empty()) {
+		boxMin = Vector3();
+		boxMax = Vector3();
+	}
+	float thickness = std::max(Vector::GetMaxElement(boxMax - boxMin) * 0.01f, 0.001f);
+	for (int i = 0; i < 3; ++i) {
+		float grow = std::max(thickness - (boxMax[i] - boxMin[i]), 0.0f) * 0.5f;
+		boxMin[i] -= grow;
+		boxMax[i] += grow;
+	}
+	std::vector<Vector3> corners;
+	for (int i = 0; i < 8; ++i) {
+		corners.emplace_back((i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z);
+	}
+	return corners;
+}
+
+/*
+This is the quickhull algorithm. We start off with a tetrahedron made from
+four points that are far apart, and give every other point to one of the
+faces that it's in front of - points that aren't in front of any face are
+inside the tetrahedron, and can be forgotten about.
+
+Then, for each face that still has points in front of it, the furthest
+of those points must be on the hull. Every face that point can see gets
+removed, which leaves a hole with a ring of edges (the 'horizon') around
+it, and the hole is filled in with new faces from each horizon edge to
+the new point. The points the removed faces had are shared out amongst
+the new faces in the same way as before, and this carries on until no
+face has any points left in front of it.
+
+Faces are joined together by looking up each of their edges, backwards,
+in a map of which face owns which edge, so it's easy to spread outwards
+from a face to find all of the others the point can see.
+*/
+void ConvexHull::Build(const std::vector<Vector3>& positions) {
+	vertices.clear();
+	faces.clear();
+	neighbourStart.clear();
+	neighbours.clear();
+
+	if (positions.size() < 4) {
+		Build(BoundingBoxCorners(positions));
+		return;
+	}
+	/*
+	Dense meshes have lots of points that are very nearly on the same plane,
+	and in floats, rounding errors would decide which side of a face they're
+	on - which quickly tangles the hull up - so it's all done in doubles.
+	*/
+	std::vector<Vector3d> points(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i) {
+		points[i] = Vector3d(positions[i].x, positions[i].y, positions[i].z);
+	}
+
+	Vector3d boxMin(DBL_MAX, DBL_MAX, DBL_MAX);
+	Vector3d boxMax(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+	int extremes[3][2] = { {0, 0}, {0, 0}, {0, 0} };
+	for (int i = 0; i < (int)points.size(); ++i) {
+		for (int axis = 0; axis < 3; ++axis) {
+			if (points[i][axis] < boxMin[axis]) {
+				boxMin[axis] = points[i][axis];
+				extremes[axis][0] = i;
+			}
+			if (points[i][axis] > boxMax[axis]) {
+				boxMax[axis] = points[i][axis];
+				extremes[axis][1] = i;
+			}
+		}
+	}
+	//Points closer than this to a face are treated as being on it
+	Vector3d reach	= Vector::Max(-boxMin, boxMax);
+	double epsilon	= (reach.x + reach.y + reach.z) * PlaneTolerance;
+
+	//The first two points are the ones furthest apart along any axis...
+	int longest = 0;
+	for (int axis = 1; axis < 3; ++axis) {
+		if (boxMax[axis] - boxMin[axis] > boxMax[longest] - boxMin[longest]) {
+			longest = axis;
+		}
+	}
+	int first[4] = { extremes[longest][0], extremes[longest][1], -1, -1 };
+	Vector3d lineDir = points[first[1]] - points[first[0]];
+
+	//...then the point furthest from the line between them...
+	double bestDistance = 0.0;
+	for (int i = 0; i < (int)points.size(); ++i) {
+		double d = Vector::Length(Vector::Cross(points[i] - points[first[0]], lineDir));
+		if (d > bestDistance) {
+			bestDistance	= d;
+			first[2]		= i;
+		}
+	}
+	//...and then the point furthest from the plane all three are on
+	Vector3d baseNormal;
+	if (first[2] >= 0 && bestDistance > epsilon * Vector::Length(lineDir)) {
+		baseNormal		= Vector::Normalise(Vector::Cross(lineDir, points[first[2]] - points[first[0]]));
+		bestDistance	= 0.0;
+		for (int i = 0; i < (int)points.size(); ++i) {
+			double d = std::abs(Vector::Dot(points[i] - points[first[0]], baseNormal));
+			if (d > bestDistance) {
+				bestDistance	= d;
+				first[3]		= i;
+			}
+		}
+	}
+	if (first[3] < 0 || bestDistance <= epsilon) {
+		Build(BoundingBoxCorners(positions));
+		return;
+	}
+	//The base triangle has to face away from the fourth point, so that all of the faces point outwards
+	if (Vector::Dot(points[first[3]] - points[first[0]], baseNormal) > 0.0) {
+		std::swap(first[1], first[2]);
+	}
+
+	std::vector<HullFace> hullFaces;
+	std::unordered_map<uint64_t, int> edgeFaces;
+
+	auto AddFace = [&](int a, int b, int c) {
+		HullFace f;
+		f.v[0]			= a;
+		f.v[1]			= b;
+		f.v[2]			= c;
+		f.normal		= Vector::Normalise(Vector::Cross(points[b] - points[a], points[c] - points[a]));
+		f.distance		= Vector::Dot(f.normal, points[a]);
+		f.alive			= true;
+		f.visitStamp	= -1;
+		int index = (int)hullFaces.size();
+		edgeFaces[EdgeKey(a, b)] = index;
+		edgeFaces[EdgeKey(b, c)] = index;
+		edgeFaces[EdgeKey(c, a)] = index;
+		hullFaces.emplace_back(std::move(f));
+	};
+	//Gives a point to the first of the faces it's in front of, if any
+	auto AssignPoint = [&](int point, int firstFace) {
+		for (int f = firstFace; f < (int)hullFaces.size(); ++f) {
+			if (hullFaces[f].alive && hullFaces[f].DistanceTo(points[point]) > epsilon) {
+				hullFaces[f].outside.push_back(point);
+				return;
+			}
+		}
+	};
+
+	AddFace(first[0], first[1], first[2]);
+	AddFace(first[0], first[3], first[1]);
+	AddFace(first[1], first[3], first[2]);
+	AddFace(first[2], first[3], first[0]);
+
+	for (int i = 0; i < (int)points.size(); ++i) {
+		if (i != first[0] && i != first[1] && i != first[2] && i != first[3]) {
+			AssignPoint(i, 0);
+		}
+	}
+
+	std::vector<int> visible;
+	std::vector<int> orphans;
+	std::vector<std::pair<int, int>> horizon;
+
+	//New faces go on the end, so one pass through the list gets to all of them
+	for (int f = 0; f < (int)hullFaces.size(); ++f) {
+		if (!hullFaces[f].alive || hullFaces[f].outside.empty()) {
+			continue;
+		}
+		int eye = hullFaces[f].outside[0];
+		double eyeDistance = hullFaces[f].DistanceTo(points[eye]);
+		for (int p : hullFaces[f].outside) {
+			double d = hullFaces[f].DistanceTo(points[p]);
+			if (d > eyeDistance) {
+				eye			= p;
+				eyeDistance = d;
+			}
+		}
+		const Vector3d& eyePoint = points[eye];
+
+		visible.clear();
+		horizon.clear();
+		visible.push_back(f);
+		hullFaces[f].visitStamp = f;
+		for (int i = 0; i < (int)visible.size(); ++i) {
+			HullFace& face = hullFaces[visible[i]];
+			for (int e = 0; e < 3; ++e) {
+				int a = face.v[e];
+				int b = face.v[(e + 1) % 3];
+				int other = edgeFaces[EdgeKey(b, a)];
+				if (hullFaces[other].visitStamp == f) {
+					continue;
+				}
+				if (hullFaces[other].DistanceTo(eyePoint) > epsilon) {
+					hullFaces[other].visitStamp = f;
+					visible.push_back(other);
+				}
+				else {
+					horizon.emplace_back(a, b);
+				}
+			}
+		}
+
+		orphans.clear();
+		for (int v : visible) {
+			HullFace& face = hullFaces[v];
+			for (int p : face.outside) {
+				if (p != eye) {
+					orphans.push_back(p);
+				}
+			}
+			face.outside.clear();
+			face.outside.shrink_to_fit();
+			face.alive = false;
+			for (int e = 0; e < 3; ++e) {
+				edgeFaces.erase(EdgeKey(face.v[e], face.v[(e + 1) % 3]));
+			}
+		}
+
+		int firstNewFace = (int)hullFaces.size();
+		for (const std::pair<int, int>& edge : horizon) {
+			AddFace(edge.first, edge.second, eye);
+		}
+		for (int p : orphans) {
+			AssignPoint(p, firstNewFace);
+		}
+	}
+
+	//Only the points that ended up being used by a face are kept
+	std::vector<int> remap(positions.size(), -1);
+	std::vector<int> triangles;
+	for (const HullFace& face : hullFaces) {
+		if (!face.alive) {
+			continue;
+		}
+		for (int i = 0; i < 3; ++i) {
+			if (remap[face.v[i]] < 0) {
+				remap[face.v[i]] = (int)vertices.size();
+				vertices.push_back(positions[face.v[i]]);
+			}
+			triangles.push_back(remap[face.v[i]]);
+		}
+		faces.emplace_back(Vector3((float)face.normal.x, (float)face.normal.y, (float)face.normal.z), (float)-face.distance);
+	}
+	BuildNeighbours(triangles);
+
+	halfDimensions = Vector3();
+	for (const Vector3& v : vertices) {
+		halfDimensions = Vector::Max(halfDimensions, Vector::Max(v, -v));
+	}
+}
+
+/*
+Each edge of the hull is shared by two triangles, which go around it in
+opposite directions - so adding just the a -> b direction of each
+triangle edge gives every vertex each of its neighbours exactly once.
+*/
+void ConvexHull::BuildNeighbours(const std::vector<int>& triangles) {
+	neighbourStart.assign(vertices.size() + 1, 0);
+	for (int i = 0; i < (int)triangles.size(); ++i) {
+		neighbourStart[triangles[i] + 1]++;
+	}
+	for (int i = 0; i < (int)vertices.size(); ++i) {
+		neighbourStart[i + 1] += neighbourStart[i];
+	}
+	neighbours.resize(triangles.size());
+	std::vector<int> fill(neighbourStart.begin(), neighbourStart.end() - 1);
+	for (int t = 0; t < (int)triangles.size(); t += 3) {
+		for (int e = 0; e < 3; ++e) {
+			int a = triangles[t + e];
+			int b = triangles[t + (e + 1) % 3];
+			neighbours[fill[a]++] = b;
+		}
+	}
+}
+
+/*
+A hull is convex, so if none of a vertex's neighbours are any further
+along the direction, neither is anything else. Starting from the vertex
+that was furthest last time, this usually only takes a step or two.
+*/
+int ConvexHull::GetSupportVertex(const Vector3& direction, int hint) const {
+	int best = (hint >= 0 && hint < (int)vertices.size()) ? hint : 0;
+	float bestDot = Vector::Dot(vertices[best], direction);
+
+	while (true) {
+		int next = best;
+		for (int i = neighbourStart[best]; i < neighbourStart[best + 1]; ++i) {
+			float d = Vector::Dot(vertices[neighbours[i]], direction);
+			if (d > bestDot) {
+				bestDot = d;
+				next	= neighbours[i];
+			}
+		}
+		if (next == best) {
+			return best;
+		}
+		best = next;
+	}
+}
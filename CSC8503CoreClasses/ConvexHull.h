@@ -0,0 +1,67 @@
+#pragma once
+#include "Plane.h"
+
+namespace NCL {
+	namespace Rendering {
+		class Mesh;
+	}
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		The smallest convex shape that wraps around a set of points - imagine
+		shrink wrapping a mesh. It's built once from a mesh's vertex positions
+		when the mesh is loaded, and can then be shared between every object
+		using that mesh, with each ConvexHullVolume giving its own scale.
+
+		Only the points that end up on the outside of the hull are kept, along
+		with which of them are joined by an edge, so that the furthest point in
+		a given direction (which is all that GJK ever asks a shape for) can be
+		found by walking across the hull from a good starting guess, rather
+		than checking every single vertex. The triangles the hull is built
+		from are kept as planes, for raycasting against.
+		*/
+		class ConvexHull {
+		public:
+			ConvexHull(const std::vector<Vector3>& points);
+			ConvexHull(const Rendering::Mesh& mesh);
+			~ConvexHull() = default;
+
+			int GetVertexCount() const
+			{
+				return (int)vertices.size();
+			}
+
+			const Vector3& GetVertex(int i) const
+			{
+				return vertices[i];
+			}
+
+			const std::vector<Plane>& GetFaces() const
+			{
+				return faces;
+			}
+
+			//How far the hull reaches from its origin along each axis
+			Vector3 GetHalfDimensions() const
+			{
+				return halfDimensions;
+			}
+
+			//The index of the vertex furthest along the given direction, searching from the hint vertex
+			int GetSupportVertex(const Vector3& direction, int hint = 0) const;
+
+		protected:
+			void Build(const std::vector<Vector3>& points);
+			void BuildNeighbours(const std::vector<int>& triangles);
+
+			std::vector<Vector3>	vertices;
+			std::vector<Plane>		faces;
+
+			//The vertices joined to vertex i are neighbours[neighbourStart[i]] up to neighbours[neighbourStart[i + 1]]
+			std::vector<int>		neighbourStart;
+			std::vector<int>		neighbours;
+
+			Vector3					halfDimensions;
+		};
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "CollisionVolume.h"
+#include "ConvexHull.h"
+
+namespace NCL {
+	/*
+	A tight fitting collision shape for an object, made from the convex hull
+	of its mesh. The hull itself isn't owned by the volume - it's built once
+	per mesh and shared, so it must outlive every volume using it. The scale
+	stretches the hull along its local axes, which is usually the same as
+	the scale the object's mesh is drawn with.
+	*/
+	class ConvexHullVolume : public CollisionVolume
+	{
+	public:
+		ConvexHullVolume(const CSC8503::ConvexHull* hull, const Maths::Vector3& scale = Maths::Vector3(1, 1, 1))
+		{
+			type		= VolumeType::ConvexHull;
+			this->hull	= hull;
+			this->scale = scale;
+		}
+		~ConvexHullVolume() = default;
+
+		const CSC8503::ConvexHull* GetHull() const
+		{
+			return hull;
+		}
+
+		Maths::Vector3 GetScale() const
+		{
+			return scale;
+		}
+
+		//How far the scaled hull reaches from the object's position along each of its local axes
+		Maths::Vector3 GetHalfDimensions() const
+		{
+			Maths::Vector3 size = hull->GetHalfDimensions() * scale;
+			return Maths::Vector::Max(size, -size);
+		}
+
+	protected:
+		const CSC8503::ConvexHull*	hull;
+		Maths::Vector3				scale;
+	};
+}
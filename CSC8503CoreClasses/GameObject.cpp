@@ -54,6 +54,24 @@ void GameObject::UpdateBroadphaseAABB()
 			Vector3 halfSizes = ((OBBVolume&)*boundingVolume).GetHalfDimensions();
 			broadphaseAABB = mat * halfSizes;
 		}break;
+		case VolumeType::Capsule: {
+			const CapsuleVolume& capsule = (CapsuleVolume&)*boundingVolume;
+			float r = capsule.GetRadius();
+			//The capsule's inner segment runs along its local Y axis
+			Vector3 axis = transform.GetOrientation() * Vector3(0, capsule.GetHalfHeight() - r, 0);
+			broadphaseAABB = Vector3(std::abs(axis.x) + r, std::abs(axis.y) + r, std::abs(axis.z) + r);
+		}break;
+		case VolumeType::ConvexHull: {
+			//The box around the hull's local reach, turned like an OBB would be
+			Matrix3 mat = Quaternion::RotationMatrix<Matrix3>(transform.GetOrientation());
+			mat = Matrix::Absolute(mat);
+			broadphaseAABB = mat * ((ConvexHullVolume&)*boundingVolume).GetHalfDimensions();
+		}break;
+		case VolumeType::Mesh: {
+			Matrix3 mat = Quaternion::RotationMatrix<Matrix3>(transform.GetOrientation());
+			mat = Matrix::Absolute(mat);
+			broadphaseAABB = mat * ((TriangleMeshVolume&)*boundingVolume).GetHalfDimensions();
+		}break;
 		default: {
 			std::cout << "Object " << this->name << " has unsupported bounding volume type for GameObject::UpdateBroadphaseAABB()\n";
 		}
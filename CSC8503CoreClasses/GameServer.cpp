@@ -1,5 +1,8 @@
 #include "GameServer.h"
 #include "GameWorld.h"
+#include "GameObject.h"
+#include "PhysicsObject.h"
+#include "NetworkObject.h"
 #include "./enet/enet.h"
 using namespace NCL;
 using namespace CSC8503;
@@ -9,6 +12,9 @@ GameServer::GameServer(int onPort, int maxClients)	{
 	clientMax	= maxClients;
 	clientCount = 0;
 	netHandle	= nullptr;
+	gameWorld	= nullptr;
+
+	clients.resize(maxClients);
 }
 
 GameServer::~GameServer()	{
@@ -16,6 +22,9 @@ GameServer::~GameServer()	{
 }
 
 void GameServer::Shutdown() {
+	if (!netHandle) {
+		return;
+	}
 	SendGlobalPacket(BasicNetworkMessages::Shutdown);
 	enet_host_destroy(netHandle);
 	netHandle = nullptr;
@@ -28,6 +37,7 @@ bool GameServer::Initialise() {
 
 	netHandle = enet_host_create(&address, clientMax, 1, 0, 0);
 	RegisterPacketHandler(BasicNetworkMessages::Player_Transform, this);
+	RegisterPacketHandler(BasicNetworkMessages::Received_State, this);
 	std::cout << "[SERVER] enet_host_create done. netHandle=" << netHandle << "\n";
 
 	if (!netHandle) {
@@ -61,6 +71,8 @@ void GameServer::UpdateServer() {
 
 		if (event.type == ENET_EVENT_TYPE_CONNECT) {
 			std::cout << "Server: New client connected (peer=" << peerID << ")\n";
+			connectedPeers.emplace_back(peerID);
+			ResetClient(peerID);
 
 			LevelSeedPacket seedPkt(levelSeed);
 			SendPacketToPeer(peerID, seedPkt);
@@ -69,15 +81,12 @@ void GameServer::UpdateServer() {
 		}
 		else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
 			std::cout << "Server: Client disconnected (peer=" << peerID << ")\n";
+			connectedPeers.erase(std::remove(connectedPeers.begin(), connectedPeers.end(), peerID), connectedPeers.end());
+			ResetClient(peerID);
 		}
 		else if (event.type == ENET_EVENT_TYPE_RECEIVE) {
 			GamePacket* packet = (GamePacket*)event.packet->data;
 			ProcessPacket(packet, peerID);
-
-			if (packet->type == BasicNetworkMessages::Player_Transform) {
-				SendGlobalPacket(*packet);
-			}
-
 			enet_packet_destroy(event.packet);
 		}
 	}
@@ -86,9 +95,41 @@ void GameServer::UpdateServer() {
 
 
 
+/*
+Players are only told about the other players that they'd be sent in
+a snapshot, and where each player says it is becomes the centre of its
+client's area of interest.
+*/
 void GameServer::ReceivePacket(int type, GamePacket* payload, int source) {
+	if (source < 0 || source >= (int)clients.size()) {
+		return;
+	}
 	if (type == BasicNetworkMessages::Player_Transform) {
-		SendGlobalPacket(*payload); 
+		PlayerTransformPacket* p = (PlayerTransformPacket*)payload;
+		SetClientFocus(source, p->position);
+
+		if (p->playerID >= 0 && p->playerID < (int)playerObjects.size() && playerObjects[p->playerID]) {
+			GameObject* o = playerObjects[p->playerID];
+			o->GetTransform()
+				.SetPosition(p->position)
+				.SetOrientation(Quaternion::AxisAngleToQuaterion(Vector3(0, 1, 0), p->yaw));
+			if (PhysicsObject* physics = o->GetPhysicsObject()) {
+				physics->SetLinearVelocity(Vector3());	//the client has already moved it, the server shouldn't carry it on further
+				physics->SetAngularVelocity(Vector3());
+				physics->Wake();
+			}
+		}
+
+		for (int peer : connectedPeers) {
+			if (peer != source && IsRelevant(peer, p->position)) {
+				SendPacketToPeer(peer, *payload);
+			}
+		}
+	}
+	if (type == BasicNetworkMessages::Received_State) {
+		//Packets can arrive out of order, so an older acknowledgement mustn't replace a newer one
+		ClientPacket* p = (ClientPacket*)payload;
+		clients[source].ackedState = std::max(clients[source].ackedState, p->lastID);
 	}
 }
 
@@ -97,6 +138,16 @@ void GameServer::SetGameWorld(GameWorld &g) {
 	gameWorld = &g;
 }
 
+void GameServer::SetPlayerObject(int playerID, GameObject* object) {
+	if (playerID < 0) {
+		return;
+	}
+	if (playerID >= (int)playerObjects.size()) {
+		playerObjects.resize(playerID + 1, nullptr);
+	}
+	playerObjects[playerID] = object;
+}
+
 bool GameServer::SendPacketToPeer(int peerID, GamePacket& packet) {
 	if (!NetworkBase::netHandle) return false;
 
@@ -105,3 +156,156 @@ bool GameServer::SendPacketToPeer(int peerID, GamePacket& packet) {
 	enet_peer_send(peer, 0, dataPacket);
 	return true;
 }
+
+void GameServer::ResetClient(int peerID) {
+	ClientState& c	= clients[peerID];
+	c.ackedState	= -1;
+	c.hasFocus		= false;
+	c.overflowed	= false;
+	c.objects.clear();
+}
+
+void GameServer::SetClientFocus(int peerID, const Vector3& position) {
+	clients[peerID].hasFocus	= true;
+	clients[peerID].focus		= position;
+}
+
+bool GameServer::IsRelevant(int peerID, const Vector3& position) const {
+	const ClientState& c = clients[peerID];
+	if (!c.hasFocus) {
+		return true;
+	}
+	return Vector::LengthSquared(position - c.focus) <= interestRadius * interestRadius;
+}
+
+/*
+Every object works out whether it has changed just once, and is put in
+the grid, and then each client is written a single snapshot packet,
+holding just the objects near its focus that have built up enough
+priority. Changes to objects that miss out are remembered, so they're
+still sent later on.
+
+Deltas are taken from the client's acknowledged full state, but as not
+every object goes in every full frame, the client won't always have
+that state for every object - each object remembers which full states
+it was sent to the client in, and is sent whole if it wasn't.
+
+The snapshot is sent unreliably, like the old state packets were - a lost
+snapshot is soon replaced by a newer one anyway. ENet copies the data out
+of the buffer, so it's free to be written over by the next tick.
+*/
+void GameServer::BroadcastSnapshot(bool deltaFrame) {
+	if (!netHandle || !gameWorld) {
+		return;
+	}
+	std::vector<GameObject*>::const_iterator first;
+	std::vector<GameObject*>::const_iterator last;
+	gameWorld->GetObjectIterators(first, last);
+
+	snapshotTick++;
+	if (!deltaFrame) {
+		fullStateID++;
+	}
+	int maxNetworkID = -1;
+	snapshotObjects.clear();
+	interestGrid.Clear();
+	for (auto i = first; i != last; ++i) {
+		if (NetworkObject* o = (*i)->GetNetworkObject()) {
+			o->PrepareSnapshot(!deltaFrame, fullStateID);
+			interestGrid.Insert((int)snapshotObjects.size(), (*i)->GetTransform().GetPosition());
+			snapshotObjects.emplace_back(*i);
+			maxNetworkID = std::max(maxNetworkID, o->GetNetworkID());
+		}
+	}
+	interestGrid.Build();
+
+	uint32_t fullStateBit = !deltaFrame ? 1u << (fullStateID % 32) : 0;
+
+	for (int peer : connectedPeers) {
+		ClientState& c = clients[peer];
+		if ((int)c.objects.size() <= maxNetworkID) {
+			c.objects.resize(maxNetworkID + 1);
+		}
+		uint32_t ackBit = c.ackedState >= 0 ? 1u << (c.ackedState % 32) : 0;
+		if (!deltaFrame) {
+			for (ObjectInterest& oi : c.objects) {
+				oi.fullStates &= ~fullStateBit;
+			}
+		}
+
+		//Work out what this client is interested in, and how much
+		snapshotCandidates.clear();
+		auto consider = [&](int index) {
+			NetworkObject*	o	= snapshotObjects[index]->GetNetworkObject();
+			ObjectInterest& oi	= c.objects[o->GetNetworkID()];
+
+			float priority = 1.0f;
+			if (c.hasFocus) {
+				float distance = Vector::Length(snapshotObjects[index]->GetTransform().GetPosition() - c.focus);
+				if (distance > interestRadius) {
+					return;
+				}
+				if (distance > fullRateRadius) {
+					float t		= (distance - fullRateRadius) / std::max(interestRadius - fullRateRadius, 0.001f);
+					priority	= 1.0f + (minPriority - 1.0f) * t;
+				}
+			}
+			//Objects coming back into range might have changed while they were away
+			if (oi.lastRelevant != snapshotTick - 1) {
+				oi.pending	= true;
+				oi.priority = 1.0f;
+			}
+			if (o->IsDirty()) {
+				oi.pending = true;
+			}
+			oi.lastRelevant = snapshotTick;
+
+			if (!oi.pending && deltaFrame) {
+				return;
+			}
+			oi.priority += priority;
+			if (oi.priority >= 1.0f || !deltaFrame) {
+				snapshotCandidates.emplace_back(index);
+			}
+		};
+		if (c.hasFocus) {
+			interestGrid.Query(c.focus, interestRadius, consider);
+		}
+		else {
+			for (int i = 0; i < (int)snapshotObjects.size(); ++i) {
+				consider(i);
+			}
+		}
+
+		//Over budget, the objects that have built up the most priority go first
+		auto HigherPriority = [&](int a, int b) {
+			float pa = c.objects[snapshotObjects[a]->GetNetworkObject()->GetNetworkID()].priority;
+			float pb = c.objects[snapshotObjects[b]->GetNetworkObject()->GetNetworkID()].priority;
+			return pa > pb || (pa == pb && a < b);
+		};
+		if (snapshotBudget > 0 && (int)snapshotCandidates.size() > snapshotBudget) {
+			std::nth_element(snapshotCandidates.begin(), snapshotCandidates.begin() + snapshotBudget, snapshotCandidates.end(), HigherPriority);
+			snapshotCandidates.resize(snapshotBudget);
+		}
+		//Likewise if they might not all fit in the packet, so the same ones don't miss out every time
+		if (c.overflowed) {
+			std::sort(snapshotCandidates.begin(), snapshotCandidates.end(), HigherPriority);
+		}
+		c.overflowed = false;
+
+		c.snapshot.Begin(snapshotTick, deltaFrame ? -1 : fullStateID, c.ackedState);
+		for (int index : snapshotCandidates) {
+			NetworkObject*	o	= snapshotObjects[index]->GetNetworkObject();
+			ObjectInterest& oi	= c.objects[o->GetNetworkID()];
+
+			if (!c.snapshot.AddObject(*o, (oi.fullStates & ackBit) != 0)) {
+				c.overflowed = true; //the packet's full - the rest keep their priority, and go first next time
+				break;
+			}
+			oi.fullStates	|= fullStateBit;
+			oi.priority		= 0.0f;
+			oi.pending		= false;
+		}
+		SendPacketToPeer(peer, c.snapshot.Finish());
+	}
+}
@@ -1,9 +1,12 @@
 #pragma once
 #include "NetworkBase.h"
+#include "Snapshot.h"
+#include "InterestGrid.h"
 
 namespace NCL {
 	namespace CSC8503 {
 		class GameWorld;
+		class GameObject;
 		class GameServer : public NetworkBase, public PacketReceiver {
 		public:
 			GameServer(int onPort, int maxClients);
@@ -22,6 +25,35 @@ namespace NCL {
 
 			bool SendPacketToPeer(int peerID, GamePacket& packet);
 
+			/*
+			Sends every client a snapshot of the networked objects in the game
+			world that are relevant to it - those within interestRadius of its
+			focus, which is wherever its player last said it was. Each object
+			builds up priority for each client every snapshot, faster the closer
+			it is, and is only sent once it has enough, so far away objects are
+			updated less often. A budget caps how many objects each snapshot
+			can hold, with the highest priority objects going first.
+			*/
+			void BroadcastSnapshot(bool deltaFrame);
+
+			void SetInterestRadius(float radius) { interestRadius = radius; }
+			void SetFullRateRadius(float radius) { fullRateRadius = radius; }
+			void SetSnapshotBudget(int maxObjects) { snapshotBudget = maxObjects; }
+
+			//Clients with no focus yet are sent everything
+			void SetClientFocus(int peerID, const Vector3& position);
+
+			/*
+			The object that Player_Transform packets with this player ID move
+			about. Each client owns its own player, so the server just puts it
+			wherever the client last said it was, ready for the next physics
+			update and snapshot. Players that aren't set are left alone.
+			*/
+			void SetPlayerObject(int playerID, GameObject* object);
+
+			const std::vector<int>& GetConnectedPeers() const { return connectedPeers; }
+			int GetAckedState(int peerID) const { return clients[peerID].ackedState; }
+
 			void SetLevelSeed(unsigned int s) { levelSeed = s; }
 			unsigned int GetLevelSeed() const { return levelSeed; }
 
@@ -34,6 +66,39 @@ namespace NCL {
 			int incomingDataRate;
 			int outgoingDataRate;
 
+			void ResetClient(int peerID);
+			bool IsRelevant(int peerID, const Vector3& position) const;
+
+			struct ObjectInterest {
+				float		priority		= 0.0f;
+				bool		pending			= true;	//changed since it was last sent
+				int			lastRelevant	= -1;	//the last snapshot it was in range for
+				uint32_t	fullStates		= 0;	//which of the last 32 full states it was sent in, by state ID
+			};
+
+			struct ClientState {
+				SnapshotWriter				snapshot;	//kept and reused from tick to tick
+				int							ackedState	= -1;
+				bool						hasFocus	= false;
+				bool						overflowed	= false;	//the last snapshot ran out of room
+				Vector3						focus;
+				std::vector<ObjectInterest>	objects;	//indexed by network ID
+			};
+
+			std::vector<ClientState>	clients;	//indexed by peer ID
+			std::vector<int>			connectedPeers;
+			std::vector<GameObject*>	playerObjects;	//indexed by player ID
+
+			InterestGrid				interestGrid;
+			std::vector<GameObject*>	snapshotObjects;
+			std::vector<int>			snapshotCandidates;
+			float	interestRadius	= 150.0f;
+			float	fullRateRadius	= 40.0f;	//objects this close are sent every snapshot
+			float	minPriority		= 0.2f;		//how often objects right at the edge are sent
+			int		snapshotBudget	= 0;		//0 for no limit
+			int		snapshotTick	= 0;
+			int		fullStateID		= -1;
+
 		private:
 			unsigned int levelSeed = 0;
 		};
@@ -10,6 +10,7 @@
 #include "Ray.h"
 #include "CollisionDetection.h"
 #include "QuadTree.h"
+#include "AABBTree.h"
 
 using namespace NCL;
 using namespace NCL::CSC8503;
@@ -19,6 +20,10 @@ GameWorld::GameWorld()	{
 	shuffleObjects		= false;
 	worldIDCounter		= 0;
 	worldStateCounter	= 0;
+	raycastTree			= nullptr;
+	raycastTreeStateID	= 0;
+
+	shuffleRandom.seed((uint32_t)std::chrono::system_clock::now().time_since_epoch().count());
 }
 
 GameWorld::~GameWorld()	{
@@ -29,6 +34,7 @@ void GameWorld::Clear() {
 	constraints.clear();
 	worldIDCounter		= 0;
 	worldStateCounter	= 0;
+	raycastTree			= nullptr;
 }
 
 void GameWorld::ClearAndErase() {
@@ -69,22 +75,48 @@ void GameWorld::OperateOnContents(GameObjectFunc f) {
 	}
 }
 
-void GameWorld::UpdateWorld(float dt) {
-	auto rng = std::default_random_engine{};
-
-	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-	std::default_random_engine e(seed);
+/*
+std::shuffle (and the std distributions) can turn the same random numbers
+into a different order with a different standard library, so the shuffle
+is done here instead - a Fisher-Yates shuffle straight from the output of
+an mt19937, which is defined to be the same everywhere.
+*/
+template <typename T>
+static void Shuffle(std::vector<T>& items, std::mt19937& random) {
+	for (int i = (int)items.size() - 1; i > 0; --i) {
+		int j = (int)(random() % (uint32_t)(i + 1));
+		std::swap(items[i], items[j]);
+	}
+}
 
+void GameWorld::UpdateWorld(float dt) {
 	if (shuffleObjects) {
-		std::shuffle(gameObjects.begin(), gameObjects.end(), e);
+		Shuffle(gameObjects, shuffleRandom);
 	}
 
 	if (shuffleConstraints) {
-		std::shuffle(constraints.begin(), constraints.end(), e);
+		Shuffle(constraints, shuffleRandom);
+	}
+}
+
+/*
+Transforms only rebuild their matrices when asked for them, but doing it
+here in one go, after everything has finished moving objects around,
+means the renderer never has to.
+*/
+void GameWorld::FlushTransforms() {
+	for (GameObject* o : gameObjects) {
+		const Transform& t = o->GetTransform();
+		if (t.IsMatrixDirty()) {
+			t.UpdateMatrix();
+		}
 	}
 }
 
 bool GameWorld::Raycast(Ray& r, RayCollision& closestCollision, bool closestObject, GameObject* ignoreThis) const {
+	if (raycastTree && raycastTreeStateID == worldStateCounter) {
+		return RaycastTree(r, closestCollision, closestObject, ignoreThis);
+	}
 	//The simplest raycast just goes through each object and sees if there's a collision
 	RayCollision collision;
 
@@ -99,7 +131,7 @@ bool GameWorld::Raycast(Ray& r, RayCollision& closestCollision, bool closestObje
 		if (CollisionDetection::RayIntersection(r, *i, thisCollision)) {
 				
 			if (!closestObject) {	
-				closestCollision		= collision;
+				closestCollision		= thisCollision;
 				closestCollision.node = i;
 				return true;
 			}
@@ -119,6 +151,117 @@ bool GameWorld::Raycast(Ray& r, RayCollision& closestCollision, bool closestObje
 	return false;
 }
 
+/*
+Rather than testing every object, the ray walks down the tree, only
+looking at objects whose boxes it passes through, nearest ones first.
+Every hit shortens the ray, so boxes further away than the closest hit
+so far never get looked at - and if any hit will do, the first one ends
+the search straight away.
+*/
+bool GameWorld::RaycastTree(Ray& r, RayCollision& closestCollision, bool closestObject, GameObject* ignoreThis) const {
+	RayCollision collision;
+
+	raycastTree->Raycast(r.GetPosition(), r.GetDirection(), FLT_MAX,
+		[&](int proxy, GameObject* object) {
+			RayCollision thisCollision;
+			if (object == ignoreThis || !CollisionDetection::RayIntersection(r, *object, thisCollision)) {
+				return collision.rayDistance;
+			}
+			if (thisCollision.rayDistance < collision.rayDistance) {
+				thisCollision.node	= object;
+				collision			= thisCollision;
+			}
+			return closestObject ? collision.rayDistance : -1.0f;
+		}
+	);
+
+	if (collision.node) {
+		closestCollision = collision;
+		return true;
+	}
+	return false;
+}
+
+int GameWorld::RaycastBatch(std::span<const Ray> rays, std::span<RayCollision> collisions, bool closestObject, GameObject* ignoreThis) const {
+	int count = (int)std::min(rays.size(), collisions.size());
+	for (int i = 0; i < count; i += RayPacket::Size) {
+		RaycastPacket(&rays[i], &collisions[i], std::min(RayPacket::Size, count - i), closestObject, ignoreThis);
+	}
+	int hits = 0;
+	for (int i = 0; i < count; ++i) {
+		if (collisions[i].node) {
+			hits++;
+		}
+	}
+	return hits;
+}
+
+/*
+Boxes and spheres are tested against every ray in the packet at once.
+Other shapes fall back to testing the lanes that reached them one at a
+time, which still gains from the packet walking the tree (or the object
+list) only once for all of the rays.
+Every hit shortens that lane's ray, or ends it, if any hit will do.
+*/
+void GameWorld::RaycastPacket(const Ray* rays, RayCollision* collisions, int count, bool closestObject, GameObject* ignoreThis) const {
+	RayPacket packet(rays, count);
+	for (int i = 0; i < count; ++i) {
+		collisions[i] = RayCollision();
+	}
+
+	auto TestObject = [&](GameObject* object, int mask) {
+		const CollisionVolume* volume = object->GetBoundingVolume();
+		if (!volume || object == ignoreThis) {
+			return;
+		}
+		float distance[RayPacket::Size];
+		int hitMask = 0;
+		Vector3 position = object->GetTransform().GetPosition();
+
+		if (volume->type == VolumeType::AABB) {
+			Vector3 halfSize = ((const AABBVolume*)volume)->GetHalfDimensions();
+			hitMask = mask & packet.IntersectBox(position - halfSize, position + halfSize, distance);
+		}
+		else if (volume->type == VolumeType::Sphere) {
+			hitMask = mask & packet.IntersectSphere(position, ((const SphereVolume*)volume)->GetRadius(), distance);
+		}
+		else {
+			for (int i = 0; i < count; ++i) {
+				RayCollision thisCollision;
+				if ((mask & (1 << i)) && CollisionDetection::RayIntersection(rays[i], *object, thisCollision) &&
+					thisCollision.rayDistance < packet.GetMaxDistance(i)) {
+					distance[i] = thisCollision.rayDistance;
+					hitMask |= 1 << i;
+				}
+			}
+		}
+		for (int i = 0; i < count; ++i) {
+			if (!(hitMask & (1 << i))) {
+				continue;
+			}
+			collisions[i].node			= object;
+			collisions[i].rayDistance	= distance[i];
+			collisions[i].collidedAt	= rays[i].GetPosition() + (rays[i].GetDirection() * distance[i]);
+			packet.SetMaxDistance(i, closestObject ? distance[i] : -1.0f);
+		}
+	};
+
+	if (raycastTree && raycastTreeStateID == worldStateCounter) {
+		raycastTree->RaycastPacket(packet,
+			[&](int proxy, GameObject* object, int mask) {
+				TestObject(object, mask);
+			}
+		);
+		return;
+	}
+	for (auto& i : gameObjects) {
+		int mask = packet.GetActiveMask();
+		if (!mask) {
+			break;
+		}
+		TestObject(i, mask);
+	}
+}
 
 /*
 Constraint Tutorial Stuff
@@ -1,5 +1,7 @@
 #pragma once
 #include "./Camera.h"
+#include <span>
+#include <random>
 
 namespace NCL {
 		namespace Maths {
@@ -12,6 +14,7 @@ namespace NCL {
 	namespace CSC8503 {
 		class GameObject;
 		class Constraint;
+		class AABBTree;
 
 		typedef std::function<void(GameObject*)> GameObjectFunc;
 		typedef std::vector<GameObject*>::const_iterator GameObjectIterator;
@@ -46,10 +49,44 @@ namespace NCL {
 				shuffleObjects = state;
 			}
 
+			/*
+			The shuffles are seeded from the clock unless told otherwise. Giving
+			every machine the same seed gives them all the same orders, as the
+			shuffling doesn't depend on anything the standard library is free to
+			do differently.
+			*/
+			void SetShuffleSeed(uint32_t seed) 
+			{
+				shuffleRandom.seed(seed);
+			}
+
 			bool Raycast(Ray& r, RayCollision& closestCollision, bool closestObject = false, GameObject* ignore = nullptr) const;
 
+			/*
+			Casts a whole batch of rays, filling in the matching collision for
+			each (left as a default RayCollision if that ray hit nothing), and
+			returns how many of them hit something. The rays are worked on in
+			SIMD packets, so this is much cheaper than lots of single Raycasts
+			when there are a few rays to cast together.
+			*/
+			int RaycastBatch(std::span<const Ray> rays, std::span<RayCollision> collisions, bool closestObject = false, GameObject* ignore = nullptr) const;
+
+			/*
+			The physics can hand over its broadphase tree once it has brought it
+			up to date, for raycasts to use. It's only trusted until an object
+			is next added or removed, as it won't know about those yet.
+			*/
+			void SetRaycastTree(const AABBTree* tree) 
+			{
+				raycastTree			= tree;
+				raycastTreeStateID	= worldStateCounter;
+			}
+
 			virtual void UpdateWorld(float dt);
 
+			//Rebuilds the matrix of every object that has moved, ready for drawing
+			void FlushTransforms();
+
 			void OperateOnContents(GameObjectFunc f);
 
 			void GetObjectIterators(
@@ -86,6 +123,9 @@ namespace NCL {
 			}
 
 		protected:
+			bool RaycastTree(Ray& r, RayCollision& closestCollision, bool closestObject, GameObject* ignore) const;
+			void RaycastPacket(const Ray* rays, RayCollision* collisions, int count, bool closestObject, GameObject* ignore) const;
+
 			std::vector<GameObject*> gameObjects;
 			std::vector<Constraint*> constraints;
 
@@ -93,9 +133,13 @@ namespace NCL {
 
 			bool	shuffleConstraints;
 			bool	shuffleObjects;
+			std::mt19937 shuffleRandom;
 			int		worldIDCounter;
 			int		worldStateCounter;
 
+			const AABBTree* raycastTree;
+			int				raycastTreeStateID;
+
 			Vector3 sunPosition;
 			Vector3 sunColour;
 		};
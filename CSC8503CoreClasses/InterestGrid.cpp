@@ -0,0 +1,16 @@
+#include "InterestGrid.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+void InterestGrid::Insert(int index, const Vector3& position) {
+	entries.push_back({ CellKey(CellCoord(position.x), CellCoord(position.z)), index });
+}
+
+void InterestGrid::Build() {
+	std::sort(entries.begin(), entries.end(),
+		[](const Entry& a, const Entry& b) {
+			return a.cell < b.cell || (a.cell == b.cell && a.index < b.index);
+		}
+	);
+}
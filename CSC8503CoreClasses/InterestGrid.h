@@ -0,0 +1,72 @@
+#pragma once
+
+namespace NCL {
+	using namespace Maths;
+	namespace CSC8503 {
+		/*
+		A uniform grid over the ground plane, for finding which objects are
+		near each client. It's rebuilt from scratch every snapshot - every
+		object's cell is worked out, and the objects sorted by cell, so the
+		objects in any cell sit next to each other and can be found with a
+		binary search. Nothing is allocated once the arrays have grown to fit
+		the world, and the world doesn't need a size up front.
+		*/
+		class InterestGrid {
+		public:
+			InterestGrid(float cellSize = 32.0f) : cellSize(cellSize) {}
+			~InterestGrid() = default;
+
+			void Clear()
+			{
+				entries.clear();
+			}
+
+			void Insert(int index, const Vector3& position);
+
+			//Call once everything's been inserted, before any queries
+			void Build();
+
+			//Calls func(int index) for everything in the cells that a circle around position touches
+			template<class F>
+			void Query(const Vector3& position, float radius, F&& func) const;
+
+		protected:
+			int64_t CellKey(int x, int z) const
+			{
+				return ((int64_t)x << 32) ^ (uint32_t)z;
+			}
+
+			int CellCoord(float value) const
+			{
+				return (int)std::floor(value / cellSize);
+			}
+
+			struct Entry {
+				int64_t cell;
+				int		index;
+			};
+			std::vector<Entry>	entries;
+			float				cellSize;
+		};
+
+		template<class F>
+		void InterestGrid::Query(const Vector3& position, float radius, F&& func) const
+		{
+			int minX = CellCoord(position.x - radius);
+			int maxX = CellCoord(position.x + radius);
+			int minZ = CellCoord(position.z - radius);
+			int maxZ = CellCoord(position.z + radius);
+
+			for (int x = minX; x <= maxX; ++x) {
+				for (int z = minZ; z <= maxZ; ++z) {
+					int64_t key = CellKey(x, z);
+					auto first = std::lower_bound(entries.begin(), entries.end(), key,
+						[](const Entry& e, int64_t k) { return e.cell < k; });
+					for (auto i = first; i != entries.end() && i->cell == key; ++i) {
+						func(i->index);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,251 @@
+#include "LevelBuilder.h"
+#include "GameWorld.h"
+#include "GameObject.h"
+#include "PhysicsObject.h"
+#include "NetworkObject.h"
+#include "AABBVolume.h"
+#include "SphereVolume.h"
+#include "TriangleMesh.h"
+#include "TriangleMeshVolume.h"
+
+#include <cstdlib>
+
+using namespace NCL;
+using namespace CSC8503;
+
+LevelBuilder::LevelBuilder(GameWorld& world) : world(world) {
+}
+
+LevelBuilder::~LevelBuilder() {
+	delete levelMesh;
+}
+
+static float RandRange(float min, float max) {
+	return min + (float(rand()) / float(RAND_MAX)) * (max - min);
+}
+
+void LevelBuilder::Build() {
+	blocks.clear();
+	levelPositions.clear();
+	levelIndices.clear();
+	players.clear();
+	pickups.clear();
+	enemies.clear();
+	nextNetworkID = 0;
+
+	AddPlayer(Vector3(0, 5, 0));
+	AddPlayer(Vector3(-160, 5, -160));
+
+	const float floorY = -2.0f;
+	AddBlock(Vector3(0, floorY, 0), Vector3(200, 2, 200));
+
+	const float floorHalf = 200.0f;
+	const float wallHalfT = 2.0f;
+	const float wallHalfH = 10.0f;
+	const float wallY = floorY + wallHalfH;
+	const float outer = floorHalf - wallHalfT;
+
+	auto WallX = [&](float x, float z, float halfLen) {
+		AddBlock(Vector3(x, wallY, z), Vector3(wallHalfT, wallHalfH, halfLen));
+		};
+	auto WallZ = [&](float x, float z, float halfLen) {
+		AddBlock(Vector3(x, wallY, z), Vector3(halfLen, wallHalfH, wallHalfT));
+		};
+
+	WallZ(0.0f, outer, floorHalf);
+	WallZ(0.0f, -outer, floorHalf);
+	WallX(outer, 0.0f, floorHalf);
+	WallX(-outer, 0.0f, floorHalf);
+
+	WallZ(-155, -120, 40);
+	WallX(-115, -140, 20);
+
+	WallZ(40, -140, 100);
+
+	WallZ(-23, -60, 40);
+	WallX(15, -20, 40);
+	WallZ(76, 20, 63);
+	WallX(140, -20, 40);
+
+	WallZ(0, 120, 140);
+	WallZ(-100, 50, 40);
+	WallX(-60, 85, 35);
+	WallX(-140, 0, 50);
+
+	AddLevel();
+
+	AddEndZone(endZonePos, endZoneHalf);
+
+	const float spawnY = 5.0f;
+	const float minX = -180.0f, maxX = 180.0f;
+	const float minZ = -180.0f, maxZ = 180.0f;
+
+	for (int i = 0; i < PickupCount; ++i) {
+		Vector3 pos(RandRange(minX, maxX), spawnY, RandRange(minZ, maxZ));
+		AddPickup(pos);
+	}
+
+	AddEnemy(Vector3(10, 5, 10));
+}
+
+/*
+
+Adds the 12 triangles of a box to a triangle list, wound anticlockwise when
+seen from outside, so each triangle's normal faces out of the box.
+
+*/
+static void AddBoxTriangles(std::vector<Vector3>& positions, std::vector<unsigned int>& indices, const Vector3& centre, const Vector3& halfSize) {
+	for (int axis = 0; axis < 3; ++axis) {
+		for (int side = -1; side <= 1; side += 2) {
+			Vector3 normal;
+			Vector3 u;
+			Vector3 v;
+			normal[axis]		= (float)side;
+			u[(axis + 1) % 3]	= halfSize[(axis + 1) % 3];
+			v[(axis + 2) % 3]	= halfSize[(axis + 2) % 3];
+			if (side < 0) {
+				std::swap(u, v);
+			}
+			Vector3 faceCentre	= centre + normal * halfSize[axis];
+			unsigned int first	= (unsigned int)positions.size();
+
+			positions.push_back(faceCentre - u - v);
+			positions.push_back(faceCentre + u - v);
+			positions.push_back(faceCentre + u + v);
+			positions.push_back(faceCentre - u + v);
+			for (unsigned int i : { 0u, 1u, 2u, 0u, 2u, 3u }) {
+				indices.push_back(first + i);
+			}
+		}
+	}
+}
+
+/*
+
+A piece of the level's floor or walls. Its triangles are collected up, to be
+collided with as part of the whole level once AddLevel is called.
+
+*/
+void LevelBuilder::AddBlock(const Vector3& position, const Vector3& halfSize) {
+	blocks.push_back({ position, halfSize });
+	AddBoxTriangles(levelPositions, levelIndices, position, halfSize);
+}
+
+/*
+
+Turns every block added since the level was last built into one static
+triangle mesh, so the whole level is just a single object to the broadphase.
+
+*/
+GameObject* LevelBuilder::AddLevel() {
+	level = new GameObject("Level");
+
+	delete levelMesh;
+	levelMesh = new TriangleMesh(levelPositions, levelIndices);
+
+	level->SetBoundingVolume(new TriangleMeshVolume(levelMesh));
+	level->SetPhysicsObject(new PhysicsObject(level->GetTransform(), level->GetBoundingVolume()));
+
+	level->GetPhysicsObject()->SetInverseMass(0);
+	level->GetPhysicsObject()->InitCubeInertia();
+
+	world.AddGameObject(level);
+
+	return level;
+}
+
+GameObject* LevelBuilder::AddPlayer(const Vector3& position) {
+	float meshSize		= 4.0f;
+	float inverseMass	= 0.5f;
+
+	GameObject* character = new GameObject();
+	SphereVolume* volume  = new SphereVolume(3.0f);
+
+	character->SetBoundingVolume(volume);
+
+	character->GetTransform()
+		.SetScale(Vector3(meshSize, meshSize, meshSize))
+		.SetPosition(position);
+
+	character->SetPhysicsObject(new PhysicsObject(character->GetTransform(), character->GetBoundingVolume()));
+
+	character->GetPhysicsObject()->SetInverseMass(inverseMass);
+	character->GetPhysicsObject()->InitSphereInertia();
+	character->GetPhysicsObject()->SetContinuousCollision(true); //the player can get going fast enough to skip through walls
+
+	AddNetworkObject(*character);
+	world.AddGameObject(character);
+	players.push_back(character);
+
+	return character;
+}
+
+GameObject* LevelBuilder::AddEnemy(const Vector3& position) {
+	float meshSize		= 10.0f;
+	float inverseMass	= 0.5f;
+
+	GameObject* character = new GameObject();
+
+	AABBVolume* volume = new AABBVolume(Vector3(0.3f, 0.9f, 0.3f) * meshSize);
+	character->SetBoundingVolume(volume);
+
+	character->GetTransform()
+		.SetScale(Vector3(meshSize, meshSize, meshSize))
+		.SetPosition(position);
+
+	character->SetPhysicsObject(new PhysicsObject(character->GetTransform(), character->GetBoundingVolume()));
+
+	character->GetPhysicsObject()->SetInverseMass(inverseMass);
+	character->GetPhysicsObject()->InitSphereInertia();
+
+	AddNetworkObject(*character);
+	world.AddGameObject(character);
+	enemies.push_back(character);
+
+	return character;
+}
+
+GameObject* LevelBuilder::AddPickup(const Vector3& position) {
+	GameObject* item = new GameObject();
+
+	SphereVolume* volume = new SphereVolume(PickupRadius);
+	item->SetBoundingVolume(volume);
+
+	item->GetTransform()
+		.SetPosition(position)
+		.SetScale(Vector3(PickupRadius, PickupRadius, PickupRadius));
+
+	item->SetPhysicsObject(new PhysicsObject(item->GetTransform(), item->GetBoundingVolume()));
+	item->GetPhysicsObject()->SetInverseMass(1.0f);
+	item->GetPhysicsObject()->InitSphereInertia();
+
+	AddNetworkObject(*item);
+	world.AddGameObject(item);
+	pickups.push_back(item);
+
+	return item;
+}
+
+GameObject* LevelBuilder::AddEndZone(const Vector3& position, const Vector3& halfSize) {
+	endZone = new GameObject();
+
+	AABBVolume* volume = new AABBVolume(halfSize);
+	endZone->SetBoundingVolume(volume);
+
+	endZone->GetTransform()
+		.SetPosition(position)
+		.SetScale(halfSize * 2.0f);
+
+	endZone->SetPhysicsObject(new PhysicsObject(endZone->GetTransform(), endZone->GetBoundingVolume()));
+	endZone->GetPhysicsObject()->SetInverseMass(0.0f); // static
+	endZone->GetPhysicsObject()->InitCubeInertia();
+
+	world.AddGameObject(endZone);
+
+	return endZone;
+}
+
+//IDs are handed out in build order, which is the same everywhere the level is built
+void LevelBuilder::AddNetworkObject(GameObject& o) {
+	o.SetNetworkObject(new NetworkObject(o, nextNetworkID++));
+}
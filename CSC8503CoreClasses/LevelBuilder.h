@@ -0,0 +1,104 @@
+#pragma once
+
+namespace NCL {
+	using namespace Maths;
+	namespace CSC8503 {
+		class GameWorld;
+		class GameObject;
+		class TriangleMesh;
+
+		/*
+		Builds the courier level - the floor and walls, the two players, the
+		pickups, the end zone and the enemy - with just the collision volumes,
+		physics and network objects they need. Nothing here touches a renderer,
+		so a dedicated server can build exactly the level the game does, and
+		the game then gives each object something to be drawn with.
+
+		The pickups are scattered using rand(), so seed it before calling
+		Build - a server and its clients seeded alike end up with the same
+		level, and the same network IDs on the same objects.
+		*/
+		class LevelBuilder {
+		public:
+			//A piece of the floor or walls
+			struct Block {
+				Vector3 position;
+				Vector3 halfSize;
+			};
+
+			static constexpr int	PickupCount		= 15;
+			static constexpr float	PickupRadius	= 1.0f;
+
+			LevelBuilder(GameWorld& world);
+			~LevelBuilder();
+
+			//Adds the level to the world, which should already have been cleared out
+			void Build();
+
+			//The floor and walls only collide as the level object's mesh - nothing is added to the world for them
+			const std::vector<Block>& GetBlocks() const
+			{
+				return blocks;
+			}
+
+			GameObject* GetLevel() const
+			{
+				return level;
+			}
+
+			//The host's player comes first, then the joining player
+			const std::vector<GameObject*>& GetPlayers() const
+			{
+				return players;
+			}
+
+			const std::vector<GameObject*>& GetPickups() const
+			{
+				return pickups;
+			}
+
+			const std::vector<GameObject*>& GetEnemies() const
+			{
+				return enemies;
+			}
+
+			GameObject* GetEndZone() const
+			{
+				return endZone;
+			}
+
+			const Vector3& GetEndZoneHalfSize() const
+			{
+				return endZoneHalf;
+			}
+
+		protected:
+			void AddBlock(const Vector3& position, const Vector3& halfSize);
+			GameObject* AddLevel();
+			GameObject* AddPlayer(const Vector3& position);
+			GameObject* AddEnemy(const Vector3& position);
+			GameObject* AddPickup(const Vector3& position);
+			GameObject* AddEndZone(const Vector3& position, const Vector3& halfSize);
+
+			void AddNetworkObject(GameObject& o);
+
+			GameWorld&	world;
+
+			std::vector<Block>			blocks;
+			std::vector<Vector3>		levelPositions;
+			std::vector<unsigned int>	levelIndices;
+			TriangleMesh*				levelMesh = nullptr;
+
+			GameObject*					level	= nullptr;
+			GameObject*					endZone	= nullptr;
+			std::vector<GameObject*>	players;
+			std::vector<GameObject*>	pickups;
+			std::vector<GameObject*>	enemies;
+
+			Vector3	endZonePos	= Vector3(-165.0f, 2.0f, -165.0f);
+			Vector3	endZoneHalf = Vector3(10.0f, 2.0f, 10.0f);
+
+			int		nextNetworkID = 0;
+		};
+	}
+}
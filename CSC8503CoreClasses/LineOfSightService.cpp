@@ -0,0 +1,250 @@
+#include "LineOfSightService.h"
+#include "GameWorld.h"
+#include "GameObject.h"
+#include "CollisionDetection.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+LineOfSightService::LineOfSightService(int threadCount) : tree(0.0f), pool(threadCount) {
+	nextTicket			= 0;
+	runningFirstTicket	= 0;
+	resultsFirstTicket	= 0;
+	busy				= false;
+	inFlight			= false;
+	shuttingDown		= false;
+
+	dispatcher = std::thread(&LineOfSightService::DispatcherMain, this);
+}
+
+LineOfSightService::~LineOfSightService() {
+	{
+		std::unique_lock<std::mutex> l(lock);
+		shuttingDown = true;
+	}
+	wakeDispatcher.notify_all();
+	dispatcher.join();
+}
+
+int LineOfSightService::SubmitRay(const Vector3& origin, const Vector3& direction, float maxDistance, GameObject* ignore) {
+	pending.push_back({ origin, direction, maxDistance, ignore, nullptr, false });
+	return nextTicket++;
+}
+
+int LineOfSightService::SubmitLineOfSight(const Vector3& from, const Vector3& to, GameObject* target, GameObject* ignore) {
+	Vector3 delta	= to - from;
+	float length	= Vector::Length(delta);
+	Vector3 dir		= length > 0.0f ? delta / length : Vector3(0, 0, 1);
+
+	pending.push_back({ from, dir, length, ignore, target, true });
+	return nextTicket++;
+}
+
+void LineOfSightService::Collect() {
+	std::unique_lock<std::mutex> l(lock);
+	queriesDone.wait(l, [&]() { return !busy; });
+	if (!inFlight) {
+		return;
+	}
+	std::swap(results, runningResults);
+	resultsFirstTicket	= runningFirstTicket;
+	inFlight			= false;
+}
+
+/*
+Everything the workers need is copied out here, on the main thread - this
+is the only part of a query's life that the game loop waits on. Building
+the tree and casting the rays is left to the dispatcher thread.
+*/
+void LineOfSightService::Dispatch(const GameWorld& world) {
+	Collect();
+	if (pending.empty()) {
+		return;
+	}
+	snapshot.clear();
+
+	GameObjectIterator first;
+	GameObjectIterator last;
+	world.GetObjectIterators(first, last);
+
+	for (auto i = first; i != last; ++i) {
+		const CollisionVolume* volume = (*i)->GetBoundingVolume();
+		SnapshotObject s;
+		if (!volume || !(*i)->GetBroadphaseAABB(s.broadphaseSize)) {
+			continue;
+		}
+		s.object		= *i;
+		s.transform		= (*i)->GetTransform();
+		s.type			= volume->type;
+		s.radius		= 0.0f;
+		s.halfHeight	= 0.0f;
+		s.hull			= nullptr;
+		s.mesh			= nullptr;
+
+		switch (volume->type) {
+			case VolumeType::AABB:		s.halfSize = ((const AABBVolume*)volume)->GetHalfDimensions(); break;
+			case VolumeType::OBB:		s.halfSize = ((const OBBVolume*)volume)->GetHalfDimensions(); break;
+			case VolumeType::Sphere:	s.radius = ((const SphereVolume*)volume)->GetRadius(); break;
+			case VolumeType::Capsule:
+				s.radius		= ((const CapsuleVolume*)volume)->GetRadius();
+				s.halfHeight	= ((const CapsuleVolume*)volume)->GetHalfHeight();
+				break;
+			case VolumeType::ConvexHull:
+				s.hull			= ((const ConvexHullVolume*)volume)->GetHull();
+				s.halfSize		= ((const ConvexHullVolume*)volume)->GetScale();
+				break;
+			case VolumeType::Mesh:
+				s.mesh			= ((const TriangleMeshVolume*)volume)->GetMesh();
+				break;
+			default: continue;
+		}
+		snapshot.push_back(s);
+	}
+
+	std::swap(running, pending);
+	pending.clear();
+	runningFirstTicket = nextTicket - (int)running.size();
+
+	{
+		std::unique_lock<std::mutex> l(lock);
+		busy		= true;
+		inFlight	= true;
+	}
+	wakeDispatcher.notify_one();
+}
+
+void LineOfSightService::Clear() {
+	Collect();
+	pending.clear();
+	results.clear();
+}
+
+void LineOfSightService::DispatcherMain() {
+	while (true) {
+		{
+			std::unique_lock<std::mutex> l(lock);
+			wakeDispatcher.wait(l, [&]() { return busy || shuttingDown; });
+			if (shuttingDown) {
+				return;
+			}
+		}
+		BuildTree();
+
+		//Queries are cast a packet at a time - an enemy's feelers are submitted together, so tend to share a packet
+		int packetCount = ((int)running.size() + RayPacket::Size - 1) / RayPacket::Size;
+		runningRays.clear();
+		for (const SightQuery& q : running) {
+			runningRays.emplace_back(q.origin, q.direction);
+		}
+		runningResults.resize(running.size());
+		pool.ParallelFor(packetCount, 4,
+			[&](int begin, int end, int jobIndex) {
+				for (int i = begin; i < end; ++i) {
+					int first = i * RayPacket::Size;
+					RunPacket(first, std::min(RayPacket::Size, (int)running.size() - first));
+				}
+			}
+		);
+
+		{
+			std::unique_lock<std::mutex> l(lock);
+			busy = false;
+		}
+		queriesDone.notify_all();
+	}
+}
+
+void LineOfSightService::BuildTree() {
+	tree.Clear();
+	proxySnapshot.clear();
+	for (int i = 0; i < (int)snapshot.size(); ++i) {
+		const SnapshotObject& s = snapshot[i];
+		int proxy = tree.Insert(s.object, s.transform.GetPosition(), s.broadphaseSize);
+		if (proxy >= (int)proxySnapshot.size()) {
+			proxySnapshot.resize(proxy + 1, -1);
+		}
+		proxySnapshot[proxy] = i;
+	}
+}
+
+static bool RaySnapshotObject(const Ray& r, const Transform& transform, VolumeType type,
+	const Vector3& halfSize, float radius, float halfHeight, const ConvexHull* hull, const TriangleMesh* mesh, RayCollision& collision) {
+	switch (type) {
+		case VolumeType::AABB:		return CollisionDetection::RayAABBIntersection(r, transform, AABBVolume(halfSize), collision);
+		case VolumeType::OBB:		return CollisionDetection::RayOBBIntersection(r, transform, OBBVolume(halfSize), collision);
+		case VolumeType::Sphere:	return CollisionDetection::RaySphereIntersection(r, transform, SphereVolume(radius), collision);
+		case VolumeType::Capsule:	return CollisionDetection::RayCapsuleIntersection(r, transform, CapsuleVolume(halfHeight, radius), collision);
+		case VolumeType::ConvexHull:	return CollisionDetection::RayConvexHullIntersection(r, transform, ConvexHullVolume(hull, halfSize), collision);
+		case VolumeType::Mesh:		return CollisionDetection::RayTriangleMeshIntersection(r, transform, TriangleMeshVolume(mesh), collision);
+		default: return false;
+	}
+}
+
+/*
+Casts running[first] to running[first + count - 1] together, as one
+RayPacket. Boxes and spheres are tested against every lane at once, and
+anything else one lane at a time. Each lane has its own max distance and
+object to ignore, and a hit shortens only the lane that made it, so
+every query gets the same answer it would have got on its own.
+*/
+void LineOfSightService::RunPacket(int first, int count) {
+	const Ray* rays = &runningRays[first];
+	RayPacket packet(rays, count);
+	SightResult* results = &runningResults[first];
+	for (int i = 0; i < count; ++i) {
+		results[i] = SightResult();
+		packet.SetMaxDistance(i, running[first + i].maxDistance);
+	}
+
+	tree.RaycastPacket(packet,
+		[&](int proxy, GameObject* object, int mask) {
+			for (int i = 0; i < count; ++i) {
+				if (object == running[first + i].ignore) {
+					mask &= ~(1 << i);
+				}
+			}
+			if (!mask) {
+				return;
+			}
+			const SnapshotObject& s = snapshot[proxySnapshot[proxy]];
+			float distance[RayPacket::Size];
+			int hitMask = 0;
+
+			if (s.type == VolumeType::AABB) {
+				Vector3 position = s.transform.GetPosition();
+				hitMask = mask & packet.IntersectBox(position - s.halfSize, position + s.halfSize, distance);
+			}
+			else if (s.type == VolumeType::Sphere) {
+				hitMask = mask & packet.IntersectSphere(s.transform.GetPosition(), s.radius, distance);
+			}
+			else {
+				for (int i = 0; i < count; ++i) {
+					RayCollision collision;
+					if ((mask & (1 << i)) &&
+						RaySnapshotObject(rays[i], s.transform, s.type, s.halfSize, s.radius, s.halfHeight, s.hull, s.mesh, collision) &&
+						collision.rayDistance < packet.GetMaxDistance(i)) {
+						distance[i] = collision.rayDistance;
+						hitMask |= 1 << i;
+					}
+				}
+			}
+			for (int i = 0; i < count; ++i) {
+				if (!(hitMask & (1 << i))) {
+					continue;
+				}
+				results[i].object	= object;
+				results[i].point	= rays[i].GetPosition() + rays[i].GetDirection() * distance[i];
+				results[i].distance = distance[i];
+				results[i].hit		= true;
+				packet.SetMaxDistance(i, distance[i]);
+			}
+		}
+	);
+
+	for (int i = 0; i < count; ++i) {
+		const SightQuery& query = running[first + i];
+		if (query.lineOfSight) {
+			results[i].visible = query.target ? results[i].object == query.target : !results[i].hit;
+		}
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "Transform.h"
+#include "CollisionVolume.h"
+#include "AABBTree.h"
+#include "ThreadPool.h"
+#include "Ray.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameObject;
+		class GameWorld;
+		class ConvexHull;
+		class TriangleMesh;
+
+		struct SightResult {
+			GameObject* object		= nullptr;	//the first thing hit - only safe to compare against, it may have been removed since
+			Vector3		point;
+			float		distance	= 0.0f;
+			bool		hit			= false;
+			bool		visible		= false;	//for line of sight queries
+		};
+
+		/*
+		Lets AI ask the world lots of questions like 'can I see the player?' or
+		'is there a wall in front of me?', without making the game loop wait for
+		the answers. Queries submitted during one frame are sent off by Dispatch
+		at the end of it, and carried out on worker threads while the rest of
+		the frame (physics, rendering, and so on) carries on. They're ready to
+		read after Collect is called next frame - so AI always sees the world as
+		it was a frame ago, which is rarely noticeable at 60fps.
+
+		The worker threads never touch the GameWorld itself, which will have
+		moved on by the time they run. Instead, Dispatch copies the shape and
+		transform of every collidable object into a snapshot, and the workers
+		build their own little AABBTree over it.
+
+		Each Submit returns a ticket, which GetResult takes next frame. Tickets
+		keep counting up, so one kept too long gives back nullptr rather than
+		somebody else's answer.
+		*/
+		class LineOfSightService {
+		public:
+			LineOfSightService(int threadCount = 2);
+			~LineOfSightService();
+
+			//The closest hit along a ray, no further than maxDistance
+			int SubmitRay(const Vector3& origin, const Vector3& direction, float maxDistance, GameObject* ignore = nullptr);
+
+			/*
+			Casts from one point to another. If a target is given, it's visible
+			if it's the first thing hit, otherwise the end point is visible if
+			nothing gets in the way.
+			*/
+			int SubmitLineOfSight(const Vector3& from, const Vector3& to, GameObject* target = nullptr, GameObject* ignore = nullptr);
+
+			//Waits for the last Dispatch's queries to finish, and makes their results available
+			void Collect();
+
+			//Snapshots the world, and starts working on everything submitted since the last Dispatch
+			void Dispatch(const GameWorld& world);
+
+			//Waits for any queries in flight, then drops them, and any results
+			void Clear();
+
+			const SightResult* GetResult(int ticket) const
+			{
+				int index = ticket - resultsFirstTicket;
+				if (ticket < 0 || index < 0 || index >= (int)results.size()) {
+					return nullptr;
+				}
+				return &results[index];
+			}
+
+		protected:
+			struct SightQuery {
+				Vector3		origin;
+				Vector3		direction;
+				float		maxDistance;
+				GameObject* ignore;
+				GameObject* target;
+				bool		lineOfSight;
+			};
+
+			struct SnapshotObject {
+				GameObject* object;
+				Transform	transform;
+				Vector3		broadphaseSize;
+				VolumeType	type;
+				Vector3		halfSize;	//boxes, or a convex hull's scale
+				float		radius;		//spheres and capsules
+				float		halfHeight;	//capsules
+				const ConvexHull* hull;	//convex hulls, scaled by halfSize
+				const TriangleMesh* mesh;	//level geometry
+			};
+
+			void DispatcherMain();
+			void BuildTree();
+			void RunPacket(int first, int count);
+
+			std::vector<SightQuery>		pending;		//submitted since the last Dispatch
+			int							nextTicket;
+
+			//Only touched by the dispatcher thread while busy
+			std::vector<SightQuery>		running;
+			std::vector<Ray>			runningRays;
+			std::vector<SightResult>	runningResults;
+			std::vector<SnapshotObject> snapshot;
+			std::vector<int>			proxySnapshot;	//tree proxy -> snapshot index
+			AABBTree					tree;
+			int							runningFirstTicket;
+
+			std::vector<SightResult>	results;
+			int							resultsFirstTicket;
+
+			ThreadPool					pool;
+			std::thread					dispatcher;
+			std::mutex					lock;
+			std::condition_variable		wakeDispatcher;
+			std::condition_variable		queriesDone;
+			bool						busy;
+			bool						inFlight;	//results waiting to be collected
+			bool						shuttingDown;
+		};
+	}
+}
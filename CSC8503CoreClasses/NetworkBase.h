@@ -17,6 +17,7 @@ enum BasicNetworkMessages {
 	Player_Connected,
 	Player_Disconnected,
 	Shutdown,
+	Snapshot_State,	//every object's state for one tick, bit packed
 	Player_Transform = 100,
 	Carry_Toggle,
 	Carry_State,
@@ -8,6 +8,12 @@ NetworkObject::NetworkObject(GameObject& o, int id) : object(o)	{
 	deltaErrors = 0;
 	fullErrors  = 0;
 	networkID   = id;
+	dirty		= true;
+
+	lastFullState.stateID = -1;
+	for (NetworkState& state : stateHistory) {
+		state.stateID = -1;
+	}
 }
 
 NetworkObject::~NetworkObject()	{
@@ -32,13 +38,12 @@ bool NetworkObject::WritePacket(GamePacket** p, bool deltaFrame, int stateID) {
 }
 //Client objects recieve these packets
 bool NetworkObject::ReadDeltaPacket(DeltaPacket& p) {
-	if (p.fullID != lastFullState.stateID)
+	NetworkState base;
+	if (!GetNetworkState(p.fullID, base))
 		return false;
 
-	UpdateStateHistory(p.fullID);
-
-	Vector3 pos = lastFullState.position;
-	Quaternion q = lastFullState.orientation;
+	Vector3 pos = base.position;
+	Quaternion q = base.orientation;
 
 	pos.x += p.pos[0];
 	pos.y += p.pos[1];
@@ -62,7 +67,7 @@ bool NetworkObject::ReadFullPacket(FullPacket& p) {
 	object.GetTransform().SetPosition(lastFullState.position);
 	object.GetTransform().SetOrientation(lastFullState.orientation);
 
-	stateHistory.push_back(lastFullState);
+	StoreNetworkState(lastFullState);
 	return true;
 }
 
@@ -112,22 +117,182 @@ NetworkState& NetworkObject::GetLatestNetworkState() {
 }
 
 bool NetworkObject::GetNetworkState(int id, NetworkState& out) {
-	for (auto& s : stateHistory) {
-		if (s.stateID == id) {
-			out = s;
-			return true;
-		}
+	if (id < 0) {
+		return false;
 	}
-	return false;
+	const NetworkState& s = stateHistory[id % StateHistorySize];
+	if (s.stateID != id) {
+		return false; //never had it, or it's been written over since
+	}
+	out = s;
+	return true;
 }
 
+void NetworkObject::StoreNetworkState(const NetworkState& state) {
+	if (state.stateID < 0) {
+		return;
+	}
+	stateHistory[state.stateID % StateHistorySize] = state;
+}
 
 void NetworkObject::UpdateStateHistory(int minID) {
-	for (auto i = stateHistory.begin(); i != stateHistory.end();) {
-		if (i->stateID < minID)
-			i = stateHistory.erase(i);
-		else
-			++i;
+	for (NetworkState& s : stateHistory) {
+		if (s.stateID < minID) {
+			s.stateID = -1;
+		}
+	}
+}
+
+/*
+The full state is kept exactly as the client will see it, after being
+quantised, so that both ends take deltas from the same numbers.
+*/
+void NetworkObject::PrepareSnapshot(bool fullFrame, int fullStateID, const SnapshotQuantisation& quantisation) {
+	Vector3		position	= object.GetTransform().GetPosition();
+	Quaternion	orientation	= object.GetTransform().GetOrientation();
+
+	dirty = fullFrame || orientation != lastSnapshotOrientation ||
+		position.x != lastSnapshotPosition.x ||
+		position.y != lastSnapshotPosition.y ||
+		position.z != lastSnapshotPosition.z;
+
+	lastSnapshotPosition	= position;
+	lastSnapshotOrientation = orientation;
+
+	if (fullFrame) {
+		for (int i = 0; i < 3; ++i) {
+			lastFullState.position[i] = quantisation.DequantisePosition(quantisation.QuantisePosition(position[i]));
+		}
+		lastFullState.orientation	= quantisation.DequantiseOrientation(quantisation.QuantiseOrientation(orientation));
+		lastFullState.stateID		= fullStateID;
+		StoreNetworkState(lastFullState);
 	}
 }
 
+/*
+Small changes in position are much more common than big ones, so each
+axis's change gets sent in the smallest of a few sizes it fits in, with
+2 bits to say which. The changes are zigzagged first (0, -1, 1, -2, 2...)
+so that small negative numbers are small too.
+*/
+static const int DeltaSizeBits[3] = { 4, 8, 12 }; //and then big enough for anything
+
+static void WritePositionDelta(BitWriter& writer, int delta, int positionBits) {
+	uint32_t zigzag = delta < 0 ? ((uint32_t)(-(delta + 1)) << 1) | 1 : (uint32_t)delta << 1;
+	for (int size = 0; size < 3; ++size) {
+		if (zigzag < (1u << DeltaSizeBits[size])) {
+			writer.WriteBits(size, 2);
+			writer.WriteBits(zigzag, DeltaSizeBits[size]);
+			return;
+		}
+	}
+	writer.WriteBits(3, 2);
+	writer.WriteBits(zigzag, positionBits + 1);
+}
+
+static int ReadPositionDelta(BitReader& reader, int positionBits) {
+	int size		= (int)reader.ReadBits(2);
+	uint32_t zigzag = reader.ReadBits(size < 3 ? DeltaSizeBits[size] : positionBits + 1);
+	return (zigzag & 1) ? -(int)(zigzag >> 1) - 1 : (int)(zigzag >> 1);
+}
+
+/*
+Every entry is sent as a delta from the client's last acknowledged state,
+if the server still has it, holding only the parts that have changed since,
+with a bit for each to say whether it's there. If not, the whole state is
+sent. Either way, on a full frame the client keeps what it ends up with as
+the new full state, exactly as the server did in PrepareSnapshot.
+*/
+void NetworkObject::WriteSnapshotEntry(BitWriter& writer, int baseStateID, const SnapshotQuantisation& quantisation) {
+	NetworkState base;
+	bool isDelta		= GetNetworkState(baseStateID, base);
+	int positionBits	= quantisation.GetPositionBits();
+
+	Vector3		position	= object.GetTransform().GetPosition();
+	uint32_t	orientation = quantisation.QuantiseOrientation(object.GetTransform().GetOrientation());
+
+	writer.WriteBits(networkID, NetworkIDBits);
+	writer.WriteBool(isDelta);
+
+	if (!isDelta) {
+		uint32_t offset = 1u << (positionBits - 1);
+		for (int i = 0; i < 3; ++i) {
+			writer.WriteBits(quantisation.QuantisePosition(position[i]) + offset, positionBits);
+		}
+		writer.WriteBits(orientation, quantisation.GetOrientationBits());
+		return;
+	}
+	int delta[3];
+	int changed = 0;
+	for (int i = 0; i < 3; ++i) {
+		delta[i] = quantisation.QuantisePosition(position[i]) - quantisation.QuantisePosition(base.position[i]);
+		if (delta[i] != 0) {
+			changed |= 1 << i;
+		}
+	}
+	if (orientation != quantisation.QuantiseOrientation(base.orientation)) {
+		changed |= 8;
+	}
+	writer.WriteBits(changed, 4);
+	for (int i = 0; i < 3; ++i) {
+		if (changed & (1 << i)) {
+			WritePositionDelta(writer, delta[i], positionBits);
+		}
+	}
+	if (changed & 8) {
+		writer.WriteBits(orientation, quantisation.GetOrientationBits());
+	}
+}
+
+void NetworkObject::ReadSnapshotEntry(BitReader& reader, SnapshotEntry& entry, const SnapshotQuantisation& quantisation) {
+	int positionBits = quantisation.GetPositionBits();
+
+	entry.objectID	= (int)reader.ReadBits(NetworkIDBits);
+	entry.isDelta	= reader.ReadBool();
+
+	if (!entry.isDelta) {
+		int offset		= 1 << (positionBits - 1);
+		entry.changed	= 15;
+		for (int i = 0; i < 3; ++i) {
+			entry.position[i] = (int)reader.ReadBits(positionBits) - offset;
+		}
+		entry.orientation = reader.ReadBits(quantisation.GetOrientationBits());
+		return;
+	}
+	entry.changed = (int)reader.ReadBits(4);
+	for (int i = 0; i < 3; ++i) {
+		entry.position[i] = (entry.changed & (1 << i)) ? ReadPositionDelta(reader, positionBits) : 0;
+	}
+	entry.orientation = (entry.changed & 8) ? reader.ReadBits(quantisation.GetOrientationBits()) : 0;
+}
+
+bool NetworkObject::ApplySnapshotEntry(const SnapshotEntry& entry, const SnapshotQuantisation& quantisation) {
+	NetworkState base;
+	if (entry.isDelta && !GetNetworkState(entry.baseStateID, base)) {
+		deltaErrors++;
+		return false;
+	}
+	NetworkState state;
+	for (int i = 0; i < 3; ++i) {
+		if (!entry.isDelta) {
+			state.position[i] = quantisation.DequantisePosition(entry.position[i]);
+		}
+		else if (entry.changed & (1 << i)) {
+			state.position[i] = quantisation.DequantisePosition(quantisation.QuantisePosition(base.position[i]) + entry.position[i]);
+		}
+		else {
+			state.position[i] = base.position[i];
+		}
+	}
+	state.orientation	= (entry.changed & 8) ? quantisation.DequantiseOrientation(entry.orientation) : base.orientation;
+	state.stateID		= entry.fullStateID;
+
+	object.GetTransform().SetPosition(state.position);
+	object.GetTransform().SetOrientation(state.orientation);
+
+	if (state.stateID >= 0 && state.stateID > lastFullState.stateID) {
+		lastFullState = state;
+		StoreNetworkState(state);
+	}
+	return true;
+}
@@ -2,6 +2,7 @@
 #include "GameObject.h"
 #include "NetworkBase.h"
 #include "NetworkState.h"
+#include "Snapshot.h"
 
 namespace NCL::CSC8503 {
 	class GameObject;
@@ -28,12 +29,51 @@ namespace NCL::CSC8503 {
 		}
 	};
 
+	/*
+	One of these is sent to each client per tick, with an entry for every
+	object that changed packed in bit by bit straight after it, rather than
+	each object being sent in a packet of its own.
+	*/
+	struct SnapshotPacket : public GamePacket {
+		int				tick		= 0;
+		int				fullStateID	= -1;	//the full state made this tick, for clients to acknowledge, or -1 on delta frames
+		int				baseStateID	= -1;	//the full state that this snapshot's deltas are from, on any frame
+		unsigned short	objectCount = 0;
+
+		SnapshotPacket() {
+			type = Snapshot_State;
+			size = sizeof(SnapshotPacket) - sizeof(GamePacket);
+		}
+
+		const char* GetEntries() const {
+			return (const char*)this + sizeof(SnapshotPacket);
+		}
+
+		int GetEntryBytes() const {
+			return (int)(sizeof(GamePacket) + size - sizeof(SnapshotPacket));
+		}
+	};
+
+	//A single object's part of a snapshot, as read from the packet, still quantised
+	struct SnapshotEntry {
+		int			objectID	= -1;
+		bool		isDelta		= false;
+		int			baseStateID	= -1;	//the full state a delta is from
+		int			fullStateID	= -1;	//the full state this entry makes, on full frames
+		int			changed		= 0;	//deltas only - bits 0 to 2 for each position axis, 3 for the orientation
+		int			position[3]	= {};	//the position, or the change in it for deltas
+		uint32_t	orientation	= 0;
+	};
+
 	struct ClientPacket : public GamePacket {
 		int		lastID;
 		char	buttonstates[8];
 
 		ClientPacket() {
-			size = sizeof(ClientPacket);
+			type	= Received_State;
+			size	= sizeof(ClientPacket) - sizeof(GamePacket);
+			lastID	= -1;
+			memset(buttonstates, 0, sizeof(buttonstates));
 		}
 	};
 
@@ -47,8 +87,36 @@ namespace NCL::CSC8503 {
 		//Called by servers
 		virtual bool WritePacket(GamePacket** p, bool deltaFrame, int stateID);
 
+		//Forgets any states older than minID - the history is a fixed size anyway, so this is optional
 		void UpdateStateHistory(int minID);
 
+		int GetNetworkID() const {
+			return networkID;
+		}
+
+		/*
+		Called by servers once per snapshot, before any client's snapshot is
+		written. Full frames make a new full state for deltas to be taken
+		from - every object's full state from the same frame has the same ID,
+		so a client only needs to acknowledge one number. An object only
+		needs to be in a delta frame's snapshots if it has moved since the
+		last one.
+		*/
+		void PrepareSnapshot(bool fullFrame, int fullStateID, const SnapshotQuantisation& quantisation = SnapshotQuantisation());
+
+		bool IsDirty() const {
+			return dirty;
+		}
+
+		//Writes this object's snapshot entry, as a delta from baseStateID (the client's last acknowledged state) if that's still kept
+		void WriteSnapshotEntry(BitWriter& writer, int baseStateID, const SnapshotQuantisation& quantisation);
+
+		//Called by clients - entries are read first, so that ones for unknown objects can still be skipped over
+		static void ReadSnapshotEntry(BitReader& reader, SnapshotEntry& entry, const SnapshotQuantisation& quantisation);
+		bool ApplySnapshotEntry(const SnapshotEntry& entry, const SnapshotQuantisation& quantisation);
+
+		static constexpr int NetworkIDBits = 16;
+
 	protected:
 
 		NetworkState& GetLatestNetworkState();
@@ -65,11 +133,24 @@ namespace NCL::CSC8503 {
 
 		NetworkState lastFullState;
 
-		std::vector<NetworkState> stateHistory;
+		void StoreNetworkState(const NetworkState& state);
+
+		/*
+		The last few full states, so that deltas can be made from (or, on the
+		client, applied to) any of them, not just the newest. A state lives
+		in the slot its ID picks, until a newer state lands on top of it, so
+		finding one is a single lookup, and the history never grows.
+		*/
+		static constexpr int StateHistorySize = 32;
+		NetworkState stateHistory[StateHistorySize];
 
 		int deltaErrors;
 		int fullErrors;
 
 		int networkID;
+
+		bool		dirty;
+		Vector3		lastSnapshotPosition;
+		Quaternion	lastSnapshotOrientation;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,410 @@
+#include "PhysicsBodyStore.h"
+#include "GameWorld.h"
+#include "GameObject.h"
+#include "PhysicsObject.h"
+
+#include "Simd.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+//Rotates (vx, vy, vz) by the unit quaternion (qx, qy, qz, qw), for a whole lane of objects at once
+static inline void SimdRotate(SimdFloat qx, SimdFloat qy, SimdFloat qz, SimdFloat qw,
+	SimdFloat& vx, SimdFloat& vy, SimdFloat& vz) {
+	//t = 2 * cross(q.xyz, v)
+	SimdFloat two = SimdSet(2.0f);
+	SimdFloat tx = SimdMul(two, SimdSub(SimdMul(qy, vz), SimdMul(qz, vy)));
+	SimdFloat ty = SimdMul(two, SimdSub(SimdMul(qz, vx), SimdMul(qx, vz)));
+	SimdFloat tz = SimdMul(two, SimdSub(SimdMul(qx, vy), SimdMul(qy, vx)));
+	//v' = v + q.w * t + cross(q.xyz, t)
+	SimdFloat rx = SimdAdd(SimdAdd(vx, SimdMul(qw, tx)), SimdSub(SimdMul(qy, tz), SimdMul(qz, ty)));
+	SimdFloat ry = SimdAdd(SimdAdd(vy, SimdMul(qw, ty)), SimdSub(SimdMul(qz, tx), SimdMul(qx, tz)));
+	SimdFloat rz = SimdAdd(SimdAdd(vz, SimdMul(qw, tz)), SimdSub(SimdMul(qx, ty), SimdMul(qy, tx)));
+	vx = rx;
+	vy = ry;
+	vz = rz;
+}
+
+//The same sum as PhysicsObject::UpdateInertiaTensor
+static Matrix3 WorldInertiaTensor(const Quaternion& q, const Vector3& inverseInertia) {
+	Matrix3 invOrientation	= Quaternion::RotationMatrix<Matrix3>(q.Conjugate());
+	Matrix3 orientation		= Quaternion::RotationMatrix<Matrix3>(q);
+
+	return orientation * Matrix::Scale3x3(inverseInertia) * invOrientation;
+}
+
+void PhysicsBodyStore::Resize(int count)
+{
+	bodyCount	= count;
+	int padded	= ((count + SimdWidth - 1) / SimdWidth) * SimdWidth;
+
+	objects.resize(count);
+	inverseInertiaTensor.resize(count);
+
+	std::vector<float>* arrays[] = {
+		&positionX, &positionY, &positionZ,
+		&orientationX, &orientationY, &orientationZ, &orientationW,
+		&startPositionX, &startPositionY, &startPositionZ,
+		&startOrientationX, &startOrientationY, &startOrientationZ, &startOrientationW,
+		&linearVelocityX, &linearVelocityY, &linearVelocityZ,
+		&angularVelocityX, &angularVelocityY, &angularVelocityZ,
+		&forceX, &forceY, &forceZ,
+		&torqueX, &torqueY, &torqueZ,
+		&inverseInertiaX, &inverseInertiaY, &inverseInertiaZ,
+		&inverseMass, &hasMass, &awake, &moved, &sleepTimer
+	};
+	for (std::vector<float>* a : arrays) {
+		a->assign(padded, 0.0f);
+	}
+	//The padding lanes get an identity orientation, so normalising them is safe
+	for (int i = count; i < padded; ++i) {
+		orientationW[i] = 1.0f;
+	}
+}
+
+void PhysicsBodyStore::Gather(const GameWorld& world)
+{
+	std::vector<GameObject*>::const_iterator first;
+	std::vector<GameObject*>::const_iterator last;
+	world.GetObjectIterators(first, last);
+
+	int count		= 0;
+	int maxWorldID	= -1;
+	for (auto i = first; i != last; ++i) {
+		if ((*i)->GetPhysicsObject()) {
+			count++;
+		}
+		maxWorldID = std::max(maxWorldID, (*i)->GetWorldID());
+	}
+	Resize(count);
+	bodyOfWorldID.assign(maxWorldID + 1, -1);
+
+	int body = 0;
+	for (auto i = first; i != last; ++i) {
+		PhysicsObject* object = (*i)->GetPhysicsObject();
+		if (object == nullptr) {
+			continue;
+		}
+		const Transform& transform = (*i)->GetTransform();
+		Vector3		position	= transform.GetPosition();
+		Quaternion	orientation = transform.GetOrientation();
+		Vector3		inertia		= object->GetInverseInertia();
+		Vector3		linear		= object->GetLinearVelocity();
+		Vector3		angular		= object->GetAngularVelocity();
+		Vector3		force		= object->GetForce();
+		Vector3		torque		= object->GetTorque();
+
+		objects[body] = *i;
+		bodyOfWorldID[(*i)->GetWorldID()] = body;
+
+		positionX[body] = position.x;
+		positionY[body] = position.y;
+		positionZ[body] = position.z;
+
+		orientationX[body] = orientation.x;
+		orientationY[body] = orientation.y;
+		orientationZ[body] = orientation.z;
+		orientationW[body] = orientation.w;
+
+		linearVelocityX[body] = linear.x;
+		linearVelocityY[body] = linear.y;
+		linearVelocityZ[body] = linear.z;
+
+		angularVelocityX[body] = angular.x;
+		angularVelocityY[body] = angular.y;
+		angularVelocityZ[body] = angular.z;
+
+		//Forces only ever come from the game, so they can't change until the update is over
+		forceX[body] = force.x;
+		forceY[body] = force.y;
+		forceZ[body] = force.z;
+
+		torqueX[body] = torque.x;
+		torqueY[body] = torque.y;
+		torqueZ[body] = torque.z;
+
+		inverseInertiaX[body] = inertia.x;
+		inverseInertiaY[body] = inertia.y;
+		inverseInertiaZ[body] = inertia.z;
+
+		inverseMass[body]	= object->GetInverseMass();
+		hasMass[body]		= object->GetInverseMass() > 0.0f ? 1.0f : 0.0f;
+		awake[body]			= object->IsAsleep() ? 0.0f : 1.0f;
+		sleepTimer[body]	= object->GetSleepTimer();
+
+		inverseInertiaTensor[body] = WorldInertiaTensor(orientation, inertia); //the game might have turned it since last frame
+		body++;
+	}
+}
+
+/*
+Only objects that were awake for at least one substep can have moved, so
+only their Transforms are touched - a sleeping pile of boxes doesn't need
+its matrices rebuilding. The velocities and sleep state are written
+directly, rather than through the setters, as those would wake everything.
+*/
+void PhysicsBodyStore::Scatter()
+{
+	for (int i = 0; i < bodyCount; ++i) {
+		if (moved[i] != 0.0f) {
+			objects[i]->GetTransform().SetPositionAndOrientation(GetPosition(i), GetOrientation(i));
+		}
+		PhysicsObject* object = objects[i]->GetPhysicsObject();
+
+		object->linearVelocity			= GetLinearVelocity(i);
+		object->angularVelocity			= GetAngularVelocity(i);
+		object->asleep					= IsAsleep(i);
+		object->sleepTimer				= sleepTimer[i];
+		object->inverseInteriaTensor	= inverseInertiaTensor[i];
+	}
+}
+
+void PhysicsBodyStore::StoreTransform(int body)
+{
+	objects[body]->GetTransform().SetPositionAndOrientation(GetPosition(body), GetOrientation(body));
+	objects[body]->GetPhysicsObject()->inverseInteriaTensor = inverseInertiaTensor[body];
+}
+
+void PhysicsBodyStore::StoreVelocities(int body)
+{
+	PhysicsObject* object = objects[body]->GetPhysicsObject();
+
+	object->linearVelocity	= GetLinearVelocity(body);
+	object->angularVelocity = GetAngularVelocity(body);
+	object->asleep			= IsAsleep(body);
+	object->sleepTimer		= sleepTimer[body];
+}
+
+void PhysicsBodyStore::LoadVelocities(int body)
+{
+	const PhysicsObject* object = objects[body]->GetPhysicsObject();
+
+	Vector3 linear	= object->GetLinearVelocity();
+	Vector3 angular = object->GetAngularVelocity();
+
+	linearVelocityX[body] = linear.x;
+	linearVelocityY[body] = linear.y;
+	linearVelocityZ[body] = linear.z;
+
+	angularVelocityX[body] = angular.x;
+	angularVelocityY[body] = angular.y;
+	angularVelocityZ[body] = angular.z;
+
+	awake[body]			= object->IsAsleep() ? 0.0f : 1.0f;
+	sleepTimer[body]	= object->GetSleepTimer();
+}
+
+int PhysicsBodyStore::GetBody(const GameObject* object) const
+{
+	int worldID = object->GetWorldID();
+	if (worldID < 0 || worldID >= (int)bodyOfWorldID.size()) {
+		return -1;
+	}
+	return bodyOfWorldID[worldID];
+}
+
+Transform PhysicsBodyStore::GetTransform(int body) const
+{
+	Transform transform = objects[body]->GetTransform();
+	transform.SetPositionAndOrientation(GetPosition(body), GetOrientation(body));
+	return transform;
+}
+
+Transform PhysicsBodyStore::GetStartTransform(int body) const
+{
+	Transform transform = objects[body]->GetTransform();
+	transform.SetPositionAndOrientation(
+		Vector3(startPositionX[body], startPositionY[body], startPositionZ[body]),
+		Quaternion(startOrientationX[body], startOrientationY[body], startOrientationZ[body], startOrientationW[body]));
+	return transform;
+}
+
+void PhysicsBodyStore::ApplyLinearImpulse(int body, const Vector3& impulse)
+{
+	Vector3 change = impulse * inverseMass[body];
+
+	linearVelocityX[body] += change.x;
+	linearVelocityY[body] += change.y;
+	linearVelocityZ[body] += change.z;
+	awake[body] = 1.0f;
+}
+
+void PhysicsBodyStore::ApplyAngularImpulse(int body, const Vector3& impulse)
+{
+	Vector3 change = inverseInertiaTensor[body] * impulse;
+
+	angularVelocityX[body] += change.x;
+	angularVelocityY[body] += change.y;
+	angularVelocityZ[body] += change.z;
+	awake[body] = 1.0f;
+}
+
+//As with PhysicsObject::Sleep, a sleeping body is stopped dead
+void PhysicsBodyStore::Sleep(int body)
+{
+	awake[body]				= 0.0f;
+	linearVelocityX[body]	= 0.0f;
+	linearVelocityY[body]	= 0.0f;
+	linearVelocityZ[body]	= 0.0f;
+	angularVelocityX[body]	= 0.0f;
+	angularVelocityY[body]	= 0.0f;
+	angularVelocityZ[body]	= 0.0f;
+}
+
+void PhysicsBodyStore::Wake(int body)
+{
+	awake[body]			= 1.0f;
+	sleepTimer[body]	= 0.0f;
+}
+
+void PhysicsBodyStore::UpdateInertiaTensors()
+{
+	for (int i = 0; i < bodyCount; ++i) {
+		if (awake[i] != 0.0f) {
+			inverseInertiaTensor[i] = WorldInertiaTensor(GetOrientation(i),
+				Vector3(inverseInertiaX[i], inverseInertiaY[i], inverseInertiaZ[i]));
+		}
+	}
+}
+
+//The same test as PhysicsObject::UpdateSleepTimer, for every awake body
+void PhysicsBodyStore::UpdateSleepTimers(float dt, float linearTolerance, float angularTolerance)
+{
+	for (int i = 0; i < bodyCount; ++i) {
+		if (awake[i] == 0.0f) {
+			continue;
+		}
+		if (Vector::LengthSquared(GetLinearVelocity(i))  > linearTolerance  * linearTolerance ||
+			Vector::LengthSquared(GetAngularVelocity(i)) > angularTolerance * angularTolerance) {
+			sleepTimer[i] = 0.0f;
+		}
+		else {
+			sleepTimer[i] += dt;
+		}
+	}
+}
+
+/*
+Applies the forces, torques and gravity gathered up over the last frame.
+Torques are turned into angular acceleration by rotating them into each
+object's local space, scaling them by its inverse inertia, and rotating
+them back again - the same as multiplying by the world space inertia
+tensor, but without needing to build a matrix for each object first.
+*/
+void PhysicsBodyStore::IntegrateAccel(const Vector3& gravity, float dt)
+{
+	const SimdFloat timeStep = SimdSet(dt);
+	const SimdFloat gravityX = SimdSet(gravity.x);
+	const SimdFloat gravityY = SimdSet(gravity.y);
+	const SimdFloat gravityZ = SimdSet(gravity.z);
+
+	for (int i = 0; i < bodyCount; i += SimdWidth) {
+		SimdFloat scale		= SimdMul(SimdLoad(&awake[i]), timeStep);
+		SimdFloat invMass	= SimdLoad(&inverseMass[i]);
+		SimdFloat massMask	= SimdLoad(&hasMass[i]);
+
+		SimdFloat ax = SimdAdd(SimdMul(SimdLoad(&forceX[i]), invMass), SimdMul(gravityX, massMask));
+		SimdFloat ay = SimdAdd(SimdMul(SimdLoad(&forceY[i]), invMass), SimdMul(gravityY, massMask));
+		SimdFloat az = SimdAdd(SimdMul(SimdLoad(&forceZ[i]), invMass), SimdMul(gravityZ, massMask));
+
+		SimdStore(&linearVelocityX[i], SimdAdd(SimdLoad(&linearVelocityX[i]), SimdMul(ax, scale)));
+		SimdStore(&linearVelocityY[i], SimdAdd(SimdLoad(&linearVelocityY[i]), SimdMul(ay, scale)));
+		SimdStore(&linearVelocityZ[i], SimdAdd(SimdLoad(&linearVelocityZ[i]), SimdMul(az, scale)));
+
+		SimdFloat qx = SimdLoad(&orientationX[i]);
+		SimdFloat qy = SimdLoad(&orientationY[i]);
+		SimdFloat qz = SimdLoad(&orientationZ[i]);
+		SimdFloat qw = SimdLoad(&orientationW[i]);
+		SimdFloat zero = SimdSet(0.0f);
+
+		SimdFloat tx = SimdLoad(&torqueX[i]);
+		SimdFloat ty = SimdLoad(&torqueY[i]);
+		SimdFloat tz = SimdLoad(&torqueZ[i]);
+
+		SimdRotate(SimdSub(zero, qx), SimdSub(zero, qy), SimdSub(zero, qz), qw, tx, ty, tz);
+		tx = SimdMul(tx, SimdLoad(&inverseInertiaX[i]));
+		ty = SimdMul(ty, SimdLoad(&inverseInertiaY[i]));
+		tz = SimdMul(tz, SimdLoad(&inverseInertiaZ[i]));
+		SimdRotate(qx, qy, qz, qw, tx, ty, tz);
+
+		SimdStore(&angularVelocityX[i], SimdAdd(SimdLoad(&angularVelocityX[i]), SimdMul(tx, scale)));
+		SimdStore(&angularVelocityY[i], SimdAdd(SimdLoad(&angularVelocityY[i]), SimdMul(ty, scale)));
+		SimdStore(&angularVelocityZ[i], SimdAdd(SimdLoad(&angularVelocityZ[i]), SimdMul(tz, scale)));
+	}
+}
+
+/*
+Moves every object along by its velocity, and then damps it. Sleeping
+objects have no velocity, but renormalising their orientation could
+still nudge it, so their orientation is left as it was. Where everything
+started from is kept, for the swept collisions to work from.
+*/
+void PhysicsBodyStore::IntegrateVelocity(float linearDamping, float angularDamping, float dt)
+{
+	const SimdFloat timeStep		= SimdSet(dt);
+	const SimdFloat halfTimeStep	= SimdSet(dt * 0.5f);
+	const SimdFloat linearDamp		= SimdSet(linearDamping);
+	const SimdFloat angularDamp		= SimdSet(angularDamping);
+
+	for (int i = 0; i < bodyCount; i += SimdWidth) {
+		SimdFloat isAwake	= SimdLoad(&awake[i]);
+		SimdFloat awakeMask = SimdGreater(isAwake, SimdSet(0.0f));
+		SimdStore(&moved[i], SimdMax(SimdLoad(&moved[i]), isAwake));
+
+		SimdFloat vx = SimdLoad(&linearVelocityX[i]);
+		SimdFloat vy = SimdLoad(&linearVelocityY[i]);
+		SimdFloat vz = SimdLoad(&linearVelocityZ[i]);
+
+		SimdFloat px = SimdLoad(&positionX[i]);
+		SimdFloat py = SimdLoad(&positionY[i]);
+		SimdFloat pz = SimdLoad(&positionZ[i]);
+
+		SimdStore(&startPositionX[i], px);
+		SimdStore(&startPositionY[i], py);
+		SimdStore(&startPositionZ[i], pz);
+
+		SimdStore(&positionX[i], SimdAdd(px, SimdMul(vx, timeStep)));
+		SimdStore(&positionY[i], SimdAdd(py, SimdMul(vy, timeStep)));
+		SimdStore(&positionZ[i], SimdAdd(pz, SimdMul(vz, timeStep)));
+
+		SimdStore(&linearVelocityX[i], SimdMul(vx, linearDamp));
+		SimdStore(&linearVelocityY[i], SimdMul(vy, linearDamp));
+		SimdStore(&linearVelocityZ[i], SimdMul(vz, linearDamp));
+
+		SimdFloat wx = SimdLoad(&angularVelocityX[i]);
+		SimdFloat wy = SimdLoad(&angularVelocityY[i]);
+		SimdFloat wz = SimdLoad(&angularVelocityZ[i]);
+
+		//orientation += Quaternion(angVel * dt * 0.5f, 0.0f) * orientation
+		SimdFloat sx = SimdMul(wx, halfTimeStep);
+		SimdFloat sy = SimdMul(wy, halfTimeStep);
+		SimdFloat sz = SimdMul(wz, halfTimeStep);
+
+		SimdFloat qx = SimdLoad(&orientationX[i]);
+		SimdFloat qy = SimdLoad(&orientationY[i]);
+		SimdFloat qz = SimdLoad(&orientationZ[i]);
+		SimdFloat qw = SimdLoad(&orientationW[i]);
+
+		SimdStore(&startOrientationX[i], qx);
+		SimdStore(&startOrientationY[i], qy);
+		SimdStore(&startOrientationZ[i], qz);
+		SimdStore(&startOrientationW[i], qw);
+
+		SimdFloat nx = SimdAdd(qx, SimdAdd(SimdMul(sx, qw), SimdSub(SimdMul(sy, qz), SimdMul(sz, qy))));
+		SimdFloat ny = SimdAdd(qy, SimdAdd(SimdMul(sy, qw), SimdSub(SimdMul(sz, qx), SimdMul(sx, qz))));
+		SimdFloat nz = SimdAdd(qz, SimdAdd(SimdMul(sz, qw), SimdSub(SimdMul(sx, qy), SimdMul(sy, qx))));
+		SimdFloat nw = SimdSub(qw, SimdAdd(SimdMul(sx, qx), SimdAdd(SimdMul(sy, qy), SimdMul(sz, qz))));
+
+		SimdFloat lengthSq	= SimdAdd(SimdAdd(SimdMul(nx, nx), SimdMul(ny, ny)), SimdAdd(SimdMul(nz, nz), SimdMul(nw, nw)));
+		SimdFloat invLength = SimdDiv(SimdSet(1.0f), SimdSqrt(lengthSq));
+
+		SimdStore(&orientationX[i], SimdSelect(awakeMask, SimdMul(nx, invLength), qx));
+		SimdStore(&orientationY[i], SimdSelect(awakeMask, SimdMul(ny, invLength), qy));
+		SimdStore(&orientationZ[i], SimdSelect(awakeMask, SimdMul(nz, invLength), qz));
+		SimdStore(&orientationW[i], SimdSelect(awakeMask, SimdMul(nw, invLength), qw));
+
+		SimdStore(&angularVelocityX[i], SimdMul(wx, angularDamp));
+		SimdStore(&angularVelocityY[i], SimdMul(wy, angularDamp));
+		SimdStore(&angularVelocityZ[i], SimdMul(wz, angularDamp));
+	}
+}
@@ -0,0 +1,150 @@
+#pragma once
+using namespace NCL::Maths;
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameObject;
+		class GameWorld;
+		class Transform;
+
+		/*
+		Integration touches every moving object twice a substep, but only ever
+		needs a handful of values from each of them. Rather than chasing a
+		pointer to each GameObject, and then another to its PhysicsObject, the
+		values are copied out into one tightly packed array per component - all
+		of the x positions together, then all of the y positions, and so on.
+
+		Laid out like this, the integration steps become simple loops over
+		arrays, which can work on 4 (or with AVX, 8) objects at a time using
+		SIMD instructions. The arrays are always padded out to a whole number
+		of SIMD lanes, with the padding set up as an object that never moves.
+
+		The arrays are the physics state for the whole of an update - they're
+		copied out of the objects once at the start, and everything from the
+		collision detection through to the contact solver works on them, so
+		the Transforms and PhysicsObjects are only written back to once, at the
+		end. The only exception is the constraints, which are written against
+		PhysicsObjects - the few objects they're attached to are handed over
+		to them, and picked back up again afterwards.
+		*/
+		class PhysicsBodyStore {
+		public:
+			PhysicsBodyStore()	= default;
+			~PhysicsBodyStore() = default;
+
+			//Copies out every object with a PhysicsObject, at the start of a frame
+			void Gather(const GameWorld& world);
+
+			//Copies everything back into the objects, once the frame's substeps are done
+			void Scatter();
+
+			//Hands a body's state over to something that only works on PhysicsObjects...
+			void StoreTransform(int body);
+			void StoreVelocities(int body);
+			//...and picks up whatever it did to the velocities
+			void LoadVelocities(int body);
+
+			void IntegrateAccel(const Vector3& gravity, float dt);
+			void IntegrateVelocity(float linearDamping, float angularDamping, float dt);
+
+			//Brings the world space inertia tensors up to date with the new orientations
+			void UpdateInertiaTensors();
+			void UpdateSleepTimers(float dt, float linearTolerance, float angularTolerance);
+
+			int GetBodyCount() const
+			{
+				return bodyCount;
+			}
+
+			GameObject* GetObject(int body) const
+			{
+				return objects[body];
+			}
+
+			//-1 if the object has no PhysicsObject, or was added since the last Gather
+			int GetBody(const GameObject* object) const;
+
+			Vector3 GetPosition(int body) const
+			{
+				return Vector3(positionX[body], positionY[body], positionZ[body]);
+			}
+
+			void SetPosition(int body, const Vector3& position)
+			{
+				positionX[body] = position.x;
+				positionY[body] = position.y;
+				positionZ[body] = position.z;
+			}
+
+			Quaternion GetOrientation(int body) const
+			{
+				return Quaternion(orientationX[body], orientationY[body], orientationZ[body], orientationW[body]);
+			}
+
+			//The object's Transform, moved to wherever the physics has it now...
+			Transform GetTransform(int body) const;
+			//...or to where it was at the start of the last IntegrateVelocity
+			Transform GetStartTransform(int body) const;
+
+			Vector3 GetLinearVelocity(int body) const
+			{
+				return Vector3(linearVelocityX[body], linearVelocityY[body], linearVelocityZ[body]);
+			}
+
+			Vector3 GetAngularVelocity(int body) const
+			{
+				return Vector3(angularVelocityX[body], angularVelocityY[body], angularVelocityZ[body]);
+			}
+
+			float GetInverseMass(int body) const
+			{
+				return inverseMass[body];
+			}
+
+			const Matrix3& GetInertiaTensor(int body) const
+			{
+				return inverseInertiaTensor[body];
+			}
+
+			//These work just like the PhysicsObject's versions, waking the body up
+			void ApplyLinearImpulse(int body, const Vector3& impulse);
+			void ApplyAngularImpulse(int body, const Vector3& impulse);
+
+			bool IsAsleep(int body) const
+			{
+				return awake[body] == 0.0f;
+			}
+
+			void Sleep(int body);
+			void Wake(int body);
+
+			float GetSleepTimer(int body) const
+			{
+				return sleepTimer[body];
+			}
+
+		protected:
+			void Resize(int count);
+
+			std::vector<GameObject*> objects;
+			std::vector<int> bodyOfWorldID;	//-1 for objects that aren't in here
+			int bodyCount = 0;
+
+			std::vector<float> positionX, positionY, positionZ;
+			std::vector<float> orientationX, orientationY, orientationZ, orientationW;
+			std::vector<float> startPositionX, startPositionY, startPositionZ;	//before the last IntegrateVelocity, for the swept collisions
+			std::vector<float> startOrientationX, startOrientationY, startOrientationZ, startOrientationW;
+			std::vector<float> linearVelocityX, linearVelocityY, linearVelocityZ;
+			std::vector<float> angularVelocityX, angularVelocityY, angularVelocityZ;
+			std::vector<float> forceX, forceY, forceZ;
+			std::vector<float> torqueX, torqueY, torqueZ;
+			std::vector<float> inverseInertiaX, inverseInertiaY, inverseInertiaZ;	//in the object's local space
+			std::vector<float> inverseMass;
+			std::vector<float> hasMass;	//1 if the object falls under gravity, 0 if not
+			std::vector<float> awake;	//1 if the object is being simulated, 0 if asleep
+			std::vector<float> moved;	//1 if the object has been awake for any substep, so its Transform needs updating
+			std::vector<float> sleepTimer;
+			std::vector<Matrix3> inverseInertiaTensor;	//in world space
+		};
+	}
+}
@@ -12,21 +12,29 @@ PhysicsObject::PhysicsObject(Transform& parentTransform, const CollisionVolume*
 	inverseMass = 1.0f;
 	elasticity	= 0.8f;
 	friction	= 0.8f;
+
+	asleep		= false;
+	sleepTimer	= 0.0f;
+
+	continuousCollision = false;
 }
 
 void PhysicsObject::ApplyAngularImpulse(const Vector3& force) 
 {
 	angularVelocity += inverseInteriaTensor * force;
+	asleep = false;
 }
 
 void PhysicsObject::ApplyLinearImpulse(const Vector3& force) 
 {
 	linearVelocity += force * inverseMass;
+	asleep = false;
 }
 
 void PhysicsObject::AddForce(const Vector3& addedForce) 
 {
 	force += addedForce;
+	asleep = false;
 }
 
 void PhysicsObject::AddForceAtPosition(
@@ -36,11 +44,13 @@ void PhysicsObject::AddForceAtPosition(
 
 	force += addedForce;
 	torque += Vector::Cross(localPos, addedForce);
+	asleep = false;
 }
 
 void PhysicsObject::AddTorque(const Vector3& addedTorque) 
 {
 	torque += addedTorque;
+	asleep = false;
 }
 
 void PhysicsObject::ClearForces() 
@@ -49,6 +59,38 @@ void PhysicsObject::ClearForces()
 	torque	= Vector3();
 }
 
+/*
+Putting an object to sleep stops it dead, so that it doesn't drift off
+when it's eventually woken back up. Adding forces or impulses, or setting
+its velocity, wakes it too - but that only clears the flag. The sleep timer
+is left for UpdateSleepTimer to reset once the object is actually moving,
+so nudging an object without really moving it just lets it fall straight
+back to sleep.
+*/
+void PhysicsObject::Sleep() 
+{
+	asleep			= true;
+	linearVelocity	= Vector3();
+	angularVelocity = Vector3();
+}
+
+void PhysicsObject::Wake() 
+{
+	asleep		= false;
+	sleepTimer	= 0.0f;
+}
+
+void PhysicsObject::UpdateSleepTimer(float dt, float linearTolerance, float angularTolerance) 
+{
+	if (Vector::LengthSquared(linearVelocity)  > linearTolerance  * linearTolerance ||
+		Vector::LengthSquared(angularVelocity) > angularTolerance * angularTolerance) {
+		sleepTimer = 0.0f;
+	}
+	else {
+		sleepTimer += dt;
+	}
+}
+
 void PhysicsObject::InitCubeInertia() 
 {
 	Vector3 dimensions	= transform.GetScale();
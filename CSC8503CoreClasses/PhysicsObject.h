@@ -42,6 +42,38 @@ namespace NCL {
 				return inverseMass;
 			}
 
+			void SetElasticity(float e) 
+			{
+				elasticity = e;
+			}
+
+			float GetElasticity() const 
+			{
+				return elasticity;
+			}
+
+			void SetFriction(float f) 
+			{
+				friction = f;
+			}
+
+			float GetFriction() const 
+			{
+				return friction;
+			}
+
+			//Fast moving objects can be swept along their motion each substep,
+			//so they can't skip straight past thin objects like walls
+			void SetContinuousCollision(bool state) 
+			{
+				continuousCollision = state;
+			}
+
+			bool UsesContinuousCollision() const 
+			{
+				return continuousCollision;
+			}
+
 			void ApplyAngularImpulse(const Vector3& force);
 			void ApplyLinearImpulse(const Vector3& force);
 			
@@ -56,14 +88,33 @@ namespace NCL {
 
 			void SetLinearVelocity(const Vector3& v) 
 			{
-				linearVelocity = v;
+				linearVelocity	= v;
+				asleep			= false;
 			}
 
 			void SetAngularVelocity(const Vector3& v) 
 			{
 				angularVelocity = v;
+				asleep			= false;
+			}
+
+			bool IsAsleep() const 
+			{
+				return asleep;
+			}
+
+			//Sleeping objects are skipped by the physics, until something wakes them
+			void Sleep();
+			void Wake();
+
+			float GetSleepTimer() const 
+			{
+				return sleepTimer;
 			}
 
+			//Counts up how long the object has been moving slowly enough to sleep
+			void UpdateSleepTimer(float dt, float linearTolerance, float angularTolerance);
+
 			void InitCubeInertia();
 			void InitSphereInertia();
 
@@ -74,7 +125,15 @@ namespace NCL {
 				return inverseInteriaTensor;
 			}
 
+			Vector3 GetInverseInertia() const 
+			{
+				return inverseInertia;
+			}
+
 		protected:
+			//Copies the physics update's results straight back in, without waking anything
+			friend class PhysicsBodyStore;
+
 			const CollisionVolume* volume;
 			Transform&		transform;
 
@@ -82,6 +141,11 @@ namespace NCL {
 			float elasticity;
 			float friction;
 
+			bool  asleep;
+			float sleepTimer;
+
+			bool  continuousCollision;
+
 			//linear stuff
 			Vector3 linearVelocity;
 			Vector3 force;
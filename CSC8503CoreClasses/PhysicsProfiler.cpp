@@ -0,0 +1,152 @@
+#include "PhysicsProfiler.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+PhysicsProfiler::PhysicsProfiler() : slots(HistorySize) {
+	for (Slot& s : slots) {
+		s.sequence.store(0, std::memory_order_relaxed);
+	}
+	written.store(0, std::memory_order_relaxed);
+
+	currentPhase	= -1;
+	phaseStarted	= 0.0;
+	enabled			= true;
+	startPoint		= std::chrono::high_resolution_clock::now();
+}
+
+double PhysicsProfiler::Now() const {
+	return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - startPoint).count();
+}
+
+void PhysicsProfiler::BeginSubstep(int step, int substep) {
+	if (!enabled) {
+		return;
+	}
+	current				= PhysicsStepStats();
+	current.step		= step;
+	current.substep		= substep;
+	current.startTime	= Now();
+	currentPhase		= -1;
+}
+
+void PhysicsProfiler::StartPhase(PhysicsPhase phase) {
+	if (!enabled) {
+		return;
+	}
+	double now = Now();
+	if (currentPhase >= 0) {
+		current.phaseTime[currentPhase] += (float)(now - phaseStarted);
+	}
+	currentPhase	= (int)phase;
+	phaseStarted	= now;
+	if (current.phaseTime[currentPhase] == 0.0f) {
+		current.phaseStart[currentPhase] = (float)(now - current.startTime);
+	}
+}
+
+void PhysicsProfiler::EndSubstep(int pairsTested, int contactsFound, int bodiesAwake) {
+	if (!enabled) {
+		return;
+	}
+	if (currentPhase >= 0) {
+		current.phaseTime[currentPhase] += (float)(Now() - phaseStarted);
+		currentPhase = -1;
+	}
+	current.pairsTested		= pairsTested;
+	current.contactsFound	= contactsFound;
+	current.bodiesAwake		= bodiesAwake;
+
+	uint64_t index	= written.load(std::memory_order_relaxed);
+	Slot& slot		= slots[index % HistorySize];
+
+	slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.stats = current;
+	slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+	written.store(index + 1, std::memory_order_release);
+}
+
+/*
+A record is only kept if its slot's sequence number says it was finished,
+and still says the same thing after it was copied - otherwise the physics
+thread has lapped the reader and started writing over it.
+*/
+int PhysicsProfiler::CopyRecent(std::vector<PhysicsStepStats>& out, int maxCount) const {
+	out.clear();
+	uint64_t end	= written.load(std::memory_order_acquire);
+	uint64_t count	= std::min<uint64_t>(end, (uint64_t)std::clamp(maxCount, 0, HistorySize));
+
+	for (uint64_t index = end - count; index < end; ++index) {
+		const Slot& slot = slots[index % HistorySize];
+
+		uint64_t before = slot.sequence.load(std::memory_order_acquire);
+		PhysicsStepStats copy = slot.stats;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+
+		if (before == 2 * index + 2 && after == before) {
+			out.emplace_back(copy);
+		}
+	}
+	return (int)out.size();
+}
+
+const char* PhysicsProfiler::GetPhaseName(PhysicsPhase phase) {
+	switch (phase) {
+		case PhysicsPhase::IntegrateAccel:		return "IntegrateAccel";
+		case PhysicsPhase::Broadphase:			return "Broadphase";
+		case PhysicsPhase::Narrowphase:			return "Narrowphase";
+		case PhysicsPhase::Constraints:			return "Constraints";
+		case PhysicsPhase::IntegrateVelocity:	return "IntegrateVelocity";
+		case PhysicsPhase::Islands:				return "Islands";
+		default: return "Unknown";
+	}
+}
+
+/*
+Each substep becomes a 'complete' event, with its phases as events nested
+inside it, and the counters become counter events, which the viewer draws
+as graphs underneath. Times in the trace format are in microseconds.
+*/
+bool PhysicsProfiler::WriteChromeTrace(const std::string& filename) const {
+	std::ofstream file(filename);
+	if (!file) {
+		return false;
+	}
+	std::vector<PhysicsStepStats> records;
+	CopyRecent(records);
+
+	file << "{\"traceEvents\":[\n";
+	bool first = true;
+	auto WriteEvent = [&](const char* name, const char* type, double time, double duration, const PhysicsStepStats& s) {
+		file << (first ? "" : ",\n");
+		first = false;
+		file << "{\"name\":\"" << name << "\",\"cat\":\"physics\",\"ph\":\"" << type << "\",\"pid\":0,\"tid\":0,\"ts\":" << time;
+		if (type[0] == 'X') {
+			file << ",\"dur\":" << duration << ",\"args\":{\"step\":" << s.step << ",\"substep\":" << s.substep << "}}";
+		}
+		else {
+			file << ",\"args\":{\"pairsTested\":" << s.pairsTested << ",\"contactsFound\":" << s.contactsFound << ",\"bodiesAwake\":" << s.bodiesAwake << "}}";
+		}
+	};
+	file << std::fixed;
+	file.precision(3);
+
+	for (const PhysicsStepStats& s : records) {
+		double total = 0.0;
+		for (int i = 0; i < (int)PhysicsPhase::MaxPhases; ++i) {
+			total = std::max(total, (double)s.phaseStart[i] + s.phaseTime[i]);
+		}
+		WriteEvent("Substep", "X", s.startTime, total, s);
+		for (int i = 0; i < (int)PhysicsPhase::MaxPhases; ++i) {
+			if (s.phaseTime[i] > 0.0f) {
+				WriteEvent(GetPhaseName((PhysicsPhase)i), "X", s.startTime + s.phaseStart[i], s.phaseTime[i], s);
+			}
+		}
+		WriteEvent("Counters", "C", s.startTime, 0.0, s);
+	}
+	file << "\n]}\n";
+	return (bool)file;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+
+namespace NCL {
+	namespace CSC8503 {
+		enum class PhysicsPhase {
+			IntegrateAccel,
+			Broadphase,
+			Narrowphase,
+			Constraints,	//preparing the contacts, and every solver iteration
+			IntegrateVelocity,
+			Islands,		//waking and sleeping
+			MaxPhases
+		};
+
+		//Everything measured during a single physics substep
+		struct PhysicsStepStats {
+			int		step			= 0;	//the physics system's step count
+			int		substep			= 0;	//which substep of its Update this was
+			double	startTime		= 0.0;	//microseconds since the profiler was made
+			float	phaseStart[(int)PhysicsPhase::MaxPhases] = {};	//microseconds after startTime
+			float	phaseTime[(int)PhysicsPhase::MaxPhases]	 = {};	//microseconds
+
+			int		pairsTested		= 0;	//pairs handed to the narrowphase
+			int		contactsFound	= 0;	//contact points being solved
+			int		bodiesAwake		= 0;
+		};
+
+		/*
+		Keeps timings and counters for the last HistorySize physics substeps,
+		so that a slow frame can be looked into after the fact, without
+		having to run under a profiler.
+
+		The physics thread is the only thing that ever writes records, and it
+		never waits on anything to do so - every slot in the ring has its own
+		sequence number, which is odd while the slot is being written. Any
+		other thread can copy the records out whenever it likes, and just
+		throws away any it copied while they were being written over.
+		*/
+		class PhysicsProfiler {
+		public:
+			PhysicsProfiler();
+			~PhysicsProfiler() = default;
+
+			void SetEnabled(bool state)
+			{
+				enabled = state;
+			}
+
+			bool IsEnabled() const
+			{
+				return enabled;
+			}
+
+			//Called by the physics system - each phase runs until the next one starts
+			void BeginSubstep(int step, int substep);
+			void StartPhase(PhysicsPhase phase);
+			void EndSubstep(int pairsTested, int contactsFound, int bodiesAwake);
+
+			//How many substeps have been recorded in total, including ones that have since dropped out of the ring
+			uint64_t GetSubstepCount() const
+			{
+				return written.load(std::memory_order_acquire);
+			}
+
+			//Copies out up to maxCount of the most recent substeps, oldest first. Safe to call from any thread.
+			int CopyRecent(std::vector<PhysicsStepStats>& out, int maxCount = HistorySize) const;
+
+			//Writes out the recorded substeps as a trace that chrome://tracing or Perfetto can open
+			bool WriteChromeTrace(const std::string& filename) const;
+
+			static const char* GetPhaseName(PhysicsPhase phase);
+
+			static constexpr int HistorySize = 512;
+
+		protected:
+			double Now() const;
+
+			struct Slot {
+				std::atomic<uint64_t>	sequence;	//2n + 2 once record n is written, odd while writing
+				PhysicsStepStats		stats;
+			};
+			std::vector<Slot>		slots;
+			std::atomic<uint64_t>	written;
+
+			PhysicsStepStats	current;
+			int					currentPhase;
+			double				phaseStarted;
+			bool				enabled;
+
+			std::chrono::time_point<std::chrono::high_resolution_clock> startPoint;
+		};
+	}
+}
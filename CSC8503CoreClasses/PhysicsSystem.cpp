@@ -9,20 +9,34 @@
 #include "Debug.h"
 #include "Window.h"
 #include <functional>
+#include <numeric>
+#include <bit>
 using namespace NCL;
 using namespace CSC8503;
 
-PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g)	
+//This is the fixed timestep we'd LIKE to have
+const int   idealHZ = 120;
+const float idealDT = 1.0f / idealHZ;
+
+PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g), broadphaseQuadTree(Vector2(1024, 1024), 7, 6)	
 {
 	applyGravity	= false;
-	useBroadPhase	= false;	
+	useBroadPhase	= true;	
 	dTOffset		= 0.0f;
 	globalDamping	= 0.995f;
+	realHZ			= idealHZ;
+	realDT			= idealDT;
 	SetGravity(Vector3(0.0f, -9.8f, 0.0f));
+
+	for (int i = 0; i < StepHashHistory; ++i) {
+		stepHashSteps[i] = -1;
+	}
 }
 
 PhysicsSystem::~PhysicsSystem()	
 {
+	gameWorld.SetRaycastTree(nullptr);
+	delete workerPool;
 }
 
 void PhysicsSystem::SetGravity(const Vector3& g) 
@@ -42,7 +56,14 @@ any collisions they are in.
 */
 void PhysicsSystem::Clear() 
 {
-	allCollisions.clear();
+	gameWorld.SetRaycastTree(nullptr);
+	allCollisions.Clear();
+	broadphaseCollisionsVec.clear();
+	broadphaseTree.Clear();
+	broadphaseProxies.clear();
+	broadphaseQuadTree.Clear();
+	broadphaseSAP.Clear();
+	broadphaseSAPProxies.clear();
 }
 
 /*
@@ -51,40 +72,32 @@ This is the core of the physics engine update
 
 */
 
-bool useSimpleContainer = false;
-
 int constraintIterationCount = 10;
 
-//This is the fixed timestep we'd LIKE to have
-const int   idealHZ = 120;
-const float idealDT = 1.0f / idealHZ;
-
-/*
-This is the fixed update we actually have...
-If physics takes too long it starts to kill the framerate, it'll drop the 
-iteration count down until the FPS stabilises, even if that ends up
-being at a low rate. 
-*/
-int realHZ		= idealHZ;
-float realDT	= idealDT;
-
 void PhysicsSystem::Update(float dt) 
 {	
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::B)) {
-		useBroadPhase = !useBroadPhase;
-		std::cout << "Setting broadphase to " << useBroadPhase << std::endl;
-	}
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::N)) {
-		useSimpleContainer = !useSimpleContainer;
-		std::cout << "Setting broad container to " << useSimpleContainer << std::endl;
-	}
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::I)) {
-		constraintIterationCount--;
-		std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
-	}
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::O)) {
-		constraintIterationCount++;
-		std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
+	//There's no keyboard to poll when running as a dedicated server
+	if (const Keyboard* keyboard = Window::GetKeyboard()) {
+		if (keyboard->KeyPressed(KeyCodes::B)) {
+			useBroadPhase = !useBroadPhase;
+			std::cout << "Setting broadphase to " << useBroadPhase << std::endl;
+		}
+		if (keyboard->KeyPressed(KeyCodes::N)) {
+			broadphaseMethod = (BroadphaseMethod)(((int)broadphaseMethod + 1) % (int)BroadphaseMethod::MaxMethods);
+			std::cout << "Setting broad container to " << (int)broadphaseMethod << std::endl;
+		}
+		if (keyboard->KeyPressed(KeyCodes::M)) {
+			useParallelNarrowPhase = !useParallelNarrowPhase;
+			std::cout << "Setting parallel narrowphase to " << useParallelNarrowPhase << std::endl;
+		}
+		if (keyboard->KeyPressed(KeyCodes::I)) {
+			constraintIterationCount--;
+			std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
+		}
+		if (keyboard->KeyPressed(KeyCodes::O)) {
+			constraintIterationCount++;
+			std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
+		}
 	}
 
 	dTOffset += dt; //We accumulate time delta here - there might be remainders from previous frame!
@@ -95,34 +108,86 @@ void PhysicsSystem::Update(float dt)
 	if (useBroadPhase) {
 		UpdateObjectAABBs();
 	}
+	bodies.Gather(gameWorld);
+	GatherConstrainedBodies();
+
+	if (useParallelConstraints) {
+		ColourConstraints(); //constraints can't be added or removed during the physics update
+	}
+
+	//Deterministic mode never changes its step size
+	float stepDT = deterministic ? idealDT : realDT;
+
 	int iteratorCount = 0;
-	while(dTOffset > realDT) {
-		IntegrateAccel(realDT); //Update accelerations from external forces
+	while(dTOffset > stepDT) {
+		profiler.BeginSubstep(physicsStep, iteratorCount);
+		profiler.StartPhase(PhysicsPhase::IntegrateAccel);
+		IntegrateAccel(stepDT); //Update accelerations from external forces
 		if (useBroadPhase) {
-			BroadPhase();
+			profiler.StartPhase(PhysicsPhase::Broadphase);
+			BroadPhase(stepDT);
+			profiler.StartPhase(PhysicsPhase::Narrowphase);
 			NarrowPhase();
 		}
 		else {
+			profiler.StartPhase(PhysicsPhase::Narrowphase);
 			BasicCollisionDetection();
 		}
 
+		profiler.StartPhase(PhysicsPhase::Constraints);
+		PrepareContacts(stepDT);
+
+		//The constraints look at where their objects are through the Transforms
+		for (int body : constrainedBodies) {
+			bodies.StoreTransform(body);
+		}
+
 		//This is our simple iterative solver - 
 		//we just run things multiple times, slowly moving things forward
 		//and then rechecking that the constraints have been met		
-		float constraintDt = realDT /  (float)constraintIterationCount;
+		float constraintDt = stepDT /  (float)constraintIterationCount;
 		for (int i = 0; i < constraintIterationCount; ++i) {
 			UpdateConstraints(constraintDt);	
+			contactSolver.SolveVelocities(bodies);
 		}
-		IntegrateVelocity(realDT); //update positions from new velocity changes
+		profiler.StartPhase(PhysicsPhase::IntegrateVelocity);
+		IntegrateVelocity(stepDT); //update positions from new velocity changes
 
-		dTOffset -= realDT;
+		if (useSleeping) {
+			profiler.StartPhase(PhysicsPhase::Islands);
+			UpdateIslands(); //wake up or put to sleep anything that's settled down
+		}
+		if (profiler.IsEnabled()) {
+			profiler.EndSubstep(pairsTested, contactsFound, CountAwakeBodies());
+		}
+
+		dTOffset -= stepDT;
 		iteratorCount++;
+
+		if (deterministic) {
+			stepHashes[physicsStep % StepHashHistory]		= HashBodies();
+			stepHashSteps[physicsStep % StepHashHistory]	= physicsStep;
+		}
+		physicsStep++;
 	}
 
-	ClearForces();	//Once we've finished with the forces, reset them to zero
+	bodies.Scatter();	//Only now does everything get moved to where the physics ended up
+	ClearForces();		//Once we've finished with the forces, reset them to zero
+
+	//Bring the tree up to date with where everything ended up, for raycasts
+	if (useBroadPhase && broadphaseMethod == BroadphaseMethod::DynamicAABBTree) {
+		UpdateBroadphaseTree(stepDT);
+		gameWorld.SetRaycastTree(&broadphaseTree);
+	}
+	else {
+		gameWorld.SetRaycastTree(nullptr);
+	}
 
 	UpdateCollisionList(); //Remove any old collisions
 
+	if (deterministic) {
+		return;
+	}
 	t.Tick();
 	float updateTime = t.GetTimeDeltaSeconds();
 
@@ -147,12 +212,81 @@ void PhysicsSystem::Update(float dt)
 	}
 }
 
+static constexpr uint64_t FNVOffset	= 14695981039346656037ull;
+static constexpr uint64_t FNVPrime	= 1099511628211ull;
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * FNVPrime;
+	}
+	return hash;
+}
+
+/*
+Each object's state is hashed bit for bit with FNV-1a, so even the tiniest
+difference in a float shows up. The objects' hashes are then added
+together, rather than chained one after another, so that the answer
+doesn't depend on the order the world happens to be holding them in.
+*/
+static uint64_t HashBody(int id, const Vector3& position, const Quaternion& orientation, const Vector3& linear, const Vector3& angular) {
+	uint64_t hash = FNVOffset;
+	hash = HashBytes(hash, &id, sizeof(id));
+	hash = HashBytes(hash, &position, sizeof(position));
+	hash = HashBytes(hash, &orientation, sizeof(orientation));
+	hash = HashBytes(hash, &linear, sizeof(linear));
+	hash = HashBytes(hash, &angular, sizeof(angular));
+	return hash;
+}
+
+uint64_t PhysicsSystem::HashState() const 
+{
+	GameObjectIterator first;
+	GameObjectIterator last;
+	gameWorld.GetObjectIterators(first, last);
+
+	uint64_t total = 0;
+	for (auto i = first; i != last; ++i) {
+		const PhysicsObject* physics = (*i)->GetPhysicsObject();
+		if (!physics) {
+			continue;
+		}
+		const Transform& transform = (*i)->GetTransform();
+		total += HashBody((*i)->GetWorldID(), transform.GetPosition(), transform.GetOrientation(),
+			physics->GetLinearVelocity(), physics->GetAngularVelocity());
+	}
+	return total;
+}
+
+//The same hash, taken from the body store partway through an update
+uint64_t PhysicsSystem::HashBodies() const 
+{
+	uint64_t total = 0;
+	for (int i = 0; i < bodies.GetBodyCount(); ++i) {
+		total += HashBody(bodies.GetObject(i)->GetWorldID(), bodies.GetPosition(i), bodies.GetOrientation(i),
+			bodies.GetLinearVelocity(i), bodies.GetAngularVelocity(i));
+	}
+	return total;
+}
+
+bool PhysicsSystem::GetStepHash(int step, uint64_t& hash) const 
+{
+	if (step < 0 || stepHashSteps[step % StepHashHistory] != step) {
+		return false;
+	}
+	hash = stepHashes[step % StepHashHistory];
+	return true;
+}
+
 /*
 Later on we're going to need to keep track of collisions
-across multiple frames, so we store them in a set.
+across multiple frames, so we store them in a pair cache, keyed
+on the world IDs of the two objects. Every time a pair is found
+colliding, its entry is stamped with the current frame.
 
 The first time they are added, we tell the objects they are colliding.
-The frame they are to be removed, we tell them they're no longer colliding.
+Once they haven't been seen colliding for numCollisionFrames, we tell 
+them they're no longer colliding, and remove them from the cache.
 
 From this simple mechanism, we we build up gameplay interactions inside the
 OnCollisionBegin / OnCollisionEnd functions (removing health when hit by a 
@@ -160,24 +294,17 @@ rocket launcher, gaining a point when the player hits the gold coin, and so on).
 */
 void PhysicsSystem::UpdateCollisionList() 
 {
-	for (std::set<CollisionDetection::CollisionInfo>::iterator i = allCollisions.begin(); i != allCollisions.end(); ) {
-		if ((*i).framesLeft == numCollisionFrames) {
-			i->a->OnCollisionBegin(i->b);
-			i->b->OnCollisionBegin(i->a);
-		}
-
-		CollisionDetection::CollisionInfo& in = const_cast<CollisionDetection::CollisionInfo&>(*i);
-		in.framesLeft--;
-
-		if ((*i).framesLeft < 0) {
-			i->a->OnCollisionEnd(i->b);
-			i->b->OnCollisionEnd(i->a);
-			i = allCollisions.erase(i);
+	allCollisions.UpdateEvents(collisionFrame, numCollisionFrames,
+		[](const CollisionDetection::CollisionInfo& info) {
+			info.a->OnCollisionBegin(info.b);
+			info.b->OnCollisionBegin(info.a);
+		},
+		[](const CollisionDetection::CollisionInfo& info) {
+			info.a->OnCollisionEnd(info.b);
+			info.b->OnCollisionEnd(info.a);
 		}
-		else {
-			++i;
-		}
-	}
+	);
+	collisionFrame++;
 }
 
 void PhysicsSystem::UpdateObjectAABBs() 
@@ -194,101 +321,194 @@ void PhysicsSystem::UpdateObjectAABBs()
 This is how we'll be doing collision detection in tutorial 4.
 We step thorugh every pair of objects once (the inner for loop offset 
 ensures this), and determine whether they collide, and if so, add them
-to the collision set for later processing. The set will guarantee that
+to the collision cache for later processing. The cache will guarantee that
 a particular pair will only be added once, so objects colliding for
-multiple frames won't flood the set with duplicates.
+multiple frames won't flood it with duplicates.
 */
 void PhysicsSystem::BasicCollisionDetection() {
-	std::vector<GameObject*>::const_iterator first;
-	std::vector<GameObject*>::const_iterator last;
-	gameWorld.GetObjectIterators(first, last);
+	pairsTested = 0;
 
-	for (auto i = first; i != last; ++i) {
-		if ((*i)->GetPhysicsObject() == nullptr) {
-			continue;
-		}
-		for (auto j = i + 1; j != last; ++j) {
-			if ((*j)->GetPhysicsObject() == nullptr) {
+	for (int i = 0; i < bodies.GetBodyCount(); ++i) {
+		GameObject* a				= bodies.GetObject(i);
+		const CollisionVolume* volA = a->GetBoundingVolume();
+		Transform transformA		= bodies.GetTransform(i);
+
+		for (int j = i + 1; j < bodies.GetBodyCount(); ++j) {
+			GameObject* b				= bodies.GetObject(j);
+			const CollisionVolume* volB = b->GetBoundingVolume();
+
+			CollisionDetection::CollisionInfo info;
+			info.a = a;
+			info.b = b;
+			WarmStartNarrowPhase(info);
+			pairsTested++;
+			if (!volA || !volB) {
 				continue;
 			}
-			CollisionDetection::CollisionInfo info;
-			if (CollisionDetection::ObjectIntersection(*i, *j, info)) {
-				ImpulseResolveCollision(*info.a, *info.b, info.point);
-				info.framesLeft = numCollisionFrames;
-				allCollisions.insert(info);
+			CollisionDetection::IntersectionFunction test = 
+				CollisionDetection::GetIntersectionFunction(CollisionDetection::PairTypeIndex(volA->type, volB->type));
+			if (test(*volA, transformA, *volB, bodies.GetTransform(j), info)) {
+				AddContact(info);
 			}
-
 		}
 	}
 }
 
-
 /*
-
-In tutorial 5, we start determining the correct response to a collision,
-so that objects separate back out. 
-
+The objects' Transforms aren't updated until the end of the physics update,
+so the manifold is handed where the physics has the two objects now.
 */
-void PhysicsSystem::ImpulseResolveCollision(
-	GameObject& a, GameObject& b,
-	CollisionDetection::ContactPoint& p) const {
+void PhysicsSystem::AddContact(const CollisionDetection::CollisionInfo& info) 
+{
+	ContactManifold& m = allCollisions.Insert(info, collisionFrame);
+	m.AddContact(info, physicsStep, bodies.GetTransform(bodies.GetBody(m.a)), bodies.GetTransform(bodies.GetBody(m.b)));
+}
 
-	PhysicsObject* physA = a.GetPhysicsObject();
-	PhysicsObject* physB = b.GetPhysicsObject();
 
-	Transform& transformA = a.GetTransform();
-	Transform& transformB = b.GetTransform();
+/*
 
-	float totalMass = physA->GetInverseMass() + physB->GetInverseMass();
+Collision detection no longer changes the objects' velocities directly.
+Instead, every contact found this substep is added to its pair's manifold,
+and the ContactSolver then works on every manifold that was touched this
+substep, alongside the other constraints. The manifolds for pairs that
+weren't found colliding this time are left alone, so that their impulses
+are still there to warm start from if the pair touches again.
 
-	if (totalMass == 0) {
-		return; // two static objects??
-	}
+*/
+void PhysicsSystem::PrepareContacts(float dt) 
+{
+	contactSolver.Clear();
+	contactsFound = 0;
+	allCollisions.OperateOnManifolds(
+		[&](ContactManifold& m) {
+			if (m.lastStep != physicsStep || m.pointCount == 0) {
+				return;
+			}
+			int bodyA = bodies.GetBody(m.a);
+			int bodyB = bodies.GetBody(m.b);
+			if (!(IsResting(bodyA) && IsResting(bodyB))) {
+				contactSolver.AddManifold(&m, bodyA, bodyB);
+				contactsFound += m.pointCount;
+			}
+		}
+	);
+	contactSolver.Prepare(bodies, dt);
+}
 
-	// Separate them out using projection
-	transformA.SetPosition(transformA.GetPosition() -
-		(p.normal * p.penetration * (physA->GetInverseMass() / totalMass)));
+int PhysicsSystem::CountAwakeBodies() const 
+{
+	int awake = 0;
+	for (int i = 0; i < bodies.GetBodyCount(); ++i) {
+		if (!IsResting(i)) {
+			awake++;
+		}
+	}
+	return awake;
+}
 
-	transformB.SetPosition(transformB.GetPosition() +
-		(p.normal * p.penetration * (physB->GetInverseMass() / totalMass)));
+//Static and sleeping objects won't move unless something else moves them
+bool PhysicsSystem::IsResting(int body) const 
+{
+	return bodies.GetInverseMass(body) == 0.0f || bodies.IsAsleep(body);
+}
 
-	Vector3 relativeA = p.localA;
-	Vector3 relativeB = p.localB;
+/*
 
-	Vector3 angVelocityA =
-		Vector::Cross(physA->GetAngularVelocity(), relativeA);
-	Vector3 angVelocityB =
-		Vector::Cross(physB->GetAngularVelocity(), relativeB);
+Objects that are touching each other (or are joined by a constraint) form
+an island - anything that happens to one object in the island might affect
+all of the others, so they have to sleep and wake together. The islands
+are found using a union-find over the contacts found this substep, with
+static objects left out, so that everything resting on the floor doesn't
+end up as one big island.
 
-	Vector3 fullVelocityA = physA->GetLinearVelocity() + angVelocityA;
-	Vector3 fullVelocityB = physB->GetLinearVelocity() + angVelocityB;
+If any object in an island is awake, the whole island is woken up - this
+is how a sleeping pile of boxes gets knocked over. If every object in the
+island has been moving slowly for long enough, the whole island goes to
+sleep, and is skipped by integration, broadphase updates and the solver.
 
-	Vector3 contactVelocity = fullVelocityB - fullVelocityA;
+*/
+void PhysicsSystem::UpdateIslands() 
+{
+	int bodyCount = bodies.GetBodyCount();
+	islandParents.resize(bodyCount);
+	islandInfo.resize(bodyCount);
 
-	float impulseForce = Vector::Dot(contactVelocity, p.normal);
+	for (int i = 0; i < bodyCount; ++i) {
+		islandParents[i]	= i;
+		islandInfo[i]		= IslandInfo();
+	}
 
-	// now to work out the effect of inertia ....
-	Vector3 inertiaA = Vector::Cross(physA->GetInertiaTensor() *
-		Vector::Cross(relativeA, p.normal), relativeA);
-	Vector3 inertiaB = Vector::Cross(physB->GetInertiaTensor() *
-		Vector::Cross(relativeB, p.normal), relativeB);
-	float angularEffect = Vector::Dot(inertiaA + inertiaB, p.normal);
+	auto FindIsland = [&](int body) {
+		while (islandParents[body] != body) {
+			islandParents[body] = islandParents[islandParents[body]];
+			body = islandParents[body];
+		}
+		return body;
+	};
+	auto JoinIslands = [&](int a, int b) {
+		if (bodies.GetInverseMass(a) == 0.0f || bodies.GetInverseMass(b) == 0.0f) {
+			return;
+		}
+		islandParents[FindIsland(a)] = FindIsland(b);
+	};
 
-	float cRestitution = 0.66f; // disperse some kinectic energy
+	allCollisions.OperateOnManifolds(
+		[&](ContactManifold& m) {
+			if (m.lastStep == physicsStep && m.pointCount > 0) {
+				JoinIslands(bodies.GetBody(m.a), bodies.GetBody(m.b));
+			}
+		}
+	);
 
-	float j = (-(1.0f + cRestitution) * impulseForce) /
-		(totalMass + angularEffect);
+	std::vector<Constraint*>::const_iterator firstConstraint;
+	std::vector<Constraint*>::const_iterator lastConstraint;
+	gameWorld.GetConstraintIterators(firstConstraint, lastConstraint);
 
-	Vector3 fullImpulse = p.normal * j;
+	for (auto i = firstConstraint; i != lastConstraint; ++i) {
+		GameObject* a = (*i)->GetObjectA();
+		GameObject* b = (*i)->GetObjectB();
+		if (!a || !b) {
+			continue;
+		}
+		int bodyA = bodies.GetBody(a);
+		int bodyB = bodies.GetBody(b);
+		if (bodyA >= 0 && bodyB >= 0) {
+			JoinIslands(bodyA, bodyB);
+		}
+	}
 
-	physA->ApplyLinearImpulse(-fullImpulse);
-	physB->ApplyLinearImpulse(fullImpulse);
+	//Gather up what state each island is in...
+	for (int i = 0; i < bodyCount; ++i) {
+		if (bodies.GetInverseMass(i) == 0.0f) {
+			continue;
+		}
+		IslandInfo& island = islandInfo[FindIsland(i)];
+		if (bodies.IsAsleep(i)) {
+			island.hasSleeper = true;
+		}
+		else {
+			island.hasAwake		= true;
+			island.minSleepTime = std::min(island.minSleepTime, bodies.GetSleepTimer(i));
+		}
+	}
 
-	physA->ApplyAngularImpulse(Vector::Cross(relativeA, -fullImpulse));
-	physB->ApplyAngularImpulse(Vector::Cross(relativeB, fullImpulse));
+	//...and then wake up, or put to sleep, every object in it
+	for (int i = 0; i < bodyCount; ++i) {
+		if (bodies.GetInverseMass(i) == 0.0f) {
+			continue;
+		}
+		const IslandInfo& island = islandInfo[FindIsland(i)];
+		if (island.hasAwake && island.hasSleeper) {
+			if (bodies.IsAsleep(i)) {
+				bodies.Wake(i);
+			}
+		}
+		else if (island.hasAwake && island.minSleepTime >= timeToSleep) {
+			bodies.Sleep(i);
+		}
+	}
 }
 
-
 /*
 
 Later, we replace the BasicCollisionDetection method with a broadphase
@@ -296,121 +516,422 @@ and a narrowphase collision detection method. In the broad phase, we
 split the world up using an acceleration structure, so that we can only
 compare the collisions that we absolutely need to. 
 
+There's more than one structure we can use for this, selected by the
+broadphaseMethod (the N key cycles through them), so they can be compared
+against each other, and against the all-pairs test (the B key). Either way,
+the likely pairs end up in the broadphaseCollisionsVec.
+
 */
-void PhysicsSystem::BroadPhase() 
+void PhysicsSystem::BroadPhase(float dt) 
 {
+	broadphaseCollisionsVec.clear();
 
+	switch (broadphaseMethod) {
+		case BroadphaseMethod::DynamicAABBTree:	BroadPhaseAABBTree(dt);	break;
+		case BroadphaseMethod::LooseQuadTree:	BroadPhaseQuadTree();	break;
+		case BroadphaseMethod::SweepAndPrune:	BroadPhaseSweepAndPrune();	break;
+		default: break;
+	}
 }
 
 /*
-
-The broadphase will now only give us likely collisions, so we can now go through them,
-and work out if they are truly colliding, and if so, add them into the main collision list
+Pairs of static or sleeping objects are skipped entirely, as there's
+nothing the narrowphase could do with them. The pair is stored in world ID
+order, so that the same two objects always make the same CollisionInfo.
 */
-void PhysicsSystem::NarrowPhase() 
+void PhysicsSystem::AddBroadphasePair(GameObject* a, GameObject* b) 
 {
-
+	int bodyA = bodies.GetBody(a);
+	int bodyB = bodies.GetBody(b);
+	if (bodyA < 0 || bodyB < 0) {
+		return;
+	}
+	if (IsResting(bodyA) && IsResting(bodyB)) {
+		return;
+	}
+	CollisionDetection::CollisionInfo info;
+	info.a = a->GetWorldID() < b->GetWorldID() ? a : b;
+	info.b = a->GetWorldID() < b->GetWorldID() ? b : a;
+	broadphaseCollisionsVec.emplace_back(info);
 }
 
 /*
-Integration of acceleration and velocity is split up, so that we can
-move objects multiple times during the course of a PhysicsUpdate,
-without worrying about repeated forces accumulating etc. 
-
-This function will update both linear and angular acceleration,
-based on any forces that have been accumulated in the objects during
-the course of the previous game frame.
+The dynamic AABB tree persists across frames. Each object keeps a slightly
+enlarged 'fat' box in the tree, and only gets reinserted once it moves 
+outside of it, so for the majority of objects (which are either static or
+barely moving) this is just a box containment test. Moving objects get
+their box stretched by how far they'll go in a step of dt.
+
+Objects without a PhysicsObject still go in the tree, so that raycasts
+can find them, but are left out of the pairs.
 */
-void PhysicsSystem::IntegrateAccel(float dt) {
+void PhysicsSystem::UpdateBroadphaseTree(float dt) 
+{
+	broadphaseStamp++;
 
 	std::vector<GameObject*>::const_iterator first;
 	std::vector<GameObject*>::const_iterator last;
 	gameWorld.GetObjectIterators(first, last);
 
+	int touched = 0;
 	for (auto i = first; i != last; ++i) {
-		PhysicsObject* object = (*i)->GetPhysicsObject();
-		if (object == nullptr) {
-			continue; // No physics object for this GameObject!
+		Vector3 halfSizes;
+		if (!(*i)->GetBroadphaseAABB(halfSizes)) {
+			continue;
 		}
+		int worldID = (*i)->GetWorldID();
+		if (worldID >= (int)broadphaseProxies.size()) {
+			broadphaseProxies.resize(worldID + 1, AABBTree::NullNode);
+		}
+		int& proxy		 = broadphaseProxies[worldID];
+		int body		 = bodies.GetBody(*i);
+		Vector3 position = body < 0 ? (*i)->GetTransform().GetPosition() : bodies.GetPosition(body);
 
-		float inverseMass = object->GetInverseMass();
+		if (broadphaseTree.GetObject(proxy) != *i) {
+			proxy = broadphaseTree.Insert(*i, position, halfSizes);
+		}
+		else if (body < 0) {
+			broadphaseTree.Update(proxy, position, halfSizes);
+		}
+		else if (!bodies.IsAsleep(body)) {
+			broadphaseTree.Update(proxy, position, halfSizes, bodies.GetLinearVelocity(body) * dt);
+		}
+		broadphaseTree.Touch(proxy, broadphaseStamp);
+		touched++;
+	}
+	//Objects have been removed from the world since last time
+	if (touched != broadphaseTree.GetLeafCount()) {
+		broadphaseTree.RemoveUntouched(broadphaseStamp);
+	}
+}
 
-		Vector3 linearVel = object->GetLinearVelocity();
-		Vector3 force = object->GetForce();
-		Vector3 accel = force * inverseMass;
+void PhysicsSystem::BroadPhaseAABBTree(float dt) 
+{
+	UpdateBroadphaseTree(dt);
 
-		if (applyGravity && inverseMass > 0) {
-			accel += gravity; // dont move infinitely heavy things
+	broadphaseTree.QueryOverlappingPairs(
+		[&](GameObject* a, GameObject* b) {
+			AddBroadphasePair(a, b);
 		}
+	);
+}
+
+/*
+The loose quadtree is cheap enough to build that we just rebuild it from
+scratch every time. It keeps its node pool between frames, so after the
+first few frames this doesn't need to allocate anything.
+*/
+void PhysicsSystem::BroadPhaseQuadTree() 
+{
+	broadphaseQuadTree.Clear();
 
-		linearVel += accel * dt; // integrate accel!
-		object->SetLinearVelocity(linearVel);
+	for (int i = 0; i < bodies.GetBodyCount(); ++i) {
+		GameObject* object = bodies.GetObject(i);
+		Vector3 halfSizes;
+		if (!object->GetBroadphaseAABB(halfSizes)) {
+			continue;
+		}
+		broadphaseQuadTree.Insert(object, bodies.GetPosition(i), halfSizes);
+	}
 
-		Vector3 torque = object->GetTorque();
-		Vector3 angVel = object->GetAngularVelocity();
+	broadphaseQuadTree.OperateOnPairs(
+		[&](const QuadTreeEntry<GameObject*>& a, const QuadTreeEntry<GameObject*>& b) {
+			AddBroadphasePair(a.object, b.object);
+		}
+	);
+}
 
-		object->UpdateInertiaTensor(); // update tensor vs orientation
+/*
+Sweep and prune keeps its endpoint lists sorted from one substep to the
+next, so it only needs to be told where everything is now, and then it
+can shuffle the lists back into order and sweep them for pairs.
+*/
+void PhysicsSystem::BroadPhaseSweepAndPrune() 
+{
+	broadphaseStamp++;
 
-		Vector3 angAccel = object->GetInertiaTensor() * torque;
+	int touched = 0;
+	for (int i = 0; i < bodies.GetBodyCount(); ++i) {
+		GameObject* object = bodies.GetObject(i);
+		Vector3 halfSizes;
+		if (!object->GetBroadphaseAABB(halfSizes)) {
+			continue;
+		}
+		int worldID = object->GetWorldID();
+		if (worldID >= (int)broadphaseSAPProxies.size()) {
+			broadphaseSAPProxies.resize(worldID + 1, -1);
+		}
+		int& proxy		 = broadphaseSAPProxies[worldID];
+		Vector3 position = bodies.GetPosition(i);
 
-		angVel += angAccel * dt; // integrate angular accel!
-		object->SetAngularVelocity(angVel);
+		if (broadphaseSAP.GetObject(proxy) != object) {
+			proxy = broadphaseSAP.Insert(object, position, halfSizes);
+		}
+		else if (!bodies.IsAsleep(i)) {
+			broadphaseSAP.Update(proxy, position, halfSizes);
+		}
+		broadphaseSAP.Touch(proxy, broadphaseStamp);
+		touched++;
 	}
-}
+	if (touched != broadphaseSAP.GetProxyCount()) {
+		broadphaseSAP.RemoveUntouched(broadphaseStamp);
+	}
+	broadphaseSAP.Sort();
 
+	broadphaseSAP.QueryOverlappingPairs(
+		[&](GameObject* a, GameObject* b) {
+			AddBroadphasePair(a, b);
+		}
+	);
+}
 
 /*
-This function integrates linear and angular velocity into
-position and orientation. It may be called multiple times
-throughout a physics update, to slowly move the objects through
-the world, looking for collisions.
+
+The broadphase will now only give us likely collisions, so we can now go through them,
+and work out if they are truly colliding, and if so, add them into the main collision list.
+
+Rather than working out which intersection test to use for every pair, the pairs
+are first grouped by the types of their volumes, so each test gets run over a
+whole batch of pairs in one go. The results are still added to the collision
+list in the order the broadphase produced the pairs in, though.
 */
-void PhysicsSystem::IntegrateVelocity(float dt) {
+void PhysicsSystem::NarrowPhase() 
+{
+	SortNarrowphasePairs();
+	pairsTested = (int)narrowphaseOrder.size();
 
-	std::vector<GameObject*>::const_iterator first;
-	std::vector<GameObject*>::const_iterator last;
-	gameWorld.GetObjectIterators(first, last);
+	if (useParallelNarrowPhase) {
+		ParallelNarrowPhase();
+	}
+	else {
+		NarrowPhaseRange(0, (int)narrowphaseOrder.size());
+	}
 
-	float frameLinearDamping = 1.0f - (0.4f * dt);
+	for (int i = 0; i < (int)broadphaseCollisionsVec.size(); ++i) {
+		if (narrowphaseHits[i]) {
+			AddContact(narrowphaseResults[i]);
+		}
+	}
+}
 
-	for (auto i = first; i != last; ++i) {
-		PhysicsObject* object = (*i)->GetPhysicsObject();
-		if (object == nullptr) {
+/*
+A counting sort, as there's only a small, fixed number of pair types. It's
+stable, so pairs within a batch stay in the order the broadphase gave them.
+Pairs where either object has no volume can't collide, so are left out.
+*/
+void PhysicsSystem::SortNarrowphasePairs() 
+{
+	int pairCount = (int)broadphaseCollisionsVec.size();
+
+	narrowphaseTypes.resize(pairCount);
+	narrowphaseResults.resize(pairCount);
+	narrowphaseHits.assign(pairCount, 0);
+	narrowphaseTypeStart.assign(CollisionDetection::PairTypeCount + 1, 0);
+
+	for (int i = 0; i < pairCount; ++i) {
+		const CollisionVolume* volA = broadphaseCollisionsVec[i].a->GetBoundingVolume();
+		const CollisionVolume* volB = broadphaseCollisionsVec[i].b->GetBoundingVolume();
+		if (!volA || !volB) {
+			narrowphaseTypes[i] = -1;
 			continue;
 		}
+		int pairType = CollisionDetection::PairTypeIndex(volA->type, volB->type);
+		narrowphaseTypes[i] = pairType;
+		narrowphaseTypeStart[pairType + 1]++;
+	}
+	for (int t = 0; t < CollisionDetection::PairTypeCount; ++t) {
+		narrowphaseTypeStart[t + 1] += narrowphaseTypeStart[t];
+	}
 
-		Transform& transform = (*i)->GetTransform();
+	narrowphaseOrder.resize(narrowphaseTypeStart[CollisionDetection::PairTypeCount]);
+	for (int i = 0; i < pairCount; ++i) {
+		if (narrowphaseTypes[i] >= 0) {
+			narrowphaseOrder[narrowphaseTypeStart[narrowphaseTypes[i]]++] = i;
+		}
+	}
+}
 
-		// Position Stuff
-		Vector3 position = transform.GetPosition();
-		Vector3 linearVel = object->GetLinearVelocity();
-		position += linearVel * dt;
-		transform.SetPosition(position);
+/*
+Runs the intersection tests for a range of the sorted pairs, storing each
+result against the pair's place in the broadphase list. The test is only
+looked up again when the range crosses into the next batch.
+*/
+void PhysicsSystem::NarrowPhaseRange(int begin, int end) 
+{
+	int currentType = -1;
+	CollisionDetection::IntersectionFunction test = nullptr;
+
+	for (int k = begin; k < end; ++k) {
+		int i = narrowphaseOrder[k];
+		if (narrowphaseTypes[i] != currentType) {
+			currentType = narrowphaseTypes[i];
+			test		= CollisionDetection::GetIntersectionFunction(currentType);
+		}
+		CollisionDetection::CollisionInfo& info = narrowphaseResults[i];
+		info = broadphaseCollisionsVec[i];
+		WarmStartNarrowPhase(info);
+
+		GameObject* a = info.a;
+		GameObject* b = info.b;
+		narrowphaseHits[i] = test(*a->GetBoundingVolume(), bodies.GetTransform(bodies.GetBody(a)),
+								  *b->GetBoundingVolume(), bodies.GetTransform(bodies.GetBody(b)), info);
+	}
+}
 
-		// Linear Damping
-		linearVel = linearVel * frameLinearDamping;
-		object->SetLinearVelocity(linearVel);
+/*
+The intersection tests themselves don't change anything, so they can be
+split up across the worker pool. Each job gets its own contiguous run of
+the sorted pairs - mostly just one or two batches - and every pair's
+result has its own slot to be written into, so no job gets in the way of
+another, and the collision list ends up exactly the same no matter which
+thread finished first.
+*/
+void PhysicsSystem::ParallelNarrowPhase() 
+{
+	GetWorkerPool().ParallelFor((int)narrowphaseOrder.size(), 64,
+		[&](int begin, int end, int jobIndex) {
+			NarrowPhaseRange(begin, end);
+		}
+	);
+}
+
+/*
+A game that never turns on either parallel mode shouldn't have a thread
+per core sat around waiting for work, so the pool isn't started until the
+first time something is split across it.
+*/
+ThreadPool& PhysicsSystem::GetWorkerPool() 
+{
+	if (!workerPool) {
+		workerPool = new ThreadPool();
+	}
+	return *workerPool;
+}
+
+/*
+Pairs involving a convex hull go through GJK, which can pick up from the
+simplex it finished with for the same pair last time, if they were
+touching then. The collision list is only read from here, so it's safe
+for the parallel narrowphase jobs to all do this at once.
+*/
+void PhysicsSystem::WarmStartNarrowPhase(CollisionDetection::CollisionInfo& info) 
+{
+	const CollisionVolume* volA = info.a->GetBoundingVolume();
+	const CollisionVolume* volB = info.b->GetBoundingVolume();
+	if (!volA || !volB || !(((int)volA->type | (int)volB->type) & (int)VolumeType::ConvexHull)) {
+		return;
+	}
+	if (const CollisionDetection::CollisionInfo* previous = allCollisions.Find(info.a, info.b)) {
+		info.WarmStartFrom(*previous);
+	}
+}
+
+/*
+Integration of acceleration and velocity is split up, so that we can
+move objects multiple times during the course of a PhysicsUpdate,
+without worrying about repeated forces accumulating etc. 
 
-		// Orientation Stuff
-		Quaternion orientation = transform.GetOrientation();
-		Vector3 angVel = object->GetAngularVelocity();
+This function will update both linear and angular acceleration,
+based on any forces that have been accumulated in the objects during
+the course of the previous game frame.
+*/
+void PhysicsSystem::IntegrateAccel(float dt) {
+	bodies.IntegrateAccel(applyGravity ? gravity : Vector3(), dt);
+}
 
-		orientation = orientation +
-			(Quaternion(angVel * dt * 0.5f, 0.0f) * orientation);
-		orientation.Normalise();
 
-		transform.SetOrientation(orientation);
+/*
+This function integrates linear and angular velocity into
+position and orientation. It may be called multiple times
+throughout a physics update, to slowly move the objects through
+the world, looking for collisions.
+*/
+void PhysicsSystem::IntegrateVelocity(float dt) {
+	float frameLinearDamping	= 1.0f - (0.4f * dt);
+	float frameAngularDamping	= 1.0f - (0.4f * dt);
 
-		// Damp the angular velocity too
-		float frameAngularDamping = 1.0f - (0.4f * dt);
-		angVel = angVel * frameAngularDamping;
-		object->SetAngularVelocity(angVel);
+	bodies.IntegrateVelocity(frameLinearDamping, frameAngularDamping, dt);
+	if (useContinuousCollision) {
+		ContinuousCollision();
+	}
+	//The solver needs the inertia tensors to match the new orientations
+	bodies.UpdateInertiaTensors();
 
+	//Only count an object as still once the solver has had its say
+	if (useSleeping) {
+		bodies.UpdateSleepTimers(dt, linearSleepTolerance, angularSleepTolerance);
 	}
 }
 
 
 
+/*
+If an object moves further than its own size in a single substep, it can
+end up past a thin wall without ever being seen overlapping it. Objects
+flagged for continuous collision have their motion this substep swept
+against any boxes in the way, and are stopped just inside the first one
+they would hit. The narrowphase then finds the contact as normal next
+substep, and the solver stops them going any further.
+
+This runs after the new positions have been worked out, and the sweeps
+start from where everything was before they moved, which the body store
+keeps hold of for just this.
+*/
+void PhysicsSystem::ContinuousCollision() 
+{
+	for (int i = 0; i < bodies.GetBodyCount(); ++i) {
+		GameObject* object				= bodies.GetObject(i);
+		PhysicsObject* physics			= object->GetPhysicsObject();
+		const CollisionVolume* volume	= object->GetBoundingVolume();
+
+		if (!physics->UsesContinuousCollision() || bodies.IsAsleep(i) || !volume) {
+			continue;
+		}
+		Vector3 halfSize;
+		if (!object->GetBroadphaseAABB(halfSize)) {
+			continue;
+		}
+		Transform startTransform = bodies.GetStartTransform(i);
+		Vector3 start	= startTransform.GetPosition();
+		Vector3 motion	= bodies.GetPosition(i) - start;
+		float distance	= Vector::Length(motion);
+
+		//Anything moving less than its smallest half size will be caught by the narrowphase
+		if (distance < std::min(halfSize.x, std::min(halfSize.y, halfSize.z))) {
+			continue;
+		}
+		float firstHit = 1.0f;
+		auto SweepAgainst = [&](GameObject* other) {
+			const CollisionVolume* otherVolume	= other->GetBoundingVolume();
+			int otherBody						= bodies.GetBody(other);
+			if (other == object || !otherVolume || otherBody < 0) {
+				return;
+			}
+			float hit;
+			if (CollisionDetection::SweptIntersection(*volume, startTransform, motion, *otherVolume, bodies.GetStartTransform(otherBody), hit)) {
+				firstHit = std::min(firstHit, hit);
+			}
+		};
+
+		if (useBroadPhase && broadphaseMethod == BroadphaseMethod::DynamicAABBTree) {
+			Vector3 end = start + motion;
+			broadphaseTree.Query(Vector::Min(start, end) - halfSize, Vector::Max(start, end) + halfSize,
+				[&](int proxy, GameObject* other) {
+					SweepAgainst(other);
+				}
+			);
+		}
+		else {
+			gameWorld.OperateOnContents(SweepAgainst);
+		}
+
+		if (firstHit < 1.0f) {
+			float allowed = std::min(distance, firstHit * distance + sweepPenetration);
+			bodies.SetPosition(i, start + motion * (allowed / distance));
+		}
+	}
+}
+
 /*
 Once we're finished with a physics update, we have to
 clear out any accumulated forces, ready to receive new
@@ -420,7 +941,9 @@ void PhysicsSystem::ClearForces()
 {
 	gameWorld.OperateOnContents(
 		[](GameObject* o) {
-			o->GetPhysicsObject()->ClearForces();
+			if (o->GetPhysicsObject()) {
+				o->GetPhysicsObject()->ClearForces();
+			}
 		}
 	);
 }
@@ -435,11 +958,149 @@ us to model springs and ropes etc.
 */
 void PhysicsSystem::UpdateConstraints(float dt) 
 {
+	for (int body : constrainedBodies) {
+		bodies.StoreVelocities(body);
+	}
+	if (useParallelConstraints) {
+		int colourCount = GetConstraintColourCount();
+		for (int c = 0; c < colourCount; ++c) {
+			int start = constraintColourStart[c];
+			int count = constraintColourStart[c + 1] - start;
+			if (c == MaxConstraintColours) { //the leftovers might share objects
+				for (int i = start; i < start + count; ++i) {
+					constraintOrder[i]->UpdateConstraint(dt);
+				}
+				continue;
+			}
+			GetWorkerPool().ParallelFor(count, 32,
+				[&](int begin, int end, int jobIndex) {
+					for (int i = start + begin; i < start + end; ++i) {
+						constraintOrder[i]->UpdateConstraint(dt);
+					}
+				}
+			);
+		}
+	}
+	else {
+		std::vector<Constraint*>::const_iterator first;
+		std::vector<Constraint*>::const_iterator last;
+		gameWorld.GetConstraintIterators(first, last);
+
+		for (auto i = first; i != last; ++i) {
+			(*i)->UpdateConstraint(dt);
+		}
+	}
+	for (int body : constrainedBodies) {
+		bodies.LoadVelocities(body);
+	}
+}
+
+/*
+The constraints are written against PhysicsObjects rather than the body
+store, so whichever objects they're attached to get handed over to them
+around each UpdateConstraints. That's usually only a handful of objects,
+so they're found once, at the start of the update. A constraint that
+doesn't say which objects it joins could be touching anything, so then
+every object has to be handed over.
+*/
+void PhysicsSystem::GatherConstrainedBodies() 
+{
+	constrainedBodies.clear();
+
 	std::vector<Constraint*>::const_iterator first;
 	std::vector<Constraint*>::const_iterator last;
 	gameWorld.GetConstraintIterators(first, last);
 
 	for (auto i = first; i != last; ++i) {
-		(*i)->UpdateConstraint(dt);
+		GameObject* a = (*i)->GetObjectA();
+		GameObject* b = (*i)->GetObjectB();
+		if (!a || !b) {
+			constrainedBodies.resize(bodies.GetBodyCount());
+			std::iota(constrainedBodies.begin(), constrainedBodies.end(), 0);
+			return;
+		}
+		for (GameObject* o : { a, b }) {
+			int body = bodies.GetBody(o);
+			if (body >= 0) {
+				constrainedBodies.emplace_back(body);
+			}
+		}
+	}
+	std::sort(constrainedBodies.begin(), constrainedBodies.end());
+	constrainedBodies.erase(std::unique(constrainedBodies.begin(), constrainedBodies.end()), constrainedBodies.end());
+}
+
+/*
+Two constraints can only be solved at the same time if they don't touch
+any of the same objects, otherwise they'd both be changing the same
+velocities at once. So the constraints are 'coloured' like a graph, where
+constraints sharing an object can't be the same colour - each colour can
+then be solved in parallel, one colour after another.
+
+This is done greedily - each constraint gets the lowest colour that none of
+its objects' other constraints have yet, which each object tracks as a
+bitmask. A rope or chain only ever needs two colours this way, alternating
+links. Static objects are counted too, as solving still writes to them,
+even if it's only to add nothing to their velocity. A constraint that
+doesn't say which objects it joins (or that's run out of colours) goes in
+one last batch, which is solved serially.
+*/
+void PhysicsSystem::ColourConstraints() 
+{
+	std::vector<Constraint*>::const_iterator first;
+	std::vector<Constraint*>::const_iterator last;
+	gameWorld.GetConstraintIterators(first, last);
+
+	GameObjectIterator firstObject;
+	GameObjectIterator lastObject;
+	gameWorld.GetObjectIterators(firstObject, lastObject);
+	for (auto i = firstObject; i != lastObject; ++i) {
+		int worldID = (*i)->GetWorldID();
+		if (worldID >= (int)objectColours.size()) {
+			objectColours.resize(worldID + 1);
+		}
+		objectColours[worldID] = 0;
+	}
+
+	int serialColour = MaxConstraintColours;
+	constraintColours.clear();
+	constraintColourStart.assign(MaxConstraintColours + 2, 0);
+
+	for (auto i = first; i != last; ++i) {
+		GameObject* a = (*i)->GetObjectA();
+		GameObject* b = (*i)->GetObjectB();
+		int colour = serialColour;
+		if (a && b) {
+			uint64_t& coloursA	= objectColours[a->GetWorldID()];
+			uint64_t& coloursB	= objectColours[b->GetWorldID()];
+			uint64_t used		= coloursA | coloursB;
+			if (used != ~0ull) {
+				colour = std::countr_zero(~used);
+				coloursA |= 1ull << colour;
+				coloursB |= 1ull << colour;
+			}
+		}
+		constraintColours.emplace_back(colour);
+		constraintColourStart[colour + 1]++;
+	}
+
+	//Drop the unused colours off the end, but always keep the serial batch's slot
+	int colourCount = serialColour;
+	while (colourCount > 0 && constraintColourStart[colourCount] == 0) {
+		colourCount--;
+	}
+	if (constraintColourStart[serialColour + 1] > 0) {
+		colourCount = serialColour + 1;
+	}
+	constraintColourStart.resize(colourCount + 1);
+
+	for (int c = 1; c <= colourCount; ++c) {
+		constraintColourStart[c] += constraintColourStart[c - 1];
+	}
+	constraintOrder.resize(constraintColours.size());
+	std::vector<int> next(constraintColourStart.begin(), constraintColourStart.end() - 1);
+	int index = 0;
+	for (auto i = first; i != last; ++i, ++index) {
+		constraintOrder[next[constraintColours[index]]++] = *i;
 	}
 }
\ No newline at end of file
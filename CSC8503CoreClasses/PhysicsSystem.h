@@ -1,12 +1,27 @@
 #pragma once
 #include "GameWorld.h"
 #include "./CollisionDetection.h"
+#include "AABBTree.h"
+#include "QuadTree.h"
+#include "SweepAndPrune.h"
+#include "ThreadPool.h"
+#include "CollisionPairCache.h"
+#include "ContactSolver.h"
+#include "PhysicsBodyStore.h"
+#include "PhysicsProfiler.h"
 
 namespace NCL {
 	namespace CSC8503 {
 		class PhysicsSystem	
 		{
 		public:
+			enum class BroadphaseMethod {
+				DynamicAABBTree,
+				LooseQuadTree,
+				SweepAndPrune,
+				MaxMethods
+			};
+
 			PhysicsSystem(GameWorld& g);
 			~PhysicsSystem();
 
@@ -19,28 +34,133 @@ namespace NCL {
 				applyGravity = state;
 			}
 
+			void UseSleeping(bool state) 
+			{
+				useSleeping = state;
+			}
+
+			void UseContinuousCollision(bool state) 
+			{
+				useContinuousCollision = state;
+			}
+
+			void UseParallelNarrowPhase(bool state) 
+			{
+				useParallelNarrowPhase = state;
+			}
+
+			/*
+			Splits the constraints up into batches that don't share any objects,
+			so each batch can be solved across the worker pool. The order
+			constraints get solved in changes, so results differ a little from
+			the serial solver, but they're the same however many threads there are.
+			*/
+			void UseParallelConstraints(bool state) 
+			{
+				useParallelConstraints = state;
+			}
+
+			//Timings and counters for recent substeps
+			PhysicsProfiler& GetProfiler() 
+			{
+				return profiler;
+			}
+
+			const PhysicsProfiler& GetProfiler() const 
+			{
+				return profiler;
+			}
+
+			//How many batches the constraints were split into last update
+			int GetConstraintColourCount() const 
+			{
+				return constraintColourStart.empty() ? 0 : (int)constraintColourStart.size() - 1;
+			}
+
 			void SetGlobalDamping(float d) 
 			{
 				globalDamping = d;
 			}
 
 			void SetGravity(const Vector3& g);
+
+			void SetBroadphaseMethod(BroadphaseMethod m) 
+			{
+				broadphaseMethod = m;
+			}
+
+			BroadphaseMethod GetBroadphaseMethod() const 
+			{
+				return broadphaseMethod;
+			}
+
+			/*
+			Normally, the physics drops to a lower update rate if it's taking
+			too long, which depends on how fast the machine is. In deterministic
+			mode, it always steps at the ideal rate instead, so the same inputs
+			give exactly the same steps everywhere, and the state at the end of
+			each step is hashed, so that two machines can check they still
+			agree by comparing hashes rather than the whole world.
+			*/
+			void UseDeterministicMode(bool state) 
+			{
+				deterministic = state;
+			}
+
+			bool IsDeterministic() const 
+			{
+				return deterministic;
+			}
+
+			//How many physics steps have been run since the system was created
+			int GetPhysicsStep() const 
+			{
+				return physicsStep;
+			}
+
+			//A hash of every physics object's position, orientation and velocities, as they are right now
+			uint64_t HashState() const;
+
+			//The hash of the state at the end of the given step, if it was taken in deterministic mode recently enough to be remembered
+			bool GetStepHash(int step, uint64_t& hash) const;
+
+			static constexpr int StepHashHistory = 128;
 		protected:
 			void BasicCollisionDetection();
-			void BroadPhase();
+			void AddContact(const CollisionDetection::CollisionInfo& info);
+			void BroadPhase(float dt);
+			void UpdateBroadphaseTree(float dt);
+			void BroadPhaseAABBTree(float dt);
+			void BroadPhaseQuadTree();
+			void BroadPhaseSweepAndPrune();
+			void AddBroadphasePair(GameObject* a, GameObject* b);
 			void NarrowPhase();
+			void SortNarrowphasePairs();
+			void NarrowPhaseRange(int begin, int end);
+			void ParallelNarrowPhase();
+			ThreadPool& GetWorkerPool();
+			void WarmStartNarrowPhase(CollisionDetection::CollisionInfo& info);
 
 			void ClearForces();
 
 			void IntegrateAccel(float dt);
 			void IntegrateVelocity(float dt);
 
+			void ColourConstraints();
+			void GatherConstrainedBodies();
 			void UpdateConstraints(float dt);
 
 			void UpdateCollisionList();
 			void UpdateObjectAABBs();
 
-			void ImpulseResolveCollision(GameObject& a , GameObject&b, CollisionDetection::ContactPoint& p) const;
+			void PrepareContacts(float dt);
+			int  CountAwakeBodies() const;
+			void UpdateIslands();
+			void ContinuousCollision();
+
+			uint64_t HashBodies() const;
+
+			bool IsResting(int body) const;
 
 			GameWorld& gameWorld;
 
@@ -49,11 +169,75 @@ namespace NCL {
 			float	dTOffset;
 			float	globalDamping;
 
-			std::set<CollisionDetection::CollisionInfo>		allCollisions;
-			std::set<CollisionDetection::CollisionInfo>		broadphaseCollisions;
+			CollisionPairCache								allCollisions;
 			std::vector<CollisionDetection::CollisionInfo>	broadphaseCollisionsVec;
 			bool	useBroadPhase		= true;
 			int		numCollisionFrames	= 5;
+			int		collisionFrame		= 0;
+			int		physicsStep			= 0;
+
+			ContactSolver		contactSolver;
+			PhysicsBodyStore	bodies;	//every physics object's state, for the length of an update
+			std::vector<int>	constrainedBodies;	//bodies the constraints are attached to
+
+			bool	useContinuousCollision	= true;
+			float	sweepPenetration		= 0.005f;	//how far swept objects are let into what they hit, so the narrowphase sees it
+
+			struct IslandInfo {
+				bool	hasAwake		= false;
+				bool	hasSleeper		= false;
+				float	minSleepTime	= FLT_MAX;
+			};
+			bool					useSleeping				= true;
+			float					timeToSleep				= 0.5f;
+			float					linearSleepTolerance	= 0.05f;
+			float					angularSleepTolerance	= 0.05f;
+			std::vector<int>		islandParents;	//union-find parent for each body
+			std::vector<IslandInfo>	islandInfo;
+
+			AABBTree			broadphaseTree;
+			std::vector<int>	broadphaseProxies;	//tree proxy for each object, indexed by world ID
+			int					broadphaseStamp		= 0;
+
+			QuadTree<GameObject*>	broadphaseQuadTree;
+			SweepAndPrune			broadphaseSAP;
+			std::vector<int>		broadphaseSAPProxies;	//SAP proxy for each object, indexed by world ID
+
+			BroadphaseMethod		broadphaseMethod	= BroadphaseMethod::DynamicAABBTree;
+
+			PhysicsProfiler	profiler;
+			int				pairsTested		= 0;	//narrowphase tests this substep
+			int				contactsFound	= 0;	//contact points handed to the solver this substep
+
+			/*
+			This is the fixed update we actually have...
+			If physics takes too long it starts to kill the framerate, it'll drop the 
+			iteration count down until the FPS stabilises, even if that ends up
+			being at a low rate. 
+			*/
+			int		realHZ;
+			float	realDT;
+
+			bool		deterministic		= false;
+			uint64_t	stepHashes[StepHashHistory];
+			int			stepHashSteps[StepHashHistory];	//which step each hash is for, -1 if none yet
+
+			bool		useParallelNarrowPhase = false;
+			ThreadPool*	workerPool = nullptr;	//only started once something actually runs in parallel
+
+			static constexpr int MaxConstraintColours = 64;	//one bit each in a uint64_t, anything past this is solved serially
+
+			bool					useParallelConstraints = false;
+			std::vector<uint64_t>	objectColours;			//which colours each object's constraints already use, indexed by world ID
+			std::vector<int>		constraintColours;		//colour of each constraint, in world order
+			std::vector<int>		constraintColourStart;	//where each colour starts in constraintOrder, plus one past the end
+			std::vector<Constraint*> constraintOrder;		//constraints grouped by colour
+
+			std::vector<int>	narrowphaseTypes;		//pair type of each broadphase pair, -1 if it can't collide
+			std::vector<int>	narrowphaseTypeStart;	//used by the counting sort
+			std::vector<int>	narrowphaseOrder;		//broadphase pairs, grouped by pair type
+			std::vector<char>	narrowphaseHits;		//whether each broadphase pair collided
+			std::vector<CollisionDetection::CollisionInfo>	narrowphaseResults;	//indexed like broadphaseCollisionsVec
 		};
 	}
 }
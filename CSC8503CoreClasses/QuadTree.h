@@ -9,13 +9,13 @@ namespace NCL {
 		class QuadTree;
 
 		template<class T>
-		struct QuadTreeEntry 
+		struct QuadTreeEntry
 		{
 			Vector3 pos;
 			Vector3 size;
 			T object;
 
-			QuadTreeEntry(T obj, Vector3 pos, Vector3 size) 
+			QuadTreeEntry(T obj, Vector3 pos, Vector3 size)
 			{
 				object		= obj;
 				this->pos	= pos;
@@ -23,50 +23,77 @@ namespace NCL {
 			}
 		};
 
+		/*
+		This is a 'loose' quadtree - each node's bounds are grown to twice the
+		size of the area it actually covers. An object is stored in the deepest
+		node whose area contains its centre, and whose loose bounds can still
+		fit the object. This means each object is stored exactly once, rather
+		than being pushed into every node it touches, at the cost of having to
+		check a few more neighbouring nodes when searching.
+
+		Nodes are kept in a single pool owned by the QuadTree, and refer to
+		their children by index. Clearing the tree keeps both the pool and the
+		content vectors around, so rebuilding the tree every frame doesn't
+		touch the heap once it has warmed up.
+		*/
 		template<class T>
 		class QuadTreeNode	{
 		public:
-			typedef std::function<void(std::list<QuadTreeEntry<T>>&)> QuadTreeFunc;
-		protected:
-			friend class QuadTree<T>;
+			typedef std::function<void(std::vector<QuadTreeEntry<T>>&)> QuadTreeFunc;
 
 			QuadTreeNode() {}
 
-			QuadTreeNode(Vector2 pos, Vector2 size) 
+			QuadTreeNode(Vector2 pos, Vector2 size)
 			{
-				children		= nullptr;
-				this->position	= pos;
-				this->size		= size;
+				Reset(pos, size);
 			}
 
-			~QuadTreeNode() 
+			~QuadTreeNode()
 			{
-				delete[] children;
 			}
 
-			void Insert(T& object, const Vector3& objectPos, const Vector3& objectSize, int depthLeft, int maxSize) 
+		protected:
+			friend class QuadTree<T>;
+
+			void Reset(Vector2 pos, Vector2 size)
 			{
+				children		= -1;
+				this->position	= pos;
+				this->size		= size;
+				contents.clear();
 			}
 
-			void Split() 
+			//Quadtree nodes cover the xz plane, objects are centred in the tight bounds...
+			bool ContainsCentre(const Vector3& objectPos) const
 			{
+				return	std::abs(objectPos.x - position.x) <= size.x &&
+						std::abs(objectPos.z - position.y) <= size.y;
 			}
 
-			void DebugDraw() 
+			//...and can hang over the edge of them by up to the node's half size
+			bool FitsLoose(const Vector3& objectSize) const
 			{
+				return objectSize.x <= size.x && objectSize.z <= size.y;
 			}
 
-			void OperateOnContents(QuadTreeFunc& func) 
+			bool OverlapsLoose(const Vector3& boxPos, const Vector3& boxSize) const
 			{
+				return	std::abs(boxPos.x - position.x) <= boxSize.x + size.x * 2.0f &&
+						std::abs(boxPos.z - position.y) <= boxSize.z + size.y * 2.0f;
+			}
+
+			int GetChildIndex(const Vector3& objectPos) const
+			{
+				return (objectPos.x >= position.x ? 1 : 0) + (objectPos.z >= position.y ? 2 : 0);
 			}
 
 		protected:
-			std::list< QuadTreeEntry<T> >	contents;
+			std::vector< QuadTreeEntry<T> >	contents;
 
 			Vector2 position;
 			Vector2 size;
 
-			QuadTreeNode<T>* children;
+			int children;	//index of the first of 4 consecutive nodes in the pool, or -1
 		};
 	}
 }
@@ -81,31 +108,186 @@ namespace NCL {
 		public:
 			QuadTree(Vector2 size, int maxDepth = 6, int maxSize = 5)
 			{
-				root = QuadTreeNode<T>(Vector2(), size);
+				this->size		= size;
 				this->maxDepth	= maxDepth;
 				this->maxSize	= maxSize;
+				Clear();
 			}
 			~QuadTree() = default;
 
-			void Insert(T object, const Vector3& pos, const Vector3& size) 
+			//Empties the tree, but keeps hold of the node pool for reuse
+			void Clear()
+			{
+				if (nodes.empty()) {
+					nodes.emplace_back();
+				}
+				nodes[0].Reset(Vector2(), size);
+				nodeCount = 1;
+			}
+
+			void Insert(T object, const Vector3& pos, const Vector3& size)
 			{
-				root.Insert(object, pos, size, maxDepth, maxSize);
+				Insert(0, QuadTreeEntry<T>(object, pos, size), maxDepth);
 			}
 
-			void DebugDraw() 
+			void DebugDraw()
 			{
-				root.DebugDraw();
+				for (int i = 0; i < nodeCount; ++i) {
+					const QuadTreeNode<T>& n = nodes[i];
+					Vector3 a(n.position.x - n.size.x, 0, n.position.y - n.size.y);
+					Vector3 b(n.position.x + n.size.x, 0, n.position.y - n.size.y);
+					Vector3 c(n.position.x + n.size.x, 0, n.position.y + n.size.y);
+					Vector3 d(n.position.x - n.size.x, 0, n.position.y + n.size.y);
+
+					Vector4 colour = n.contents.empty() ? Debug::BLUE : Debug::CYAN;
+					Debug::DrawLine(a, b, colour);
+					Debug::DrawLine(b, c, colour);
+					Debug::DrawLine(c, d, colour);
+					Debug::DrawLine(d, a, colour);
+				}
 			}
 
-			void OperateOnContents(typename QuadTreeNode<T>::QuadTreeFunc  func) 
+			void OperateOnContents(typename QuadTreeNode<T>::QuadTreeFunc  func)
 			{
-				root.OperateOnContents(func);
+				for (int i = 0; i < nodeCount; ++i) {
+					if (!nodes[i].contents.empty()) {
+						func(nodes[i].contents);
+					}
+				}
+			}
+
+			/*
+			Calls func on every entry whose box overlaps the given box. Only
+			nodes whose loose bounds overlap the box need visiting. The root
+			is always visited, as anything that was inserted outside of the
+			tree's area ends up stored there.
+			*/
+			template<class F>
+			void Query(const Vector3& boxPos, const Vector3& boxSize, F&& func) const
+			{
+				int stack[128];
+				int stackSize = 0;
+				stack[stackSize++] = 0;
+
+				while (stackSize > 0) {
+					int index = stack[--stackSize];
+					const QuadTreeNode<T>& n = nodes[index];
+					if (index != 0 && !n.OverlapsLoose(boxPos, boxSize)) {
+						continue;
+					}
+					for (int i = 0; i < (int)n.contents.size(); ++i) {
+						if (EntriesOverlap(n.contents[i], boxPos, boxSize)) {
+							func(index, i, n.contents[i]);
+						}
+					}
+					if (n.children != -1) {
+						for (int c = 0; c < 4; ++c) {
+							stack[stackSize++] = n.children + c;
+						}
+					}
+				}
+			}
+
+			/*
+			Calls func(a, b) once for each pair of entries whose boxes overlap.
+			Every entry searches the tree with its own box, and only reports
+			the entries that come after it in the node pool, so each pair is
+			only ever seen the once.
+			*/
+			template<class F>
+			void OperateOnPairs(F&& func) const
+			{
+				for (int n = 0; n < nodeCount; ++n) {
+					for (int i = 0; i < (int)nodes[n].contents.size(); ++i) {
+						const QuadTreeEntry<T>& a = nodes[n].contents[i];
+						Query(a.pos, a.size,
+							[&](int otherNode, int otherIndex, const QuadTreeEntry<T>& b) {
+								if (otherNode > n || (otherNode == n && otherIndex > i)) {
+									func(a, b);
+								}
+							}
+						);
+					}
+				}
+			}
+
+			int GetNodeCount() const
+			{
+				return nodeCount;
 			}
 
 		protected:
-			QuadTreeNode<T> root;
-			int maxDepth;
-			int maxSize;
+			static bool EntriesOverlap(const QuadTreeEntry<T>& e, const Vector3& boxPos, const Vector3& boxSize)
+			{
+				return	std::abs(e.pos.x - boxPos.x) <= e.size.x + boxSize.x &&
+						std::abs(e.pos.y - boxPos.y) <= e.size.y + boxSize.y &&
+						std::abs(e.pos.z - boxPos.z) <= e.size.z + boxSize.z;
+			}
+
+			void Insert(int nodeIndex, const QuadTreeEntry<T>& entry, int depthLeft)
+			{
+				while (true) {
+					QuadTreeNode<T>& n = nodes[nodeIndex];
+					if (n.children == -1) {
+						n.contents.emplace_back(entry);
+						if ((int)n.contents.size() > maxSize && depthLeft > 0) {
+							Split(nodeIndex, depthLeft);
+						}
+						return;
+					}
+					int child = n.children + n.GetChildIndex(entry.pos);
+					if (!n.ContainsCentre(entry.pos) || !nodes[child].FitsLoose(entry.size)) {
+						n.contents.emplace_back(entry);
+						return;
+					}
+					nodeIndex = child;
+					depthLeft--;
+				}
+			}
+
+			/*
+			Splitting hands out the next 4 nodes in the pool, and pushes down
+			whichever of this node's contents are small enough to fit into
+			one of them. Anything too big stays where it is.
+			*/
+			void Split(int nodeIndex, int depthLeft)
+			{
+				if (nodeCount + 4 > (int)nodes.size()) {
+					nodes.resize(nodeCount + 4);
+				}
+				int first = nodeCount;
+				nodeCount += 4;
+
+				QuadTreeNode<T>& n = nodes[nodeIndex];
+				Vector2 halfSize = n.size * 0.5f;
+				for (int c = 0; c < 4; ++c) {
+					Vector2 offset((c & 1) ? halfSize.x : -halfSize.x, (c & 2) ? halfSize.y : -halfSize.y);
+					nodes[first + c].Reset(n.position + offset, halfSize);
+				}
+				n.children = first;
+
+				//Pushing entries down can split the children in turn and grow the
+				//pool, so this node has to be looked up again each time around
+				int kept = 0;
+				for (int i = 0; i < (int)nodes[nodeIndex].contents.size(); ++i) {
+					QuadTreeEntry<T> e	= nodes[nodeIndex].contents[i];
+					int child			= first + nodes[nodeIndex].GetChildIndex(e.pos);
+					if (nodes[nodeIndex].ContainsCentre(e.pos) && nodes[child].FitsLoose(e.size)) {
+						Insert(child, e, depthLeft - 1);
+					}
+					else {
+						nodes[nodeIndex].contents[kept++] = e;
+					}
+				}
+				std::vector<QuadTreeEntry<T>>& contents = nodes[nodeIndex].contents;
+				contents.erase(contents.begin() + kept, contents.end());
+			}
+
+			std::vector<QuadTreeNode<T>>	nodes;
+			int		nodeCount;
+			Vector2 size;
+			int		maxDepth;
+			int		maxSize;
 		};
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,118 @@
+#include "RayPacket.h"
+#include "Ray.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+RayPacket::RayPacket(const Ray* rays, int count) {
+	this->count = std::min(count, Size);
+
+	float values[3][3][Size];
+	for (int i = 0; i < Size; ++i) {
+		//Spare lanes copy the last ray, so they never produce any odd values, but are marked as finished
+		const Ray& r		= rays[std::min(i, this->count - 1)];
+		Vector3 position	= r.GetPosition();
+		Vector3 dir			= r.GetDirection();
+		for (int axis = 0; axis < 3; ++axis) {
+			values[0][axis][i] = position[axis];
+			values[1][axis][i] = dir[axis];
+			values[2][axis][i] = dir[axis] != 0.0f ? 1.0f / dir[axis] : 0.0f;
+		}
+		maxDistance[i] = i < this->count ? FLT_MAX : -1.0f;
+	}
+	for (int axis = 0; axis < 3; ++axis) {
+		origin[axis]			= SimdLoad(values[0][axis]);
+		direction[axis]			= SimdLoad(values[1][axis]);
+		inverseDirection[axis]	= SimdLoad(values[2][axis]);
+	}
+}
+
+int RayPacket::GetActiveMask() const {
+	return SimdMask(SimdLessEqual(SimdSet(0.0f), SimdLoad(maxDistance)));
+}
+
+/*
+The usual slab test, used to walk down the broadphase tree. An axis the ray
+runs parallel to doesn't narrow down the range the ray is in the box, but
+the ray misses altogether if it doesn't start between that axis' slabs.
+*/
+int RayPacket::OverlapBox(const Vector3& boxMin, const Vector3& boxMax, float* entry) const {
+	SimdFloat zero	= SimdSet(0.0f);
+	SimdFloat tMin	= zero;
+	SimdFloat tMax	= SimdLoad(maxDistance);
+	SimdFloat miss	= zero;
+
+	for (int i = 0; i < 3; ++i) {
+		SimdFloat slabMin	= SimdSet(boxMin[i]);
+		SimdFloat slabMax	= SimdSet(boxMax[i]);
+		SimdFloat t0		= SimdMul(SimdSub(slabMin, origin[i]), inverseDirection[i]);
+		SimdFloat t1		= SimdMul(SimdSub(slabMax, origin[i]), inverseDirection[i]);
+
+		SimdFloat parallel	= SimdEqual(direction[i], zero);
+		SimdFloat outside	= SimdOr(SimdLess(origin[i], slabMin), SimdGreater(origin[i], slabMax));
+		miss = SimdOr(miss, SimdAnd(parallel, outside));
+
+		tMin = SimdSelect(parallel, tMin, SimdMax(tMin, SimdMin(t0, t1)));
+		tMax = SimdSelect(parallel, tMax, SimdMin(tMax, SimdMax(t0, t1)));
+	}
+	SimdStore(entry, tMin);
+	return SimdMask(SimdAndNot(miss, SimdLessEqual(tMin, tMax)));
+}
+
+/*
+This follows RayBoxIntersection step for step, so that a packet finds
+exactly the same hits as casting its rays one at a time would: the
+furthest of the planes the ray faces is where it would enter the box,
+and then that point is checked to be on the box's surface.
+*/
+int RayPacket::IntersectBox(const Vector3& boxMin, const Vector3& boxMax, float* distance) const {
+	SimdFloat zero	= SimdSet(0.0f);
+	SimdFloat bestT = SimdSet(-1.0f);
+
+	for (int i = 0; i < 3; ++i) {
+		SimdFloat tNear = SimdDiv(SimdSub(SimdSet(boxMin[i]), origin[i]), direction[i]);
+		SimdFloat tFar	= SimdDiv(SimdSub(SimdSet(boxMax[i]), origin[i]), direction[i]);
+		SimdFloat t		= SimdSelect(SimdGreater(direction[i], zero), tNear,
+						  SimdSelect(SimdLess(direction[i], zero), tFar, SimdSet(-1.0f)));
+		bestT = SimdMax(bestT, t);
+	}
+	SimdFloat hit		= SimdLessEqual(zero, bestT);
+	SimdFloat epsilon	= SimdSet(0.0001f);
+
+	for (int i = 0; i < 3; ++i) {
+		SimdFloat point = SimdAdd(origin[i], SimdMul(direction[i], bestT));
+		hit = SimdAnd(hit, SimdLessEqual(SimdSet(boxMin[i]), SimdAdd(point, epsilon)));
+		hit = SimdAnd(hit, SimdLessEqual(SimdSub(point, epsilon), SimdSet(boxMax[i])));
+	}
+	hit = SimdAnd(hit, SimdLess(bestT, SimdLoad(maxDistance)));
+
+	SimdStore(distance, bestT);
+	return SimdMask(hit);
+}
+
+int RayPacket::IntersectSphere(const Vector3& centre, float radius, float* distance) const {
+	SimdFloat toCentre[3];
+	SimdFloat projection = SimdSet(0.0f);
+	for (int i = 0; i < 3; ++i) {
+		toCentre[i] = SimdSub(SimdSet(centre[i]), origin[i]);
+		projection	= SimdAdd(projection, SimdMul(toCentre[i], direction[i]));
+	}
+	//How close the ray passes to the centre of the sphere
+	SimdFloat distSq = SimdSet(0.0f);
+	for (int i = 0; i < 3; ++i) {
+		SimdFloat point = SimdAdd(origin[i], SimdMul(direction[i], projection));
+		SimdFloat diff	= SimdSub(point, SimdSet(centre[i]));
+		distSq = SimdAdd(distSq, SimdMul(diff, diff));
+	}
+	SimdFloat dist		= SimdSqrt(distSq);
+	SimdFloat r			= SimdSet(radius);
+	SimdFloat hit		= SimdAnd(SimdLessEqual(SimdSet(0.0f), projection), SimdLessEqual(dist, r));
+
+	//Missing lanes would take the square root of a negative number, so clamp them first
+	SimdFloat offsetSq	= SimdMax(SimdSub(SimdMul(r, r), SimdMul(dist, dist)), SimdSet(0.0f));
+	SimdFloat t			= SimdSub(projection, SimdSqrt(offsetSq));
+	hit = SimdAnd(hit, SimdLess(t, SimdLoad(maxDistance)));
+
+	SimdStore(distance, t);
+	return SimdMask(hit);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "Simd.h"
+
+namespace NCL {
+	namespace Maths {
+		class Ray;
+	}
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		A small group of rays, packed so that each SIMD instruction works on
+		all of them at once - one lane per ray, with all of the x origins in one
+		register, all of the y origins in another, and so on. Rays fired from
+		roughly the same place in roughly the same direction, like an AI's
+		feelers or a spread of bullets, tend to pass through the same boxes, so
+		testing them together costs little more than testing one.
+
+		Each lane has its own max distance, which shrinks as closer hits are
+		found. A negative max distance marks the lane as finished, and it won't
+		report any more hits. If there are fewer rays than lanes, the spare
+		lanes start out finished.
+
+		The intersection tests return a bitmask, with bit i set if lane i hit.
+		*/
+		class RayPacket {
+		public:
+			static constexpr int Size = SimdWidth;
+
+			RayPacket(const Ray* rays, int count);
+			~RayPacket() = default;
+
+			int GetCount() const
+			{
+				return count;
+			}
+
+			float GetMaxDistance(int lane) const
+			{
+				return maxDistance[lane];
+			}
+
+			void SetMaxDistance(int lane, float distance)
+			{
+				maxDistance[lane] = distance;
+			}
+
+			//The lanes still looking for hits
+			int GetActiveMask() const;
+
+			//Lanes that pass through the box within their max distance, and how far along they enter it
+			int OverlapBox(const Vector3& boxMin, const Vector3& boxMax, float* entry) const;
+
+			//Lanes that hit the box closer than their max distance, tested the same way as RayBoxIntersection
+			int IntersectBox(const Vector3& boxMin, const Vector3& boxMax, float* distance) const;
+
+			//Lanes that hit the sphere closer than their max distance, tested the same way as RaySphereIntersection
+			int IntersectSphere(const Vector3& centre, float radius, float* distance) const;
+
+		protected:
+			SimdFloat origin[3];
+			SimdFloat direction[3];
+			SimdFloat inverseDirection[3];
+
+			float	maxDistance[Size];
+			int		count;
+		};
+	}
+}
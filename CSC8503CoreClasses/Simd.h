@@ -0,0 +1,66 @@
+#pragma once
+#include <immintrin.h>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A thin layer over the SIMD intrinsics, so that code using them can be
+		written once, and use AVX when the compiler has been told it can (in
+		Visual Studio, that's /arch:AVX or /arch:AVX2), and plain SSE otherwise.
+
+		Comparisons give a mask per lane, which can be used to pick between two
+		values with SimdSelect, or turned into a bitmask of lanes with SimdMask.
+		*/
+#if defined(__AVX__)
+		typedef __m256 SimdFloat;
+		static constexpr int SimdWidth = 8;
+
+		inline SimdFloat SimdLoad(const float* f)				{ return _mm256_loadu_ps(f); }
+		inline void		 SimdStore(float* f, SimdFloat a)		{ _mm256_storeu_ps(f, a); }
+		inline SimdFloat SimdSet(float f)						{ return _mm256_set1_ps(f); }
+		inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b)		{ return _mm256_add_ps(a, b); }
+		inline SimdFloat SimdSub(SimdFloat a, SimdFloat b)		{ return _mm256_sub_ps(a, b); }
+		inline SimdFloat SimdMul(SimdFloat a, SimdFloat b)		{ return _mm256_mul_ps(a, b); }
+		inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b)		{ return _mm256_div_ps(a, b); }
+		inline SimdFloat SimdSqrt(SimdFloat a)					{ return _mm256_sqrt_ps(a); }
+		inline SimdFloat SimdMin(SimdFloat a, SimdFloat b)		{ return _mm256_min_ps(a, b); }
+		inline SimdFloat SimdMax(SimdFloat a, SimdFloat b)		{ return _mm256_max_ps(a, b); }
+		inline SimdFloat SimdAbs(SimdFloat a)					{ return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+		inline SimdFloat SimdLess(SimdFloat a, SimdFloat b)		{ return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		inline SimdFloat SimdLessEqual(SimdFloat a, SimdFloat b){ return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+		inline SimdFloat SimdGreater(SimdFloat a, SimdFloat b)	{ return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		inline SimdFloat SimdEqual(SimdFloat a, SimdFloat b)	{ return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+		inline SimdFloat SimdAnd(SimdFloat a, SimdFloat b)		{ return _mm256_and_ps(a, b); }
+		inline SimdFloat SimdOr(SimdFloat a, SimdFloat b)		{ return _mm256_or_ps(a, b); }
+		inline SimdFloat SimdAndNot(SimdFloat a, SimdFloat b)	{ return _mm256_andnot_ps(a, b); }	//~a & b
+		inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b, a, mask); }
+		inline int		 SimdMask(SimdFloat mask)				{ return _mm256_movemask_ps(mask); }
+#else
+		typedef __m128 SimdFloat;
+		static constexpr int SimdWidth = 4;
+
+		inline SimdFloat SimdLoad(const float* f)				{ return _mm_loadu_ps(f); }
+		inline void		 SimdStore(float* f, SimdFloat a)		{ _mm_storeu_ps(f, a); }
+		inline SimdFloat SimdSet(float f)						{ return _mm_set1_ps(f); }
+		inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b)		{ return _mm_add_ps(a, b); }
+		inline SimdFloat SimdSub(SimdFloat a, SimdFloat b)		{ return _mm_sub_ps(a, b); }
+		inline SimdFloat SimdMul(SimdFloat a, SimdFloat b)		{ return _mm_mul_ps(a, b); }
+		inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b)		{ return _mm_div_ps(a, b); }
+		inline SimdFloat SimdSqrt(SimdFloat a)					{ return _mm_sqrt_ps(a); }
+		inline SimdFloat SimdMin(SimdFloat a, SimdFloat b)		{ return _mm_min_ps(a, b); }
+		inline SimdFloat SimdMax(SimdFloat a, SimdFloat b)		{ return _mm_max_ps(a, b); }
+		inline SimdFloat SimdAbs(SimdFloat a)					{ return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+		inline SimdFloat SimdLess(SimdFloat a, SimdFloat b)		{ return _mm_cmplt_ps(a, b); }
+		inline SimdFloat SimdLessEqual(SimdFloat a, SimdFloat b){ return _mm_cmple_ps(a, b); }
+		inline SimdFloat SimdGreater(SimdFloat a, SimdFloat b)	{ return _mm_cmpgt_ps(a, b); }
+		inline SimdFloat SimdEqual(SimdFloat a, SimdFloat b)	{ return _mm_cmpeq_ps(a, b); }
+		inline SimdFloat SimdAnd(SimdFloat a, SimdFloat b)		{ return _mm_and_ps(a, b); }
+		inline SimdFloat SimdOr(SimdFloat a, SimdFloat b)		{ return _mm_or_ps(a, b); }
+		inline SimdFloat SimdAndNot(SimdFloat a, SimdFloat b)	{ return _mm_andnot_ps(a, b); }	//~a & b
+		inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+		inline int		 SimdMask(SimdFloat mask)				{ return _mm_movemask_ps(mask); }
+#endif
+	}
+}
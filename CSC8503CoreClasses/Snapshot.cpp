@@ -0,0 +1,122 @@
+#include "Snapshot.h"
+#include "NetworkObject.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+int SnapshotQuantisation::GetPositionBits() const {
+	uint32_t steps	= (uint32_t)std::ceil(positionRange / positionResolution);
+	int bits		= 1;
+	while ((1u << bits) <= 2 * steps) {
+		bits++;
+	}
+	return bits;
+}
+
+int SnapshotQuantisation::QuantisePosition(float value) const {
+	return (int)std::lround(std::clamp(value, -positionRange, positionRange) / positionResolution);
+}
+
+float SnapshotQuantisation::DequantisePosition(int value) const {
+	return value * positionResolution;
+}
+
+/*
+The largest component is made positive (q and -q are the same rotation),
+so that it never needs a sign bit, and the other three are mapped from
+-1/sqrt(2)..1/sqrt(2) onto the whole range of their bits.
+*/
+uint32_t SnapshotQuantisation::QuantiseOrientation(const Quaternion& q) const {
+	float c[4]		= { q.x, q.y, q.z, q.w };
+	float length	= std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2] + c[3] * c[3]);
+	int largest		= 0;
+	for (int i = 1; i < 4; ++i) {
+		if (std::abs(c[i]) > std::abs(c[largest])) {
+			largest = i;
+		}
+	}
+	float scale		= (c[largest] < 0.0f ? -1.0f : 1.0f) / (length > 0.0f ? length : 1.0f);
+	float maxValue	= (float)((1 << orientationBits) - 1);
+
+	uint32_t packed = largest;
+	int shift		= 2;
+	for (int i = 0; i < 4; ++i) {
+		if (i == largest) {
+			continue;
+		}
+		float unit = std::clamp((c[i] * scale * sqrtf(2.0f) + 1.0f) * 0.5f, 0.0f, 1.0f);
+		packed |= (uint32_t)std::lround(unit * maxValue) << shift;
+		shift += orientationBits;
+	}
+	return packed;
+}
+
+Quaternion SnapshotQuantisation::DequantiseOrientation(uint32_t packed) const {
+	float c[4];
+	int largest		= packed & 3;
+	float maxValue	= (float)((1 << orientationBits) - 1);
+	uint32_t mask	= (1u << orientationBits) - 1;
+
+	float sum	= 0.0f;
+	int shift	= 2;
+	for (int i = 0; i < 4; ++i) {
+		if (i == largest) {
+			continue;
+		}
+		float unit	= ((packed >> shift) & mask) / maxValue;
+		c[i]		= (unit * 2.0f - 1.0f) / sqrtf(2.0f);
+		sum			+= c[i] * c[i];
+		shift		+= orientationBits;
+	}
+	c[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+	return Quaternion(c[0], c[1], c[2], c[3]);
+}
+
+void SnapshotWriter::Begin(int tick, int fullStateID, int baseStateID) {
+	writer.Reset(sizeof(SnapshotPacket));
+	this->tick			= tick;
+	this->fullStateID	= fullStateID;
+	this->baseStateID	= baseStateID;
+	objectCount			= 0;
+}
+
+bool SnapshotWriter::AddObject(NetworkObject& object, bool useBase) {
+	int start = writer.GetBitCount();
+	object.WriteSnapshotEntry(writer, useBase ? baseStateID : -1, quantisation);
+	if (writer.GetByteCount() > MaxPacketBytes || objectCount == USHRT_MAX) {
+		writer.Rewind(start);
+		return false;
+	}
+	objectCount++;
+	return true;
+}
+
+SnapshotPacket& SnapshotWriter::Finish() {
+	SnapshotPacket header;
+	header.tick			= tick;
+	header.fullStateID	= fullStateID;
+	header.baseStateID	= baseStateID;
+	header.objectCount	= (unsigned short)objectCount;
+	header.size			= (short)(writer.GetByteCount() - sizeof(GamePacket));
+	memcpy(writer.GetData(), &header, sizeof(header));
+
+	return *(SnapshotPacket*)writer.GetData();
+}
+
+bool SnapshotReader::Read(const SnapshotPacket& packet, const ObjectLookup& lookup, const SnapshotQuantisation& quantisation) {
+	BitReader reader(packet.GetEntries(), packet.GetEntryBytes());
+	SnapshotEntry entry;
+
+	for (int i = 0; i < packet.objectCount; ++i) {
+		NetworkObject::ReadSnapshotEntry(reader, entry, quantisation);
+		if (reader.IsOverflowed()) {
+			return false;
+		}
+		entry.baseStateID = packet.baseStateID;
+		entry.fullStateID = packet.fullStateID;
+		if (NetworkObject* o = lookup(entry.objectID)) {
+			o->ApplySnapshotEntry(entry, quantisation);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "BitStream.h"
+#include "NetworkBase.h"
+
+namespace NCL {
+	using namespace Maths;
+	namespace CSC8503 {
+		class NetworkObject;
+		struct SnapshotPacket;
+
+		/*
+		How precisely each part of an object's state is sent. Positions are
+		rounded to a grid of positionResolution sized steps, and have to be
+		within positionRange of the origin. Orientations are sent using the
+		'smallest three' method - a unit quaternion's largest component can
+		always be worked out from the other three, so only which one it was
+		and the other three are sent, and as none of the three can be bigger
+		than 1 / sqrt(2), they get all of their bits spent on that range.
+
+		The server and its clients must all use the same settings.
+		*/
+		struct SnapshotQuantisation {
+			float	positionResolution	= 1.0f / 512.0f;
+			float	positionRange		= 4096.0f;
+			int		orientationBits		= 10;	//per component, at most 10
+
+			int		GetPositionBits() const;
+			int		QuantisePosition(float value) const;
+			float	DequantisePosition(int value) const;
+
+			int			GetOrientationBits() const
+			{
+				return 2 + 3 * orientationBits;
+			}
+			uint32_t	QuantiseOrientation(const Quaternion& q) const;
+			Quaternion	DequantiseOrientation(uint32_t packed) const;
+		};
+
+		/*
+		Builds one client's snapshot for a tick - a single SnapshotPacket, with
+		every object's entry packed in after it. The server keeps one of these
+		per client, and reuses its buffer every tick, so once it's big enough
+		for the world, writing snapshots doesn't touch the heap at all, and
+		each client gets one packet a tick no matter how many objects there are.
+		*/
+		class SnapshotWriter {
+		public:
+			SnapshotWriter()	= default;
+			~SnapshotWriter()	= default;
+
+			void SetQuantisation(const SnapshotQuantisation& q)
+			{
+				quantisation = q;
+			}
+
+			/*
+			Objects are sent as deltas from baseStateID, the last full state the
+			client acknowledged. On full frames, every object is sent, and the
+			client keeps them as full state fullStateID. On delta frames,
+			fullStateID is -1. Which objects go in is up to the server.
+			*/
+			void Begin(int tick, int fullStateID, int baseStateID = -1);
+
+			/*
+			Objects the client might not have the base state for are sent whole.
+			Returns false, and leaves the object out, if its entry would take the
+			packet past MaxPacketBytes - a GamePacket's size can't go any higher.
+			*/
+			bool AddObject(NetworkObject& object, bool useBase = true);
+
+			static constexpr int MaxPacketBytes = sizeof(GamePacket) + SHRT_MAX;
+
+			//Fills in the packet header - the packet is only valid until the next Begin
+			SnapshotPacket& Finish();
+
+			int GetObjectCount() const
+			{
+				return objectCount;
+			}
+
+		protected:
+			BitWriter				writer;
+			SnapshotQuantisation	quantisation;
+			int						tick		= 0;
+			int						fullStateID	= -1;
+			int						baseStateID	= -1;
+			int						objectCount	= 0;
+		};
+
+		/*
+		Goes through a received snapshot, handing each entry to the right
+		object. Entries for objects that the client doesn't know about are
+		skipped over. Returns false if the packet was cut short.
+		*/
+		class SnapshotReader {
+		public:
+			typedef std::function<NetworkObject*(int networkID)> ObjectLookup;
+
+			static bool Read(const SnapshotPacket& packet, const ObjectLookup& lookup,
+				const SnapshotQuantisation& quantisation = SnapshotQuantisation());
+		};
+	}
+}
@@ -0,0 +1,150 @@
+#include "SweepAndPrune.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+SweepAndPrune::SweepAndPrune()
+{
+	Clear();
+}
+
+void SweepAndPrune::Clear()
+{
+	proxies.clear();
+	freeProxies.clear();
+	removedProxies.clear();
+	for (int i = 0; i < 3; ++i) {
+		axes[i].clear();
+	}
+	active.clear();
+
+	proxyCount		= 0;
+	pendingInserts	= 0;
+	sweepAxis		= 0;
+}
+
+int SweepAndPrune::Insert(GameObject* object, const Vector3& position, const Vector3& halfSize)
+{
+	int index;
+	if (freeProxies.empty()) {
+		index = (int)proxies.size();
+		proxies.emplace_back();
+	}
+	else {
+		index = freeProxies.back();
+		freeProxies.pop_back();
+	}
+	Proxy& p		= proxies[index];
+	p.object		= object;
+	p.boxMin		= position - halfSize;
+	p.boxMax		= position + halfSize;
+	p.stamp			= 0;
+	p.activeIndex	= -1;
+
+	//New endpoints go on the end, and get moved into place by the next Sort
+	for (int i = 0; i < 3; ++i) {
+		axes[i].push_back({ p.boxMin[i], (uint32_t)index << 1 });
+		axes[i].push_back({ p.boxMax[i], ((uint32_t)index << 1) | 1 });
+	}
+	proxyCount++;
+	pendingInserts++;
+	return index;
+}
+
+/*
+The endpoints stay in the lists until the next Sort strips them out, and
+the proxy can't be handed out again until then, or the old endpoints
+would end up pointing at whatever object reused it.
+*/
+void SweepAndPrune::Remove(int proxy)
+{
+	proxies[proxy].object = nullptr;
+	removedProxies.emplace_back(proxy);
+	proxyCount--;
+}
+
+void SweepAndPrune::Update(int proxy, const Vector3& position, const Vector3& halfSize)
+{
+	Proxy& p = proxies[proxy];
+	p.boxMin = position - halfSize;
+	p.boxMax = position + halfSize;
+}
+
+void SweepAndPrune::RemoveUntouched(int stamp)
+{
+	for (int i = 0; i < (int)proxies.size(); ++i) {
+		if (proxies[i].object && proxies[i].stamp != stamp) {
+			Remove(i);
+		}
+	}
+}
+
+/*
+Because the endpoints barely move between substeps, each one only has to
+shuffle back a place or two, so this is almost linear. A big batch of new
+objects (such as when the level is first built) would make it quadratic,
+so those cases just get a regular sort instead.
+*/
+void SweepAndPrune::InsertionSort(std::vector<Endpoint>& axis)
+{
+	if (pendingInserts > 32 && pendingInserts * 4 > proxyCount) {
+		std::sort(axis.begin(), axis.end());
+		return;
+	}
+	for (int i = 1; i < (int)axis.size(); ++i) {
+		Endpoint e = axis[i];
+		int j = i - 1;
+		while (j >= 0 && e < axis[j]) {
+			axis[j + 1] = axis[j];
+			--j;
+		}
+		axis[j + 1] = e;
+	}
+}
+
+void SweepAndPrune::Sort()
+{
+	Vector3 centreSum;
+	Vector3 centreSqSum;
+
+	for (int i = 0; i < 3; ++i) {
+		std::vector<Endpoint>& axis = axes[i];
+		if (!removedProxies.empty()) {
+			int kept = 0;
+			for (const Endpoint& e : axis) {
+				if (proxies[e.GetProxy()].object) {
+					axis[kept++] = e;
+				}
+			}
+			axis.resize(kept);
+		}
+		for (Endpoint& e : axis) {
+			const Proxy& p = proxies[e.GetProxy()];
+			e.value = e.IsMax() ? p.boxMax[i] : p.boxMin[i];
+		}
+		InsertionSort(axis);
+	}
+	pendingInserts = 0;
+	freeProxies.insert(freeProxies.end(), removedProxies.begin(), removedProxies.end());
+	removedProxies.clear();
+
+	//Sweep along whichever axis the objects are most spread out on
+	for (const Proxy& p : proxies) {
+		if (!p.object) {
+			continue;
+		}
+		Vector3 centre = (p.boxMin + p.boxMax) * 0.5f;
+		centreSum	+= centre;
+		centreSqSum += centre * centre;
+	}
+	if (proxyCount > 0) {
+		Vector3 mean		= centreSum / (float)proxyCount;
+		Vector3 variance	= centreSqSum / (float)proxyCount - mean * mean;
+		sweepAxis = 0;
+		for (int i = 1; i < 3; ++i) {
+			if (variance[i] > variance[sweepAxis]) {
+				sweepAxis = i;
+			}
+		}
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "Vector.h"
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		class GameObject;
+
+		/*
+		A sweep and prune broadphase. Every object's box is projected onto each
+		axis as a min and a max endpoint, and those endpoints are kept sorted
+		between frames. Objects barely move from one substep to the next, so
+		the lists are nearly sorted already, and an insertion sort puts them
+		back in order in close to linear time.
+
+		Finding pairs is then a single sweep along one axis, keeping a list of
+		the boxes we're currently 'inside' of. All three axes are kept sorted,
+		so the sweep can use whichever axis the objects are most spread out on
+		without needing a full resort when that changes.
+		*/
+		class SweepAndPrune {
+		public:
+			SweepAndPrune();
+			~SweepAndPrune() = default;
+
+			void Clear();
+
+			int  Insert(GameObject* object, const Vector3& position, const Vector3& halfSize);
+			void Remove(int proxy);
+			void Update(int proxy, const Vector3& position, const Vector3& halfSize);
+
+			GameObject* GetObject(int proxy) const
+			{
+				if (proxy < 0 || proxy >= (int)proxies.size()) {
+					return nullptr;
+				}
+				return proxies[proxy].object;
+			}
+
+			int GetProxyCount() const
+			{
+				return proxyCount;
+			}
+
+			//Marks a proxy as still being present in the world this pass
+			void Touch(int proxy, int stamp)
+			{
+				proxies[proxy].stamp = stamp;
+			}
+
+			//Removes every proxy that wasn't touched with the given stamp
+			void RemoveUntouched(int stamp);
+
+			//Brings the endpoint lists back into order after any updates
+			void Sort();
+
+			template<class F>
+			void QueryOverlappingPairs(F&& func);
+
+		protected:
+			struct Proxy {
+				GameObject* object;	//nullptr when the proxy is free
+				Vector3		boxMin;
+				Vector3		boxMax;
+				int			stamp;
+				int			activeIndex;
+			};
+
+			struct Endpoint {
+				float	 value;
+				uint32_t data;	//proxy index << 1, with the low bit set for max endpoints
+
+				int  GetProxy() const { return (int)(data >> 1); }
+				bool IsMax()	const { return (data & 1) != 0; }
+
+				//Mins sort before maxes of the same value, so touching boxes still pair up
+				bool operator<(const Endpoint& other) const
+				{
+					return value < other.value || (value == other.value && (data & 1) < (other.data & 1));
+				}
+			};
+
+			void InsertionSort(std::vector<Endpoint>& axis);
+
+			std::vector<Proxy>		proxies;
+			std::vector<int>		freeProxies;
+			std::vector<int>		removedProxies;
+			std::vector<Endpoint>	axes[3];
+			std::vector<int>		active;
+
+			int		proxyCount;
+			int		pendingInserts;
+			int		sweepAxis;
+		};
+
+		template<class F>
+		void SweepAndPrune::QueryOverlappingPairs(F&& func)
+		{
+			const int axisB = (sweepAxis + 1) % 3;
+			const int axisC = (sweepAxis + 2) % 3;
+
+			active.clear();
+			for (const Endpoint& e : axes[sweepAxis]) {
+				int index = e.GetProxy();
+				Proxy& p  = proxies[index];
+
+				if (e.IsMax()) {
+					//Swap the last active proxy into this one's slot
+					int last = active.back();
+					active[p.activeIndex]			= last;
+					proxies[last].activeIndex		= p.activeIndex;
+					active.pop_back();
+					continue;
+				}
+				for (int otherIndex : active) {
+					const Proxy& o = proxies[otherIndex];
+					if (p.boxMin[axisB] <= o.boxMax[axisB] && p.boxMax[axisB] >= o.boxMin[axisB] &&
+						p.boxMin[axisC] <= o.boxMax[axisC] && p.boxMax[axisC] >= o.boxMin[axisC]) {
+						func(o.object, p.object);
+					}
+				}
+				p.activeIndex = (int)active.size();
+				active.emplace_back(index);
+			}
+		}
+	}
+}
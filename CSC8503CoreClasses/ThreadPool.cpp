@@ -0,0 +1,94 @@
+#include "ThreadPool.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+ThreadPool::ThreadPool(int threadCount)
+{
+	currentFunc		= nullptr;
+	currentCount	= 0;
+	currentJobs		= 0;
+	generation		= 0;
+	jobsRemaining	= 0;
+	shuttingDown	= false;
+
+	if (threadCount <= 0) {
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+	for (int i = 1; i < threadCount; ++i) {
+		workers.emplace_back(&ThreadPool::WorkerMain, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> l(lock);
+		shuttingDown = true;
+	}
+	wakeWorkers.notify_all();
+	for (std::thread& t : workers) {
+		t.join();
+	}
+}
+
+void ThreadPool::RunJob(int jobIndex)
+{
+	int begin	= (int)(((long long)currentCount * jobIndex) / currentJobs);
+	int end		= (int)(((long long)currentCount * (jobIndex + 1)) / currentJobs);
+	(*currentFunc)(begin, end, jobIndex);
+}
+
+int ThreadPool::ParallelFor(int count, int minPerJob, const RangeFunc& func)
+{
+	if (count <= 0) {
+		return 0;
+	}
+	int jobs = std::min(GetThreadCount(), (count + minPerJob - 1) / std::max(1, minPerJob));
+
+	if (jobs <= 1) {
+		func(0, count, 0);
+		return 1;
+	}
+	{
+		std::unique_lock<std::mutex> l(lock);
+		currentFunc		= &func;
+		currentCount	= count;
+		currentJobs		= jobs;
+		jobsRemaining	= jobs - 1;
+		generation++;
+	}
+	wakeWorkers.notify_all();
+
+	RunJob(0);
+
+	std::unique_lock<std::mutex> l(lock);
+	jobsDone.wait(l, [&] { return jobsRemaining == 0; });
+	currentFunc = nullptr;
+	return jobs;
+}
+
+//Worker i runs job i, if there's that many jobs this time around
+void ThreadPool::WorkerMain(int workerIndex)
+{
+	int lastGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> l(lock);
+			wakeWorkers.wait(l, [&] { return shuttingDown || generation != lastGeneration; });
+			if (shuttingDown) {
+				return;
+			}
+			lastGeneration = generation;
+			if (workerIndex >= currentJobs) {
+				continue;
+			}
+		}
+		RunJob(workerIndex);
+		{
+			std::unique_lock<std::mutex> l(lock);
+			jobsRemaining--;
+		}
+		jobsDone.notify_one();
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A small pool of worker threads that stay alive for the whole game, so
+		we don't pay to start up new threads every physics substep. The thread
+		calling ParallelFor does a share of the work too, and doesn't return
+		until every worker has finished its share.
+
+		Work is always split into the same contiguous ranges for a given count,
+		and each range is handed its own job index. Writing results into a
+		buffer per job index, and reading them back in index order, gives the
+		same results no matter how the threads actually got scheduled.
+		*/
+		class ThreadPool {
+		public:
+			typedef std::function<void(int begin, int end, int jobIndex)> RangeFunc;
+
+			//A count of 0 uses one thread per hardware core
+			ThreadPool(int threadCount = 0);
+			~ThreadPool();
+
+			//How many jobs a ParallelFor can be split into, including the calling thread
+			int GetThreadCount() const
+			{
+				return (int)workers.size() + 1;
+			}
+
+			/*
+			Splits [0, count) into at most GetThreadCount() ranges of at least
+			minPerJob items each, and blocks until func has run on all of them.
+			Returns how many jobs the work was split into.
+			*/
+			int ParallelFor(int count, int minPerJob, const RangeFunc& func);
+
+		protected:
+			void WorkerMain(int workerIndex);
+			void RunJob(int jobIndex);
+
+			std::vector<std::thread>	workers;
+
+			std::mutex					lock;
+			std::condition_variable		wakeWorkers;
+			std::condition_variable		jobsDone;
+
+			const RangeFunc*	currentFunc;
+			int					currentCount;
+			int					currentJobs;
+			int					generation;
+			int					jobsRemaining;
+			bool				shuttingDown;
+		};
+	}
+}
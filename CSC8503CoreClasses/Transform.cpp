@@ -3,34 +3,43 @@
 using namespace NCL::CSC8503;
 
 Transform::Transform()	{
-	scale = Vector3(1, 1, 1);
+	scale		= Vector3(1, 1, 1);
+	matrixDirty = true;
 }
 
 Transform::~Transform()	{
 
 }
 
-void Transform::UpdateMatrix() {
+void Transform::UpdateMatrix() const {
 	matrix =
 		Matrix::Translation(position) *
 		Quaternion::RotationMatrix<Matrix4>(orientation) *
 		Matrix::Scale(scale);
+	matrixDirty = false;
 }
 
 Transform& Transform::SetPosition(const Vector3& worldPos) {
 	position = worldPos;
-	UpdateMatrix();
+	matrixDirty = true;
 	return *this;
 }
 
 Transform& Transform::SetScale(const Vector3& worldScale) {
 	scale = worldScale;
-	UpdateMatrix();
+	matrixDirty = true;
 	return *this;
 }
 
 Transform& Transform::SetOrientation(const Quaternion& worldOrientation) {
 	orientation = worldOrientation;
-	UpdateMatrix();
+	matrixDirty = true;
+	return *this;
+}
+
+Transform& Transform::SetPositionAndOrientation(const Vector3& worldPos, const Quaternion& worldOrientation) {
+	position	= worldPos;
+	orientation = worldOrientation;
+	matrixDirty = true;
 	return *this;
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ namespace NCL {
 			Transform& SetPosition(const Vector3& worldPos);
 			Transform& SetScale(const Vector3& worldScale);
 			Transform& SetOrientation(const Quaternion& newOr);
+			Transform& SetPositionAndOrientation(const Vector3& worldPos, const Quaternion& newOr);
 
 			Vector3 GetPosition() const {
 				return position;
@@ -28,12 +29,28 @@ namespace NCL {
 				return orientation;
 			}
 
+			/*
+			Objects can be moved many times a frame (by the physics, network
+			updates and so on), but the matrix is only needed for drawing. So
+			the setters just mark the matrix as out of date, and it's only
+			rebuilt when it's next asked for.
+			*/
 			Matrix4 GetMatrix() const {
+				if (matrixDirty) {
+					UpdateMatrix();
+				}
 				return matrix;
 			}
-			void UpdateMatrix();
+
+			bool IsMatrixDirty() const {
+				return matrixDirty;
+			}
+
+			void UpdateMatrix() const;
 		protected:
-			Matrix4		matrix;
+			mutable Matrix4	matrix;
+			mutable bool	matrixDirty;
+
 			Quaternion	orientation;
 			Vector3		position;
 
@@ -0,0 +1,110 @@
+#include "TriangleMesh.h"
+#include "Mesh.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+TriangleMesh::TriangleMesh(const std::vector<Vector3>& positions, const std::vector<unsigned int>& indices) {
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		AddTriangle(positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]]);
+	}
+	Build();
+}
+
+TriangleMesh::TriangleMesh(const Rendering::Mesh& mesh) {
+	for (unsigned int i = 0; i < (unsigned int)mesh.GetPrimitiveCount(); ++i) {
+		Vector3 a, b, c;
+		if (mesh.GetTriangle(i, a, b, c)) {
+			AddTriangle(a, b, c);
+		}
+	}
+	Build();
+}
+
+//Triangles with no area have no normal, and can't be touched anyway
+void TriangleMesh::AddTriangle(const Vector3& a, const Vector3& b, const Vector3& c) {
+	Vector3 normal	= Vector::Cross(b - a, c - a);
+	float length	= Vector::Length(normal);
+	if (length <= 0.0f) {
+		return;
+	}
+	triangles.push_back({ a, b, c, normal / length });
+}
+
+void TriangleMesh::Build() {
+	nodes.clear();
+	halfDimensions = Vector3();
+	if (triangles.empty()) {
+		return;
+	}
+	std::vector<int>		order(triangles.size());
+	std::vector<Vector3>	centres(triangles.size());
+	for (int i = 0; i < (int)triangles.size(); ++i) {
+		const Triangle& t = triangles[i];
+		order[i]	= i;
+		centres[i]	= (t.a + t.b + t.c) / 3.0f;
+
+		for (const Vector3& v : { t.a, t.b, t.c }) {
+			halfDimensions = Vector::Max(halfDimensions, Vector::Max(v, -v));
+		}
+	}
+	//A balanced tree over n triangles has fewer than 2n / MaxLeafTriangles nodes
+	nodes.reserve(2 * triangles.size() / MaxLeafTriangles + 1);
+	BuildNode(order, centres, 0, (int)triangles.size());
+
+	std::vector<Triangle> sorted(triangles.size());
+	for (int i = 0; i < (int)order.size(); ++i) {
+		sorted[i] = triangles[order[i]];
+	}
+	triangles.swap(sorted);
+}
+
+/*
+The triangles are split in half by their centres, along whichever axis
+those centres are most spread out on. Always splitting at the median keeps
+the tree balanced, so it never gets deeper than the traversal stacks allow.
+*/
+int TriangleMesh::BuildNode(std::vector<int>& order, std::vector<Vector3>& centres, int begin, int end) {
+	int index = (int)nodes.size();
+	nodes.emplace_back();
+
+	Vector3 boxMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3 boxMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	Vector3 centreMin = boxMin;
+	Vector3 centreMax = boxMax;
+	for (int i = begin; i < end; ++i) {
+		const Triangle& t = triangles[order[i]];
+		boxMin		= Vector::Min(boxMin, Vector::Min(t.a, Vector::Min(t.b, t.c)));
+		boxMax		= Vector::Max(boxMax, Vector::Max(t.a, Vector::Max(t.b, t.c)));
+		centreMin	= Vector::Min(centreMin, centres[order[i]]);
+		centreMax	= Vector::Max(centreMax, centres[order[i]]);
+	}
+	nodes[index].boxMin = boxMin;
+	nodes[index].boxMax = boxMax;
+
+	if (end - begin <= MaxLeafTriangles) {
+		nodes[index].first = begin;
+		nodes[index].count = end - begin;
+		return index;
+	}
+	Vector3 spread	= centreMax - centreMin;
+	int axis		= 0;
+	if (spread.y > spread[axis]) {
+		axis = 1;
+	}
+	if (spread.z > spread[axis]) {
+		axis = 2;
+	}
+	int middle = (begin + end) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+		[&](int a, int b) {
+			return centres[a][axis] < centres[b][axis];
+		}
+	);
+	BuildNode(order, centres, begin, middle);	//always lands at index + 1
+	int right = BuildNode(order, centres, middle, end);
+
+	nodes[index].first = right;
+	nodes[index].count = 0;
+	return index;
+}
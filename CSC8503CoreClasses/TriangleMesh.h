@@ -0,0 +1,213 @@
+#pragma once
+#include "Vector.h"
+
+namespace NCL {
+	namespace Rendering {
+		class Mesh;
+	}
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		A fixed soup of triangles, for level geometry that never moves. Rather
+		than every wall and floor being its own object in the broadphase, a
+		whole level can be one of these, with its own bounding volume hierarchy
+		over the triangles, so that only the few triangles near an object ever
+		get tested against it.
+
+		As the triangles never change, the hierarchy is built just once, and
+		flattened into a single array in depth first order. A node's left child
+		is always the very next node, so only the right child's index needs
+		storing, and that keeps each node down to 32 bytes - two to a cache
+		line. The triangles themselves are reordered to match the leaves, so
+		each leaf's triangles sit next to each other in memory too.
+		*/
+		class TriangleMesh {
+		public:
+			struct Triangle {
+				Vector3 a;
+				Vector3 b;
+				Vector3 c;
+				Vector3 normal;	//facing out of the side the vertices wind anticlockwise around
+			};
+
+			TriangleMesh(const std::vector<Vector3>& positions, const std::vector<unsigned int>& indices);
+			TriangleMesh(const Rendering::Mesh& mesh);
+			~TriangleMesh() = default;
+
+			int GetTriangleCount() const
+			{
+				return (int)triangles.size();
+			}
+
+			const Triangle& GetTriangle(int i) const
+			{
+				return triangles[i];
+			}
+
+			//How far the mesh reaches from its origin along each axis
+			Vector3 GetHalfDimensions() const
+			{
+				return halfDimensions;
+			}
+
+			int GetNodeCount() const
+			{
+				return (int)nodes.size();
+			}
+
+			//Calls func(int triangle) for every triangle in a leaf whose box overlaps the given box
+			template<class F>
+			void Query(const Vector3& boxMin, const Vector3& boxMax, F&& func) const;
+
+			/*
+			Calls func(int triangle) for every triangle in a leaf whose box the
+			ray passes through, nearest leaves first. As with the AABBTree, func
+			returns how far along the ray is still worth searching, or a negative
+			number to stop. A radius grows every box by that much, for sweeping
+			a sphere along the ray rather than a point.
+			*/
+			template<class F>
+			void Raycast(const Vector3& origin, const Vector3& direction, float maxDistance, F&& func, float radius = 0.0f) const;
+
+			static constexpr int MaxLeafTriangles = 4;
+
+		protected:
+			struct Node {
+				Vector3 boxMin;
+				int		first;	//first triangle for a leaf, or the right child for anything else
+				Vector3 boxMax;
+				int		count;	//how many triangles a leaf has, or 0 for anything else
+			};
+
+			void AddTriangle(const Vector3& a, const Vector3& b, const Vector3& c);
+			void Build();
+			int  BuildNode(std::vector<int>& order, std::vector<Vector3>& centres, int begin, int end);
+
+			static bool Overlaps(const Vector3& aMin, const Vector3& aMax, const Vector3& bMin, const Vector3& bMax)
+			{
+				return	aMin.x <= bMax.x && aMax.x >= bMin.x &&
+						aMin.y <= bMax.y && aMax.y >= bMin.y &&
+						aMin.z <= bMax.z && aMax.z >= bMin.z;
+			}
+
+			//How far along the ray it enters the box, if it does so before maxDistance
+			static bool RayEntry(const Vector3& origin, const Vector3& direction, const Vector3& invDirection,
+				const Vector3& boxMin, const Vector3& boxMax, float maxDistance, float& entry)
+			{
+				float tMin = 0.0f;
+				float tMax = maxDistance;
+				for (int i = 0; i < 3; ++i) {
+					if (direction[i] == 0.0f) {
+						if (origin[i] < boxMin[i] || origin[i] > boxMax[i]) {
+							return false;
+						}
+						continue;
+					}
+					float t0 = (boxMin[i] - origin[i]) * invDirection[i];
+					float t1 = (boxMax[i] - origin[i]) * invDirection[i];
+					tMin = std::max(tMin, std::min(t0, t1));
+					tMax = std::min(tMax, std::max(t0, t1));
+					if (tMin > tMax) {
+						return false;
+					}
+				}
+				entry = tMin;
+				return true;
+			}
+
+			std::vector<Triangle>	triangles;
+			std::vector<Node>		nodes;
+			Vector3					halfDimensions;
+		};
+
+		template<class F>
+		void TriangleMesh::Query(const Vector3& boxMin, const Vector3& boxMax, F&& func) const
+		{
+			if (nodes.empty()) {
+				return;
+			}
+			int stack[64];
+			int stackSize = 0;
+			stack[stackSize++] = 0;
+
+			while (stackSize > 0) {
+				int index		= stack[--stackSize];
+				const Node& n	= nodes[index];
+				if (!Overlaps(n.boxMin, n.boxMax, boxMin, boxMax)) {
+					continue;
+				}
+				if (n.count > 0) {
+					for (int i = n.first; i < n.first + n.count; ++i) {
+						func(i);
+					}
+				}
+				else {
+					stack[stackSize++] = n.first;
+					stack[stackSize++] = index + 1;
+				}
+			}
+		}
+
+		template<class F>
+		void TriangleMesh::Raycast(const Vector3& origin, const Vector3& direction, float maxDistance, F&& func, float radius) const
+		{
+			Vector3 grow(radius, radius, radius);
+			Vector3 invDirection;
+			for (int i = 0; i < 3; ++i) {
+				invDirection[i] = direction[i] == 0.0f ? 0.0f : 1.0f / direction[i];
+			}
+			float entry;
+			if (nodes.empty() || !RayEntry(origin, direction, invDirection, nodes[0].boxMin - grow, nodes[0].boxMax + grow, maxDistance, entry)) {
+				return;
+			}
+			struct StackEntry {
+				int		node;
+				float	entry;
+			};
+			StackEntry stack[64];
+			int stackSize = 0;
+			stack[stackSize++] = { 0, entry };
+
+			while (stackSize > 0) {
+				StackEntry top = stack[--stackSize];
+				if (top.entry > maxDistance) {
+					continue; //something closer was hit after this was pushed
+				}
+				const Node& n = nodes[top.node];
+				if (n.count > 0) {
+					for (int i = n.first; i < n.first + n.count; ++i) {
+						maxDistance = func(i);
+						if (maxDistance < 0.0f) {
+							return;
+						}
+					}
+					continue;
+				}
+				int left	= top.node + 1;
+				int right	= n.first;
+				float leftEntry;
+				float rightEntry;
+				bool hitLeft	= RayEntry(origin, direction, invDirection, nodes[left].boxMin - grow,  nodes[left].boxMax + grow,  maxDistance, leftEntry);
+				bool hitRight	= RayEntry(origin, direction, invDirection, nodes[right].boxMin - grow, nodes[right].boxMax + grow, maxDistance, rightEntry);
+
+				//Push the further child first, so the nearer one is popped next
+				if (hitLeft && hitRight) {
+					if (leftEntry < rightEntry) {
+						stack[stackSize++] = { right,	rightEntry };
+						stack[stackSize++] = { left,	leftEntry };
+					}
+					else {
+						stack[stackSize++] = { left,	leftEntry };
+						stack[stackSize++] = { right,	rightEntry };
+					}
+				}
+				else if (hitLeft) {
+					stack[stackSize++] = { left, leftEntry };
+				}
+				else if (hitRight) {
+					stack[stackSize++] = { right, rightEntry };
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "CollisionVolume.h"
+#include "TriangleMesh.h"
+
+namespace NCL {
+	/*
+	Collision for static level geometry, made up of a TriangleMesh. The
+	mesh is positioned and turned by the object's transform, but not scaled,
+	and it's only ever meant for objects that don't move - other objects are
+	tested against its triangles, but nothing is worked out for the mesh as
+	a solid shape. Like a ConvexHullVolume, the mesh isn't owned by the
+	volume, and must outlive it.
+	*/
+	class TriangleMeshVolume : public CollisionVolume
+	{
+	public:
+		TriangleMeshVolume(const CSC8503::TriangleMesh* mesh)
+		{
+			type		= VolumeType::Mesh;
+			this->mesh	= mesh;
+		}
+		~TriangleMeshVolume() = default;
+
+		const CSC8503::TriangleMesh* GetMesh() const
+		{
+			return mesh;
+		}
+
+		Maths::Vector3 GetHalfDimensions() const
+		{
+			return mesh->GetHalfDimensions();
+		}
+
+	protected:
+		const CSC8503::TriangleMesh* mesh;
+	};
+}
@@ -0,0 +1,506 @@
+#include "GameWorld.h"
+#include "GameObject.h"
+#include "PhysicsSystem.h"
+#include "PhysicsObject.h"
+#include "AABBVolume.h"
+#include "OBBVolume.h"
+#include "SphereVolume.h"
+#include "CapsuleVolume.h"
+#include "NetworkObject.h"
+#include "Snapshot.h"
+#include "GameServer.h"
+#include "GameClient.h"
+
+#include <fstream>
+#include <random>
+#include <chrono>
+#include <thread>
+
+using namespace NCL;
+using namespace CSC8503;
+
+/*
+
+Measures how many bytes snapshots take, by running a recording of a game
+world's objects through the same SnapshotWriter and SnapshotReader the
+server and clients use, and checks that what comes out the other end
+still matches what went in, to within the quantisation's precision.
+
+The recording is made by dropping a pile of boxes, spheres and capsules
+onto a floor, and kicking a few of them every so often so there's always
+something moving - or it can be saved to a file, and loaded back in, so
+that the same recording can be measured again after the encoding changes.
+
+Three encodings are compared:
+ - every entry as full precision floats, bit-packed, as in the first
+   version of the snapshots
+ - every entry quantised, but whole
+ - every entry quantised, and sent as a delta from the client's last
+   acknowledged full state, which is what the server sends
+
+Then a real GameServer and GameClient are run over loopback, to check
+that the server copes with a client whose acknowledgements stop coming
+in - see CheckLaggingAcks.
+
+Exits with 1 if the decoded state was ever further out than the
+quantisation should allow, or the lagging client was ever sent a delta
+it couldn't use, so it can be run as a regression check.
+
+*/
+
+struct BenchSettings {
+	int			objects		= 200;
+	int			snapshots	= 600;
+	int			kicks		= 20;	//objects kicked every 10 snapshots
+	int			ackLag		= 1;	//snapshots before the client's ack reaches the server
+	int			fullEvery	= 6;
+	int			port		= NetworkBase::GetDefaultPort();
+	std::string	recordFile;
+	std::string	replayFile;
+};
+
+struct RecordedObject {
+	Vector3		position;
+	Quaternion	orientation;
+};
+
+typedef std::vector<std::vector<RecordedObject>> Recording;
+
+static constexpr float SnapshotRate = 20.0f;
+
+static void PrintUsage(const char* program) {
+	std::cout << "Usage: " << program << " [options]\n"
+		<< "  --objects <n>      objects in the recorded world (default 200)\n"
+		<< "  --snapshots <n>    snapshots to record, at 20hz (default 600)\n"
+		<< "  --kicks <n>        objects kicked every 10 snapshots (default 20)\n"
+		<< "  --ack-lag <n>      snapshots before an ack reaches the server (default 1)\n"
+		<< "  --port <n>         loopback port for the lagging ack check (default " << NetworkBase::GetDefaultPort() << ")\n"
+		<< "  --record <file>    save the recording made to a file\n"
+		<< "  --replay <file>    measure a saved recording instead of making one\n";
+}
+
+static bool ReadSettings(int argc, char** argv, BenchSettings& settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			return false;
+		}
+		std::string value = argv[++i];
+		if		(arg == "--record") { settings.recordFile = value; continue; }
+		else if (arg == "--replay") { settings.replayFile = value; continue; }
+
+		int number = 0;
+		try {
+			number = std::stoi(value);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		if		(arg == "--objects")	{ settings.objects		= number; }
+		else if (arg == "--snapshots")	{ settings.snapshots	= number; }
+		else if (arg == "--kicks")		{ settings.kicks		= number; }
+		else if (arg == "--ack-lag")	{ settings.ackLag		= number; }
+		else if (arg == "--port")		{ settings.port			= number; }
+		else {
+			return false;
+		}
+	}
+	return settings.objects > 0 && settings.snapshots > 0 && settings.kicks >= 0 && settings.ackLag >= 0
+		&& settings.port > 0 && settings.port < 65536;
+}
+
+static GameObject* AddObject(GameWorld& world, CollisionVolume* volume, const Vector3& position, const Quaternion& orientation, float inverseMass) {
+	GameObject* o = new GameObject();
+	o->SetBoundingVolume(volume);
+	o->GetTransform().SetPosition(position).SetOrientation(orientation);
+	o->SetPhysicsObject(new PhysicsObject(o->GetTransform(), o->GetBoundingVolume()));
+	o->GetPhysicsObject()->SetInverseMass(inverseMass);
+	o->GetPhysicsObject()->InitCubeInertia();
+	world.AddGameObject(o);
+	return o;
+}
+
+//Deterministic mode and a fixed seed mean the same settings always make the same recording
+static Recording MakeRecording(const BenchSettings& settings) {
+	GameWorld		world;
+	PhysicsSystem	physics(world);
+	physics.UseGravity(true);
+	physics.UseDeterministicMode(true);
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> spread(-40.0f, 40.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	AddObject(world, new AABBVolume(Vector3(60, 1, 60)), Vector3(0, -1, 0), Quaternion(), 0.0f);
+
+	std::vector<GameObject*> objects;
+	for (int i = 0; i < settings.objects; ++i) {
+		CollisionVolume* volume = nullptr;
+		switch (i % 4) {
+			case 0: volume = new AABBVolume(Vector3(0.8f, 0.8f, 0.8f));	break;
+			case 1: volume = new OBBVolume(Vector3(0.8f, 0.6f, 0.9f));	break;
+			case 2: volume = new SphereVolume(0.8f);					break;
+			case 3: volume = new CapsuleVolume(1.2f, 0.5f);				break;
+		}
+		Quaternion orientation = Quaternion::EulerAnglesToQuaternion(unit(random) * 90.0f, unit(random) * 90.0f, unit(random) * 90.0f);
+		objects.emplace_back(AddObject(world, volume, Vector3(spread(random), 2.0f + i * 0.2f, spread(random)), orientation, 1.0f));
+	}
+
+	Recording recording(settings.snapshots);
+	for (int s = 0; s < settings.snapshots; ++s) {
+		if (s % 10 == 0) {
+			for (int k = 0; k < settings.kicks; ++k) {
+				PhysicsObject* p = objects[random() % objects.size()]->GetPhysicsObject();
+				p->SetLinearVelocity(Vector3(unit(random) * 5.0f, 6.0f, unit(random) * 5.0f));
+				p->SetAngularVelocity(Vector3(unit(random) * 3.0f, unit(random) * 3.0f, unit(random) * 3.0f));
+				p->Wake();
+			}
+		}
+		world.UpdateWorld(1.0f / SnapshotRate);
+		physics.Update(1.0f / SnapshotRate);
+
+		for (GameObject* o : objects) {
+			recording[s].push_back({ o->GetTransform().GetPosition(), o->GetTransform().GetOrientation() });
+		}
+	}
+	return recording;
+}
+
+static bool SaveRecording(const std::string& filename, const Recording& recording) {
+	std::ofstream file(filename, std::ios::binary);
+	int counts[2] = { (int)recording.size(), recording.empty() ? 0 : (int)recording[0].size() };
+	file.write((const char*)counts, sizeof(counts));
+	for (const auto& snapshot : recording) {
+		file.write((const char*)snapshot.data(), snapshot.size() * sizeof(RecordedObject));
+	}
+	return file.good();
+}
+
+static bool LoadRecording(const std::string& filename, Recording& recording) {
+	std::ifstream file(filename, std::ios::binary);
+	int counts[2] = { 0, 0 };
+	file.read((char*)counts, sizeof(counts));
+	if (!file || counts[0] <= 0 || counts[1] <= 0) {
+		return false;
+	}
+	recording.assign(counts[0], std::vector<RecordedObject>(counts[1]));
+	for (auto& snapshot : recording) {
+		file.read((char*)snapshot.data(), snapshot.size() * sizeof(RecordedObject));
+	}
+	return file.good();
+}
+
+//The angle between two orientations, in degrees
+static float AngleBetween(const Quaternion& a, const Quaternion& b) {
+	float dot = std::abs(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+	return 2.0f * std::acos(std::min(1.0f, dot)) * 57.29578f;
+}
+
+/*
+The client side of the lagging ack check. Snapshots are read the same way
+SnapshotReader reads them, but each entry is looked at on the way, so that
+deltas can be told apart from whole entries.
+*/
+struct LaggingClient : public PacketReceiver {
+	std::vector<NetworkObject*>	objects;	//indexed by network ID
+	SnapshotQuantisation		quantisation;
+
+	int		newestFullState = -1;	//what the client would acknowledge, if its acks got through
+	int		serverFullState = -1;	//the server's newest full state, when the snapshot was sent
+	bool	caughtUp		= false;	//acks have started getting through again
+
+	int		snapshots		= 0;
+	int		deltas			= 0;
+	int		staleWholes		= 0;	//whole entries sent while the ack was too old to use
+	int		staleDeltas		= 0;	//deltas from an ack too old to use - should never happen
+	int		caughtUpDeltas	= 0;
+	int		rejected		= 0;	//entries the client couldn't use - should never happen
+
+	void ReceivePacket(int type, GamePacket* payload, int source) override {
+		if (type != Snapshot_State) {
+			return;
+		}
+		SnapshotPacket* packet = (SnapshotPacket*)payload;
+		BitReader		reader(packet->GetEntries(), packet->GetEntryBytes());
+		SnapshotEntry	entry;
+
+		//Both the per-client full state masks and the state histories only go back this many full states
+		const int statesKept	= 32;
+		bool stale				= serverFullState - packet->baseStateID >= statesKept;
+
+		snapshots++;
+		for (int i = 0; i < packet->objectCount; ++i) {
+			NetworkObject::ReadSnapshotEntry(reader, entry, quantisation);
+			if (reader.IsOverflowed() || entry.objectID >= (int)objects.size()) {
+				rejected++;
+				return;
+			}
+			entry.baseStateID = packet->baseStateID;
+			entry.fullStateID = packet->fullStateID;
+
+			if (entry.isDelta) {
+				deltas++;
+				staleDeltas		+= stale ? 1 : 0;
+				caughtUpDeltas	+= caughtUp ? 1 : 0;
+			}
+			else {
+				staleWholes		+= stale ? 1 : 0;
+			}
+			if (!objects[entry.objectID]->ApplySnapshotEntry(entry, quantisation)) {
+				rejected++;
+			}
+		}
+		if (packet->fullStateID >= 0) {
+			newestFullState = std::max(newestFullState, packet->fullStateID);
+		}
+	}
+};
+
+/*
+A client's acks can stop getting through for a while, and the server then
+keeps taking deltas from the last one it got. Each object only remembers
+which of the last 32 full states it was sent to each client in, as a bit
+per state ID modulo 32, so once the ack is 32 or more full frames old, its
+bit has been reused for a newer state, and can say the client has the ack
+when it doesn't. It's the object's state history that saves it - that's
+also kept modulo 32, so the acked state has been written over too, and
+the entry goes whole. This runs a real server and client over loopback,
+and holds the client's acks back for 40 full frames, with the snapshot
+budget set to half the objects so that some objects miss full frames too.
+Every delta the client gets must be from a state it still has, and none
+can come from an ack that old.
+*/
+static bool CheckLaggingAcks(const BenchSettings& settings, const Recording& recording) {
+	const int	freshFullFrames		= 10;
+	const int	heldFullFrames		= 40;
+	const int	caughtUpFullFrames	= 10;
+	const auto	timeout				= std::chrono::seconds(2);
+
+	int count = (int)recording[0].size();
+
+	GameWorld serverWorld;
+	for (int i = 0; i < count; ++i) {
+		GameObject* o = new GameObject();
+		o->SetNetworkObject(new NetworkObject(*o, i));
+		serverWorld.AddGameObject(o);
+	}
+	std::vector<GameObject> clientObjects(count);
+	LaggingClient			lagging;
+	for (int i = 0; i < count; ++i) {
+		lagging.objects.emplace_back(new NetworkObject(clientObjects[i], i));
+	}
+
+	GameServer server(settings.port, 1);
+	GameClient client;
+	bool passed = server.Initialise() && client.Connect("127.0.0.1", settings.port);
+	server.SetGameWorld(serverWorld);
+	server.SetSnapshotBudget(std::max(1, count / 2));
+	client.RegisterPacketHandler(Snapshot_State, &lagging);
+
+	auto start = std::chrono::steady_clock::now();
+	while (passed && !(client.connected && !server.GetConnectedPeers().empty())) {
+		server.UpdateServer();
+		client.UpdateClient();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		passed = std::chrono::steady_clock::now() - start < timeout;
+	}
+	if (!passed) {
+		std::cout << "Lagging ack check: couldn't connect a client over loopback on port " << settings.port << "\n";
+	}
+
+	int totalSnapshots	= (freshFullFrames + heldFullFrames + caughtUpFullFrames) * settings.fullEvery;
+	int heldAck			= -1;
+	for (int s = 0; passed && s < totalSnapshots; ++s) {
+		bool fullFrame = s % settings.fullEvery == 0;
+		if (fullFrame) {
+			lagging.serverFullState++;
+		}
+		const std::vector<RecordedObject>& frame = recording[s % recording.size()];
+		std::vector<GameObject*>::const_iterator first;
+		std::vector<GameObject*>::const_iterator last;
+		serverWorld.GetObjectIterators(first, last);
+		for (auto i = first; i != last; ++i) {
+			const RecordedObject& r = frame[(*i)->GetNetworkObject()->GetNetworkID()];
+			(*i)->GetTransform().SetPosition(r.position).SetOrientation(r.orientation);
+		}
+		server.BroadcastSnapshot(!fullFrame);
+
+		//Wait for the snapshot to arrive, and then for the ack to be back at the server
+		int snapshots = lagging.snapshots;
+		start = std::chrono::steady_clock::now();
+		while (lagging.snapshots == snapshots && std::chrono::steady_clock::now() - start < timeout) {
+			server.UpdateServer();
+			client.UpdateClient();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		bool holding		= s >= freshFullFrames * settings.fullEvery && s < (freshFullFrames + heldFullFrames) * settings.fullEvery;
+		lagging.caughtUp	= s >= (freshFullFrames + heldFullFrames + 1) * settings.fullEvery;
+		if (!holding) {
+			heldAck = lagging.newestFullState;
+		}
+		ClientPacket ack;
+		ack.lastID = heldAck;
+		client.SendPacket(ack);
+
+		int peer = server.GetConnectedPeers().empty() ? 0 : server.GetConnectedPeers()[0];
+		start = std::chrono::steady_clock::now();
+		while (server.GetAckedState(peer) < heldAck && std::chrono::steady_clock::now() - start < timeout) {
+			server.UpdateServer();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	std::cout << "Lagging ack check: " << lagging.snapshots << " of " << totalSnapshots << " snapshots received, "
+		<< lagging.deltas << " deltas, " << lagging.staleWholes << " whole entries sent 32+ full frames behind, "
+		<< lagging.caughtUpDeltas << " deltas after catching up\n";
+
+	if (passed && (lagging.staleDeltas > 0 || lagging.rejected > 0)) {
+		std::cout << "  " << lagging.staleDeltas << " deltas were sent from an ack too old to use, and "
+			<< lagging.rejected << " entries couldn't be used by the client!\n";
+		passed = false;
+	}
+	//Make sure each part of the check actually happened
+	if (passed && (lagging.staleWholes == 0 || lagging.caughtUpDeltas == 0)) {
+		std::cout << "  The client never fell far enough behind, or never caught up again!\n";
+		passed = false;
+	}
+
+	client.Disconnect();
+	server.Shutdown();
+	serverWorld.ClearAndErase();
+	for (NetworkObject* o : lagging.objects) {
+		delete o;
+	}
+	return passed;
+}
+
+int main(int argc, char** argv) {
+	BenchSettings settings;
+	if (!ReadSettings(argc, argv, settings)) {
+		PrintUsage(argv[0]);
+		return -1;
+	}
+
+	Recording recording;
+	if (!settings.replayFile.empty()) {
+		if (!LoadRecording(settings.replayFile, recording)) {
+			std::cout << "Couldn't load recording " << settings.replayFile << "\n";
+			return -1;
+		}
+	}
+	else {
+		recording = MakeRecording(settings);
+	}
+	if (!settings.recordFile.empty() && !SaveRecording(settings.recordFile, recording)) {
+		std::cout << "Couldn't save recording to " << settings.recordFile << "\n";
+	}
+
+	int count = (int)recording[0].size();
+	std::vector<GameObject>		serverObjects(count);
+	std::vector<GameObject>		clientObjects(count);
+	std::vector<NetworkObject*>	serverNetwork;
+	std::vector<NetworkObject*>	clientNetwork;
+	for (int i = 0; i < count; ++i) {
+		serverNetwork.emplace_back(new NetworkObject(serverObjects[i], i));
+		clientNetwork.emplace_back(new NetworkObject(clientObjects[i], i));
+	}
+
+	SnapshotQuantisation	quantisation;
+	SnapshotWriter			deltaWriter;
+	SnapshotWriter			wholeWriter;
+	BitWriter				floatWriter;
+
+	int64_t floatBytes		= 0;
+	int64_t wholeBytes		= 0;
+	int64_t deltaBytes		= 0;
+	int64_t entries			= 0;
+	int64_t sentEntries		= 0;
+	float	maxPosition		= 0.0f;
+	float	maxAngle		= 0.0f;
+	int		fullStateID		= -1;
+	int		ackedState		= -1;
+	std::vector<std::pair<int, int>> acksInFlight;	//snapshot the ack arrives at, full state ID
+
+	for (int s = 0; s < (int)recording.size(); ++s) {
+		bool fullFrame = s % settings.fullEvery == 0;
+		if (fullFrame) {
+			fullStateID++;
+		}
+		for (int i = 0; i < count; ++i) {
+			serverObjects[i].GetTransform().SetPosition(recording[s][i].position).SetOrientation(recording[s][i].orientation);
+			serverNetwork[i]->PrepareSnapshot(fullFrame, fullStateID, quantisation);
+		}
+		while (!acksInFlight.empty() && acksInFlight.front().first <= s) {
+			ackedState = std::max(ackedState, acksInFlight.front().second);
+			acksInFlight.erase(acksInFlight.begin());
+		}
+
+		//Delta frames only carry the objects that changed, in every encoding
+		deltaWriter.Begin(s, fullFrame ? fullStateID : -1, ackedState);
+		wholeWriter.Begin(s, fullFrame ? fullStateID : -1);
+		floatWriter.Reset(sizeof(SnapshotPacket));
+		for (int i = 0; i < count; ++i) {
+			if (!fullFrame && !serverNetwork[i]->IsDirty()) {
+				continue;
+			}
+			deltaWriter.AddObject(*serverNetwork[i]);
+			wholeWriter.AddObject(*serverNetwork[i], false);
+
+			const Transform& t = serverObjects[i].GetTransform();
+			floatWriter.WriteBits(i, NetworkObject::NetworkIDBits);
+			for (int axis = 0; axis < 3; ++axis) {
+				floatWriter.WriteFloat(t.GetPosition()[axis]);
+			}
+			floatWriter.WriteFloat(t.GetOrientation().x);
+			floatWriter.WriteFloat(t.GetOrientation().y);
+			floatWriter.WriteFloat(t.GetOrientation().z);
+			floatWriter.WriteFloat(t.GetOrientation().w);
+		}
+		floatBytes	+= floatWriter.GetByteCount();
+		wholeBytes	+= wholeWriter.Finish().GetTotalSize();
+		sentEntries += deltaWriter.GetObjectCount();
+		entries		+= count;
+
+		//The client only sees a copy of the bytes, as it would off the wire
+		SnapshotPacket& packet = deltaWriter.Finish();
+		deltaBytes += packet.GetTotalSize();
+		std::vector<char> wire((char*)&packet, (char*)&packet + packet.GetTotalSize());
+		if (!SnapshotReader::Read(*(SnapshotPacket*)wire.data(), [&](int id) { return clientNetwork[id]; }, quantisation)) {
+			std::cout << "Snapshot " << s << " couldn't be read back!\n";
+			return 1;
+		}
+		if (fullFrame) {
+			acksInFlight.emplace_back(s + settings.ackLag, fullStateID);
+		}
+		for (int i = 0; i < count; ++i) {
+			maxPosition = std::max(maxPosition, Vector::Length(clientObjects[i].GetTransform().GetPosition() - recording[s][i].position));
+			maxAngle	= std::max(maxAngle, AngleBetween(clientObjects[i].GetTransform().GetOrientation(), recording[s][i].orientation));
+		}
+	}
+
+	double perEntry = 1.0 / entries;
+	std::cout << recording.size() << " snapshots of " << count << " objects, "
+		<< (100.0 * sentEntries * perEntry) << "% of entries sent, acks " << settings.ackLag << " snapshots late\n";
+	std::cout << "  bit-packed floats:  " << floatBytes * perEntry << " bytes/object/snapshot\n";
+	std::cout << "  quantised, whole:   " << wholeBytes * perEntry << " bytes/object/snapshot\n";
+	std::cout << "  quantised, deltas:  " << deltaBytes * perEntry << " bytes/object/snapshot, "
+		<< deltaBytes * SnapshotRate / recording.size() / 1024.0 << " KB/s per client\n";
+	std::cout << "  max error:          " << maxPosition << " units, " << maxAngle << " degrees\n";
+
+	//Rounding to the nearest step is at most half a step out on each axis
+	float positionLimit = quantisation.positionResolution * 0.5f * std::sqrt(3.0f) * 1.01f;
+	float angleLimit	= 0.5f;
+	if (maxPosition > positionLimit || maxAngle > angleLimit) {
+		std::cout << "Decoded state is further out than the quantisation allows (" << positionLimit << " units, " << angleLimit << " degrees)!\n";
+		return 1;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		delete serverNetwork[i];
+		delete clientNetwork[i];
+	}
+
+	NetworkBase::Initialise();
+	bool acksPassed = CheckLaggingAcks(settings, recording);
+	NetworkBase::Destroy();
+	return acksPassed ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+#include "GameWorld.h"
+#include "PhysicsSystem.h"
+#include "GameServer.h"
+#include "LevelBuilder.h"
+#include "NetworkBase.h"
+#include "Debug.h"
+
+#include <chrono>
+#include <thread>
+#include <csignal>
+#include <cstdlib>
+
+using namespace NCL;
+using namespace CSC8503;
+
+/*
+
+The dedicated server runs the same game world, physics and networking
+as the game itself, but with no window, renderer or input - so it can
+be run from a terminal, or a script, with lots of copies on one machine,
+each on its own port.
+
+The level is built from the same seed that's sent to clients, by the
+same LevelBuilder the game uses, so every object's network ID matches up
+with the one the client built for itself.
+
+Rather than running as fast as it can, it steps at a fixed tick rate,
+and sleeps in between, so that an idle server hardly uses any CPU. The
+physics is put into deterministic mode, so it always steps at its ideal
+rate no matter how long a tick took.
+
+*/
+
+struct ServerSettings {
+	int				port		= NetworkBase::GetDefaultPort();
+	int				tickRate	= 20;
+	int				maxClients	= 4;
+	unsigned int	levelSeed	= 12345;
+	int				fullEvery	= 6;	//every 6th snapshot is a full frame, like NetworkedGame
+};
+
+static std::atomic<bool> keepRunning = true;
+
+static void HandleSignal(int) {
+	keepRunning = false;
+}
+
+static void PrintUsage(const char* program) {
+	std::cout << "Usage: " << program << " [options]\n"
+		<< "  --port <n>       port to listen on (default " << NetworkBase::GetDefaultPort() << ")\n"
+		<< "  --tick <n>       server updates per second (default 20)\n"
+		<< "  --clients <n>    most clients that can connect at once (default 4)\n"
+		<< "  --seed <n>       level seed sent to clients (default 12345)\n"
+		<< "  --help           show this message\n";
+}
+
+static bool ReadSettings(int argc, char** argv, ServerSettings& settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--help") {
+			return false;
+		}
+		if (i + 1 >= argc) {
+			std::cout << "Missing value for " << arg << "\n";
+			return false;
+		}
+		int value = 0;
+		try {
+			value = std::stoi(argv[++i]);
+		}
+		catch (const std::exception&) {
+			std::cout << "Bad value for " << arg << ": " << argv[i] << "\n";
+			return false;
+		}
+
+		if		(arg == "--port")		{ settings.port			= value; }
+		else if (arg == "--tick")		{ settings.tickRate		= value; }
+		else if (arg == "--clients")	{ settings.maxClients	= value; }
+		else if (arg == "--seed")		{ settings.levelSeed	= (unsigned int)value; }
+		else {
+			std::cout << "Unknown option " << arg << "\n";
+			return false;
+		}
+	}
+	if (settings.port <= 0 || settings.port > 65535 || settings.tickRate <= 0 || settings.maxClients <= 0) {
+		std::cout << "Port, tick rate and client count must all be positive, and the port below 65536\n";
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	ServerSettings settings;
+	if (!ReadSettings(argc, argv, settings)) {
+		PrintUsage(argv[0]);
+		return -1;
+	}
+	std::signal(SIGINT, HandleSignal);
+	std::signal(SIGTERM, HandleSignal);
+
+	NetworkBase::Initialise();
+
+	GameWorld*		world	= new GameWorld();
+	PhysicsSystem*	physics = new PhysicsSystem(*world);
+	physics->UseDeterministicMode(true);
+	physics->UseGravity(true);
+
+	LevelBuilder* level = new LevelBuilder(*world);
+	srand(settings.levelSeed);
+	level->Build();
+
+	GameServer* server = new GameServer(settings.port, settings.maxClients);
+	if (!server->Initialise()) {
+		delete server;
+		delete physics;
+		delete world;
+		delete level;
+		NetworkBase::Destroy();
+		return -1;
+	}
+	server->SetGameWorld(*world);
+	server->SetLevelSeed(settings.levelSeed);
+	for (int i = 0; i < (int)level->GetPlayers().size(); ++i) {
+		server->SetPlayerObject(i, level->GetPlayers()[i]);
+	}
+
+	std::cout << "Server running on port " << settings.port << " at " << settings.tickRate
+		<< "hz, for up to " << settings.maxClients << " clients\n";
+
+	const float	dt			= 1.0f / settings.tickRate;
+	const auto	tickLength	= std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(dt));
+	auto		nextTick	= std::chrono::steady_clock::now();
+	int			tick		= 0;
+
+	while (keepRunning) {
+		server->UpdateServer();
+
+		world->UpdateWorld(dt);
+		physics->Update(dt);
+
+		server->BroadcastSnapshot(tick % settings.fullEvery != 0);
+		tick++;
+
+		Debug::UpdateRenderables(dt); //nothing draws them, but they still need clearing out
+
+		//If a tick ran long, carry on from now rather than trying to catch up
+		nextTick += tickLength;
+		auto now = std::chrono::steady_clock::now();
+		if (nextTick < now) {
+			nextTick = now;
+		}
+		std::this_thread::sleep_until(nextTick);
+	}
+	std::cout << "Server shutting down\n";
+
+	delete server;
+	delete physics;
+	delete world;
+	delete level;
+	NetworkBase::Destroy();
+	return 0;
+}